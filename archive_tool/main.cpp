@@ -0,0 +1,154 @@
+#include <boost/program_options.hpp>
+#include <spdlog/spdlog.h>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "capture_archive.hpp"
+#include "capture_buffer.hpp"
+
+namespace po = boost::program_options;
+
+void PrintInfo(const std::string &path, const ArchiveReader &reader) {
+  const ArchiveHeader &header = reader.header();
+  const ArchiveConfig &config = header.config;
+  std::printf("%s%s\n", path.c_str(), reader.recovered() ? " (not closed, index rebuilt)" : "");
+  std::printf("  captures:   %zu\n", reader.size());
+  if (reader.size() > 0) {
+    std::printf("  time:       %.6f - %.6f s\n", reader.entry(0).device_time,
+                reader.entry(reader.size() - 1).device_time);
+  }
+  std::printf("  device:     %s\n", config.device);
+  std::printf("  rate:       %.0f Hz\n", config.rate);
+  std::printf("  freq:       %.0f Hz\n", config.freq);
+  std::printf("  gain:       rx %.1f dB, tx %.1f dB\n", config.rx_gain, config.tx_gain);
+  std::printf("  format:     %s\n", CpuFormat(static_cast<SampleFormat>(config.sample_format)));
+  std::printf("  channels:   %zu\n", reader.num_channels());
+  std::printf("  ports:      %u tx x %u rx, %u samps, guard %u, delay %u\n",
+              config.tx_ports, config.rx_ports, config.num_samps, config.guard, config.num_delay);
+  std::printf("  pattern:    %zu slots, %s\n", reader.num_slots(),
+              reader.pattern().ToString(2 * config.num_samps).c_str());
+  std::printf("  tx node:    %u\n", config.tx_node);
+  std::printf("  config:     %016llx\n", static_cast<unsigned long long>(header.config_hash));
+}
+
+void PrintIndex(const ArchiveReader &reader) {
+  std::printf("%8s %10s %14s %6s %10s %14s %16s\n", "capture", "sequence", "device_time", "link", "bytes", "freq",
+              "config");
+  for (size_t i = 0; i < reader.size(); i++) {
+    const IndexEntry &entry = reader.entry(i);
+    std::printf("%8zu %10llu %14.6f %6u %10llu %14.0f %016llx\n", i, static_cast<unsigned long long>(entry.sequence),
+                entry.device_time, entry.link, static_cast<unsigned long long>(entry.payload_bytes), reader.freq(i),
+                static_cast<unsigned long long>(entry.config_hash));
+  }
+}
+
+// writes captures [first, first + count), optionally only one port slot and / or one channel, optionally
+// converted to fc32
+size_t Extract(const ArchiveReader &reader, size_t first, size_t count, long slot, long channel, bool to_fc32,
+               std::ofstream &out) {
+  const size_t sample_size = reader.sample_size();
+  const bool sc16 = static_cast<SampleFormat>(reader.header().config.sample_format) == SampleFormat::kSc16;
+  const size_t slot_offset = slot < 0 ? 0 : reader.slot_offset(static_cast<size_t>(slot));
+  const size_t num_samps = slot < 0 ? reader.channel_samps() : reader.slot_samps(static_cast<size_t>(slot));
+  const size_t first_channel = channel < 0 ? 0 : static_cast<size_t>(channel);
+  const size_t end_channel = channel < 0 ? reader.num_channels() : first_channel + 1;
+  std::vector<std::complex<float>> converted;
+  size_t num_written = 0;
+  for (size_t i = first; i < std::min(first + count, reader.size()); i++) {
+    const size_t capture_samps = reader.entry(i).payload_bytes / sample_size;
+    for (size_t chan = first_channel; chan < end_channel; chan++) {
+      const size_t offset = chan * reader.channel_samps() + slot_offset;
+      if (offset + num_samps > capture_samps) {
+        throw std::runtime_error("Capture " + std::to_string(i) + " does not hold the requested slot / channel");
+      }
+      // only the pages of the requested range are touched
+      const char *samples = static_cast<const char *>(reader.payload(i)) + offset * sample_size;
+      if (to_fc32 and sc16) {
+        converted.resize(num_samps);
+        const auto *in = reinterpret_cast<const std::complex<int16_t> *>(samples);
+        for (size_t k = 0; k < num_samps; k++) {
+          converted[k] = std::complex<float>(in[k].real() * kSc16Scale, in[k].imag() * kSc16Scale);
+        }
+        out.write(reinterpret_cast<const char *>(converted.data()),
+                  static_cast<std::streamsize>(num_samps * sizeof(converted.front())));
+      } else {
+        out.write(samples, static_cast<std::streamsize>(num_samps * sample_size));
+      }
+    }
+    num_written++;
+  }
+  return num_written;
+}
+
+int main(int argc, char *argv[]) {
+  // variables to be set by po
+  std::string command, file, out_path;
+  size_t first, count;
+  long tx_port, rx_port, channel;
+  bool to_fc32;
+
+  po::options_description desc("Allowed options");
+  // clang-format off
+  desc.add_options()
+      ("help", "help message")
+      ("command", po::value<std::string>(&command), "info, list or extract")
+      ("file", po::value<std::string>(&file), "segment file written by --record")
+      ("capture", po::value<size_t>(&first)->default_value(0), "first capture to extract")
+      ("count", po::value<size_t>(&count)->default_value(1), "number of captures to extract")
+      ("tx-port", po::value<long>(&tx_port)->default_value(-1), "extract only this tx port (with --rx-port)")
+      ("rx-port", po::value<long>(&rx_port)->default_value(-1), "extract only this rx port (with --tx-port)")
+      ("channel", po::value<long>(&channel)->default_value(-1),
+       "extract only this rx channel (-1: every channel, one after the other)")
+      ("fc32", po::bool_switch(&to_fc32), "convert sc16 captures to complex float")
+      ("out", po::value<std::string>(&out_path), "output file of extract (raw samples)");
+  // clang-format on
+  po::positional_options_description positional;
+  positional.add("command", 1).add("file", 1);
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help") or !vm.count("command") or !vm.count("file")) {
+    std::cout << "archive_tool <info|list|extract> <file> [options]" << std::endl << desc << std::endl;
+    return vm.count("help") ? EXIT_SUCCESS : ~0;
+  }
+
+  try {
+    ArchiveReader reader(file);
+    if (command == "info") {
+      PrintInfo(file, reader);
+    } else if (command == "list") {
+      PrintIndex(reader);
+    } else if (command == "extract") {
+      if (out_path.empty()) {
+        std::cerr << "extract needs --out" << std::endl;
+        return ~0;
+      }
+      long slot = -1;
+      if (tx_port >= 0 or rx_port >= 0) {
+        if (tx_port < 0 or rx_port < 0) {
+          std::cerr << "--tx-port and --rx-port must both be given" << std::endl;
+          return ~0;
+        }
+        slot = static_cast<long>(reader.Slot(static_cast<uint32_t>(tx_port), static_cast<uint32_t>(rx_port)));
+      }
+      std::ofstream out(out_path, std::ofstream::binary);
+      if (channel >= static_cast<long>(reader.num_channels())) {
+        std::cerr << "The segment has " << reader.num_channels() << " channels" << std::endl;
+        return ~0;
+      }
+      size_t num_written = Extract(reader, first, count, slot, channel, to_fc32, out);
+      spdlog::info("Wrote {} captures to {}", num_written, out_path);
+    } else {
+      std::cerr << "Unknown command: " << command << std::endl;
+      return ~0;
+    }
+  } catch (std::exception &e) {
+    spdlog::error("{}", e.what());
+    return ~0;
+  }
+  return EXIT_SUCCESS;
+}
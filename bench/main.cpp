@@ -0,0 +1,592 @@
+#include <boost/algorithm/string.hpp>
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "capture_buffer.hpp"
+#include "capture_recorder.hpp"
+#include "capture_server.hpp"
+#include "control_channel.hpp"
+#include "ctf_engine.hpp"
+#include "gpio_schedule.hpp"
+#include "metrics.hpp"
+#include "radio.hpp"
+#include "rx_capture.hpp"
+#include "sim_radio.hpp"
+#include "sweep_plan.hpp"
+#include "switch_pattern.hpp"
+#include "udp_streamer.hpp"
+
+namespace po = boost::program_options;
+
+namespace {
+
+const int kSinkBufferBytes = 64 * 1024 * 1024;  // the kernel caps it at net.core.rmem_max
+const double kSinkTimeout = 1.0;  // seconds the sink waits for the last datagrams of a sweep
+
+// what the capture server has sent, the loop case waits for the sink to get as much
+Counter &udp_bytes = Metrics().AddCounter("udp_bytes_total", "payload bytes sent over UDP");
+
+// one point of the parameter grid
+struct BenchConfig {
+  double rate;
+  size_t num_samps;
+  size_t tx_ports;
+  size_t rx_ports;
+};
+
+struct BenchOptions {
+  size_t num_sweeps;
+  size_t loop_sweeps;  // the loop case runs on the 200 ms sweep grid, so it gets fewer
+  size_t warmup;
+  SampleFormat sample_format;
+  size_t guard;
+  size_t udp_size;
+  double udp_rate;  // MB/s
+  double ctf_ratio;
+  std::string record_dir;
+  size_t segment_size;  // MB
+  bool direct_io;
+  std::string sim_args;
+  size_t inject_overflow_at;  // measured sweep of the capture and loop cases that overflows, 0: none
+  // the path of the loop case, as the options of txrx_core
+  bool pipeline;
+  bool loop_ctf;
+  size_t num_average;
+  bool loop_record;
+};
+
+// what one case measured on one configuration
+struct BenchResult {
+  size_t num_sweeps = 0;
+  size_t num_failed = 0;
+  uint64_t num_bytes = 0;  // payload the stage moved
+  double elapsed = 0;  // seconds
+  std::vector<double> latencies;  // seconds per sweep
+  std::string note;
+};
+
+// runs function when it goes out of scope, also when an exception leaves it
+class ScopeExit {
+ public:
+  explicit ScopeExit(std::function<void()> function) : function_(std::move(function)) {}
+  ~ScopeExit() { function_(); }
+  ScopeExit(const ScopeExit &) = delete;
+  ScopeExit &operator=(const ScopeExit &) = delete;
+
+ private:
+  std::function<void()> function_;
+};
+
+// Loopback UDP receiver standing in for the client, counts what arrives until a zero length datagram.
+class UdpSink {
+ public:
+  UdpSink() : socket_(io_context_, boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), 0)) {
+    socket_.set_option(boost::asio::socket_base::receive_buffer_size(kSinkBufferBytes));
+    thread_ = std::thread([this]() { Receive(); });
+  }
+  ~UdpSink() { Stop(); }
+
+  unsigned short port() const { return socket_.local_endpoint().port(); }
+  uint64_t num_bytes() const { return num_bytes_.load(std::memory_order_acquire); }
+
+  // false if fewer than num_bytes arrived within timeout seconds
+  bool WaitFor(uint64_t num_bytes, double timeout) const {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    while (this->num_bytes() < num_bytes) {
+      if (std::chrono::steady_clock::now() > deadline) return false;
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+  void Stop() {
+    if (!thread_.joinable()) return;
+    boost::asio::ip::udp::socket stopper(io_context_, boost::asio::ip::udp::v4());
+    stopper.send_to(boost::asio::const_buffer(nullptr, 0), socket_.local_endpoint());
+    thread_.join();
+  }
+
+ private:
+  void Receive() {
+    std::vector<char> datagram(65536);
+    for (;;) {
+      const size_t n = socket_.receive(boost::asio::buffer(datagram));
+      if (n == 0) break;
+      num_bytes_.fetch_add(n, std::memory_order_release);
+    }
+  }
+
+  boost::asio::io_context io_context_;
+  boost::asio::ip::udp::socket socket_;
+  std::thread thread_;
+  std::atomic<uint64_t> num_bytes_{0};
+};
+
+// radio, pattern and buffers of one configuration, shared by the cases
+struct BenchSetup {
+  BenchSetup(const BenchConfig &config, const BenchOptions &options)
+      : config(config), options(options),
+        pattern(SwitchPattern::Grid(config.tx_ports, config.rx_ports, 2 * config.num_samps)),
+        layout(0, pattern.dwells(), options.guard),
+        buff(options.sample_format, layout.capture_samps()),
+        scratch(options.sample_format, 0) {
+    if (options.guard > config.num_samps) throw std::runtime_error("--guard must not exceed --samps");
+    radio = MakeRadio(options.sim_args);
+    radio->set_rx_rate(config.rate);
+    radio->set_tx_rate(config.rate);
+    uhd::stream_args_t stream_args(CpuFormat(options.sample_format), "sc16");
+    rx_stream = radio->get_rx_stream(stream_args);
+    scratch = CaptureBuffer(options.sample_format, rx_stream->get_max_num_samps());
+
+    // unit modulus random waveform, a flat spectrum like the multitone of the clients
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> phase(-3.14159265f, 3.14159265f);
+    reference.resize(config.num_samps);
+    for (auto &samp : reference) samp = std::polar(1.0f, phase(generator));
+  }
+
+  size_t capture_bytes() const { return buff.bytes(layout.capture_samps()); }
+  // bytes the client gets for one raw capture
+  size_t wire_bytes() const {
+    return capture_bytes() + (options.sample_format == SampleFormat::kSc16 ? sizeof(Sc16Header) : 0);
+  }
+
+  // one sweep into buff, true if all of it arrived
+  bool Capture() {
+    const double stream_time = radio->get_time_now().get_real_secs() + 0.001;
+    return ReceiveSweep(rx_stream, layout, buff, scratch, stream_time, config.rate) == layout.stream_samps();
+  }
+
+  // sweep() with an overflow of the simulated radio before the --inject-overflow-at'th measured call, after the
+  // warmup calls of the case
+  std::function<bool()> InjectOverflow(std::function<bool()> sweep) const {
+    if (options.inject_overflow_at == 0) return sweep;
+    const auto sim_radio = std::dynamic_pointer_cast<SimRadio>(radio);
+    const size_t at = options.warmup + options.inject_overflow_at - 1;
+    auto num_calls = std::make_shared<size_t>(0);
+    return [sim_radio, at, num_calls, sweep]() {
+      if ((*num_calls)++ == at) sim_radio->InjectOverflow();
+      return sweep();
+    };
+  }
+
+  void SendRaw(UdpStreamer &udp_streamer) {
+    if (options.sample_format == SampleFormat::kSc16) {
+      auto header = MakeSc16Header(layout.capture_samps());
+      udp_streamer.Send(&header, sizeof(header));
+    }
+    udp_streamer.Send(buff.at(0), capture_bytes());
+  }
+
+  const BenchConfig config;
+  const BenchOptions &options;
+  const SwitchPattern pattern;
+  const CaptureLayout layout;
+  CaptureBuffer buff;
+  CaptureBuffer scratch;
+  Radio::sptr radio;
+  uhd::rx_streamer::sptr rx_stream;
+  std::vector<std::complex<float>> reference;
+};
+
+// runs sweep() warmup + num_sweeps times, the warmup runs are left out of the result
+BenchResult Measure(size_t warmup, size_t num_sweeps, size_t bytes_per_sweep, const std::function<bool()> &sweep) {
+  for (size_t i = 0; i < warmup; i++) sweep();
+  BenchResult result;
+  result.latencies.reserve(num_sweeps);
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < num_sweeps; i++) {
+    const auto sweep_start = std::chrono::steady_clock::now();
+    const bool success = sweep();
+    result.latencies.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - sweep_start).count());
+    if (success) {
+      result.num_sweeps++;
+      result.num_bytes += bytes_per_sweep;
+    } else {
+      result.num_failed++;
+    }
+  }
+  result.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+// recv() into the capture buffer, delay and guard dropped on the way
+BenchResult RunCapture(BenchSetup &setup) {
+  return Measure(setup.options.warmup, setup.options.num_sweeps, setup.capture_bytes(),
+                 setup.InjectOverflow([&]() { return setup.Capture(); }));
+}
+
+// one raw capture per sweep to a loopback sink
+BenchResult RunUdp(BenchSetup &setup) {
+  setup.Capture();
+  UdpSink sink;
+  UdpStreamer udp_streamer("127.0.0.1", std::to_string(sink.port()), setup.options.udp_size,
+                           setup.options.udp_rate * 1e6);
+  BenchResult result = Measure(setup.options.warmup, setup.options.num_sweeps, setup.wire_bytes(), [&]() {
+    setup.SendRaw(udp_streamer);
+    return true;
+  });
+  const uint64_t num_sent = (setup.options.warmup + setup.options.num_sweeps) * setup.wire_bytes();
+  sink.WaitFor(num_sent, kSinkTimeout);
+  sink.Stop();
+  char note[64];
+  std::snprintf(note, sizeof(note), "lost %.2f%%", 100.0 * static_cast<double>(num_sent - sink.num_bytes()) /
+      static_cast<double>(num_sent));
+  result.note = note;
+  return result;
+}
+
+// CTF of every slot, MB/s counts the samples going in
+BenchResult RunCtf(BenchSetup &setup) {
+  setup.Capture();
+  CtfEngine ctf_engine(setup.reference, setup.config.num_samps, setup.options.ctf_ratio);
+  const CaptureLayout &layout = setup.layout;
+  std::vector<std::complex<float>> ctf_buff(layout.num_slots() * ctf_engine.num_bins());
+  BenchResult result = Measure(setup.options.warmup, setup.options.num_sweeps, setup.capture_bytes(), [&]() {
+    for (size_t slot = 0; slot < layout.num_slots(); slot++) {
+      // the CTF uses the last num_samps samples of the slot, as the cores do
+      const size_t offset = layout.offset(slot) + layout.kept(slot) - ctf_engine.num_samps();
+      std::complex<float> *ctf = &ctf_buff[slot * ctf_engine.num_bins()];
+      if (setup.buff.format() == SampleFormat::kSc16) {
+        ctf_engine.Process(setup.buff.sc16(offset), ctf);
+      } else {
+        ctf_engine.Process(setup.buff.fc32(offset), ctf);
+      }
+    }
+    return true;
+  });
+  result.note = std::to_string(ctf_engine.num_bins()) + " bins/slot";
+  return result;
+}
+
+// deletes the segments a recorder wrote with prefix
+void RemoveSegments(const std::string &prefix) {
+  for (size_t segment = 0;; segment++) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%04zu.dat", segment);
+    if (std::remove((prefix + name).c_str()) != 0) break;
+  }
+}
+
+// Record() per sweep as fast as the disk takes them: a sweep that finds the pool full is tried again, so
+// sweeps/s and MB/s are the sustained disk rate (drain included) and the latency includes that wait
+BenchResult RunRecord(BenchSetup &setup) {
+  setup.Capture();
+  const std::string prefix = setup.options.record_dir + "/bench_record";
+  RecorderOptions recorder_options;
+  recorder_options.prefix = prefix;
+  std::memset(&recorder_options.config, 0, sizeof(recorder_options.config));
+  recorder_options.config.rate = setup.config.rate;
+  recorder_options.config.sample_format = static_cast<uint32_t>(setup.options.sample_format);
+  recorder_options.config.num_samps = static_cast<uint32_t>(setup.config.num_samps);
+  recorder_options.config.rx_ports = static_cast<uint32_t>(setup.pattern.num_rx_ports());
+  recorder_options.config.tx_ports = static_cast<uint32_t>(setup.pattern.num_tx_ports());
+  recorder_options.config.guard = static_cast<uint32_t>(setup.options.guard);
+  std::snprintf(recorder_options.config.device, sizeof(recorder_options.config.device), "%s",
+                setup.options.sim_args.c_str());
+  std::snprintf(recorder_options.config.pattern, sizeof(recorder_options.config.pattern), "%s",
+                setup.pattern.ToString(2 * setup.config.num_samps).c_str());
+  recorder_options.max_record_bytes = setup.capture_bytes();
+  recorder_options.segment_bytes = setup.options.segment_size << 20;
+  recorder_options.direct_io = setup.options.direct_io;
+
+  std::unique_ptr<CaptureRecorder> recorder(new CaptureRecorder(recorder_options));
+  double device_time = 0;
+  size_t num_waits = 0;
+  // the pool only makes sense with the disk behind it, so nothing is recorded before the measurement
+  BenchResult result = Measure(0, setup.options.num_sweeps, setup.capture_bytes(), [&]() {
+    device_time += 0.2;
+    if (recorder->Record(setup.buff.at(0), setup.capture_bytes(), device_time,
+                         static_cast<uint32_t>(setup.options.sample_format))) {
+      return true;
+    }
+    num_waits++;
+    while (!recorder->Record(setup.buff.at(0), setup.capture_bytes(), device_time,
+                             static_cast<uint32_t>(setup.options.sample_format))) {
+      std::this_thread::yield();
+    }
+    return true;
+  });
+  const auto drain_start = std::chrono::steady_clock::now();
+  recorder.reset();
+  result.elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - drain_start).count();
+  result.note = "waited for the pool on " + std::to_string(num_waits) + " sweeps";
+  RemoveSegments(prefix);
+  return result;
+}
+
+// Control command to the last datagram at the client: SocketWorker, the capture server of txrx_core, on a loopback
+// TCP connection with the samples to a loopback sink. Every capture takes the path of the core, with --pipeline,
+// --loop-ctf, --average and --loop-record as set, and starts at a sweep boundary as there: at most 5 sweeps/s.
+BenchResult RunLoop(BenchSetup &setup) {
+  const BenchOptions &options = setup.options;
+  BenchResult result;
+  // the plan of the server as the core builds it, the waveform from a file
+  SweepConfig sweep_config;
+  sweep_config.device.channels = {0};
+  sweep_config.device.rate = setup.radio->get_rx_rate();
+  sweep_config.tx_file = options.record_dir + "/bench_waveform.dat";
+  sweep_config.num_samps = setup.config.num_samps;
+  sweep_config.tx_ports = setup.config.tx_ports;
+  sweep_config.rx_ports = setup.config.rx_ports;
+  sweep_config.guard = options.guard;
+  sweep_config.ctf = options.loop_ctf;
+  sweep_config.ctf_ratio = options.ctf_ratio;
+  uhd::tx_streamer::sptr tx_stream = setup.radio->get_tx_stream(uhd::stream_args_t("fc32", "sc16"));
+  std::shared_ptr<SweepPlan> plan;
+  {
+    std::ofstream waveform(sweep_config.tx_file, std::ofstream::binary);
+    waveform.write(reinterpret_cast<const char *>(setup.reference.data()),
+                   static_cast<std::streamsize>(setup.reference.size() * sizeof(setup.reference.front())));
+  }
+  try {
+    plan = BuildSweepPlan(sweep_config, 1, tx_stream->get_max_num_samps(), MAN_GPIO_MASK);
+  } catch (std::runtime_error &e) {
+    // a sweep longer than the sweep period is nothing the core would run
+    std::remove(sweep_config.tx_file.c_str());
+    result.note = std::string("skipped: ") + e.what();
+    return result;
+  }
+  std::remove(sweep_config.tx_file.c_str());
+  PlanHandoff plans(plan);
+  GpioScheduler gpio(setup.radio, sweep_config.device.rate, ATR_MASKS);
+
+  UdpSink sink;
+  std::vector<std::unique_ptr<UdpStreamer>> udp_streamers;
+  udp_streamers.emplace_back(new UdpStreamer("127.0.0.1", std::to_string(sink.port()), options.udp_size,
+                                             options.udp_rate * 1e6));
+  const std::string prefix = options.record_dir + "/bench_loop";
+  std::unique_ptr<CaptureRecorder> recorder;
+  if (options.loop_record) {
+    RecorderOptions recorder_options;
+    recorder_options.prefix = prefix;
+    recorder_options.config = RecordConfig(*plan, *setup.radio, options.sim_args, options.sample_format, 1);
+    recorder_options.max_record_bytes = plan->layout->capture_samps() * SampleSize(options.sample_format);
+    recorder_options.segment_bytes = options.segment_size << 20;
+    recorder_options.direct_io = options.direct_io;
+    recorder.reset(new CaptureRecorder(recorder_options));
+  }
+
+  boost::asio::io_context io_context;
+  boost::asio::ip::tcp::acceptor acceptor(
+      io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  std::thread server([&]() {
+    try {
+      SocketWorker(io_context, acceptor, setup.radio, setup.rx_stream, tx_stream, plans, false, udp_streamers, "",
+                   options.sim_args, options.pipeline, std::max<size_t>(options.num_average, 1), false,
+                   options.sample_format, nullptr, recorder.get(), gpio, "");
+    } catch (std::exception &e) {
+      // the client closing the connection ends the server
+    }
+  });
+  boost::asio::ip::tcp::socket client(io_context);
+  // the server ends once the client is gone, however the measurement ends
+  ScopeExit join_server([&]() {
+    boost::system::error_code error;
+    // a server still waiting for the client is let go by connecting and leaving at once
+    if (!client.is_open()) client.connect(acceptor.local_endpoint(), error);
+    client.close(error);
+    server.join();
+  });
+  client.connect(acceptor.local_endpoint());
+  char connected;
+  boost::asio::read(client, boost::asio::buffer(&connected, 1));
+
+  ControlHeader request{{kControlMagic[0], kControlMagic[1]}, kControlVersion,
+                        static_cast<uint8_t>(CommandId::kCapture), sizeof(CapturePayload)};
+  CapturePayload payload{1, 0, kCaptureSendUdp};
+  const uint64_t sent_before = udp_bytes.value();
+  uint64_t num_lost = 0;
+  auto sweep = setup.InjectOverflow([&]() {
+    std::vector<boost::asio::const_buffer> buffers{boost::asio::buffer(&request, sizeof(request)),
+                                                   boost::asio::buffer(&payload, sizeof(payload))};
+    boost::asio::write(client, buffers);
+    ControlHeader reply;
+    CaptureReplyPayload reply_payload;
+    boost::asio::read(client, boost::asio::buffer(&reply, sizeof(reply)));
+    boost::asio::read(client, boost::asio::buffer(&reply_payload, sizeof(reply_payload)));
+    if (reply.code != static_cast<uint8_t>(ReplyStatus::kCaptureDone)) return false;
+    // everything the server sent for the capture is out when it replies
+    const uint64_t num_expected = udp_bytes.value() - sent_before - num_lost;
+    // a lost datagram fails the sweep, the next one counts from what arrived
+    if (!sink.WaitFor(num_expected, kSinkTimeout)) {
+      num_lost += num_expected - sink.num_bytes();
+      return false;
+    }
+    return true;
+  });
+  Measure(0, options.warmup, 0, sweep);
+  const uint64_t measured_from = udp_bytes.value();
+  result = Measure(0, options.loop_sweeps, 0, sweep);
+  result.num_bytes = udp_bytes.value() - measured_from;
+  result.note = std::string(options.loop_ctf ? "ctf" : "raw") + (options.pipeline ? ", pipeline" : "")
+      + (options.num_average > 1 ? ", average " + std::to_string(options.num_average) : "")
+      + (options.loop_record ? ", recorded" : "");
+  if (recorder) {
+    recorder.reset();
+    RemoveSegments(prefix);
+  }
+  return result;
+}
+
+double Percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) return 0;
+  const auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void PrintHeader() {
+  std::printf("%-8s %10s %7s %6s %9s %9s %8s %8s %8s %8s %7s  %s\n", "case", "rate", "samps", "ports",
+              "sweeps/s", "MB/s", "p50 ms", "p90 ms", "p99 ms", "max ms", "failed", "note");
+}
+
+void Report(const std::string &name, const BenchConfig &config, BenchResult result, std::FILE *csv) {
+  std::sort(result.latencies.begin(), result.latencies.end());
+  const double sweeps_per_second = result.elapsed > 0 ? static_cast<double>(result.num_sweeps) / result.elapsed : 0;
+  const double megabytes_per_second =
+      result.elapsed > 0 ? static_cast<double>(result.num_bytes) / result.elapsed / 1e6 : 0;
+  const double p50 = Percentile(result.latencies, 0.5) * 1e3, p90 = Percentile(result.latencies, 0.9) * 1e3;
+  const double p99 = Percentile(result.latencies, 0.99) * 1e3, max = Percentile(result.latencies, 1.0) * 1e3;
+  const std::string ports = std::to_string(config.tx_ports) + "x" + std::to_string(config.rx_ports);
+  std::printf("%-8s %10.0f %7zu %6s %9.1f %9.1f %8.3f %8.3f %8.3f %8.3f %7zu  %s\n", name.c_str(), config.rate,
+              config.num_samps, ports.c_str(), sweeps_per_second, megabytes_per_second, p50, p90, p99, max,
+              result.num_failed, result.note.c_str());
+  std::fflush(stdout);
+  if (csv) {
+    std::fprintf(csv, "%s,%.0f,%zu,%zu,%zu,%.3f,%.3f,%.6f,%.6f,%.6f,%.6f,%zu,%s\n", name.c_str(), config.rate,
+                 config.num_samps, config.tx_ports, config.rx_ports, sweeps_per_second, megabytes_per_second,
+                 p50, p90, p99, max, result.num_failed, result.note.c_str());
+  }
+}
+
+template <typename T>
+std::vector<T> ParseList(const std::string &text) {
+  std::vector<std::string> items;
+  boost::split(items, text, boost::is_any_of(","), boost::token_compress_on);
+  std::vector<T> values;
+  for (auto &item : items) {
+    boost::trim(item);
+    if (!item.empty()) values.push_back(boost::lexical_cast<T>(item));
+  }
+  if (values.empty()) throw std::runtime_error("Empty list: " + text);
+  return values;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  // variables to be set by po
+  std::string rates, samps, tx_ports, rx_ports, cases, type, csv_path;
+  BenchOptions options;
+  bool paced, verbose;
+
+  po::options_description desc("Allowed options");
+  // clang-format off
+  desc.add_options()
+      ("help", "help message")
+      ("rate", po::value<std::string>(&rates)->default_value("1e6,10e6,50e6"), "rates of samples/sec, comma separated")
+      ("samps", po::value<std::string>(&samps)->default_value("1024,4096"), "samples per port, comma separated")
+      ("tx-ports", po::value<std::string>(&tx_ports)->default_value("8"), "tx port counts, comma separated")
+      ("rx-ports", po::value<std::string>(&rx_ports)->default_value("8"), "rx port counts, comma separated")
+      ("cases", po::value<std::string>(&cases)->default_value("capture,udp,ctf,record,loop"),
+          "stages to measure: capture, udp, ctf, record, loop (command to data at the client)")
+      ("sweeps", po::value<size_t>(&options.num_sweeps)->default_value(200), "measured sweeps per case")
+      ("loop-sweeps", po::value<size_t>(&options.loop_sweeps)->default_value(25),
+          "measured sweeps of the loop case, which captures on the 200 ms sweep grid")
+      ("warmup", po::value<size_t>(&options.warmup)->default_value(5), "sweeps run before measuring")
+      ("type", po::value<std::string>(&type)->default_value("sc16"), "sample type: sc16 or fc32")
+      ("guard", po::value<size_t>(&options.guard)->default_value(0), "samples dropped at the start of every port slot")
+      ("udp-size", po::value<size_t>(&options.udp_size)->default_value(16000), "UDP payload bytes per datagram")
+      ("udp-rate", po::value<double>(&options.udp_rate)->default_value(0), "UDP send rate limit in MB/s, 0: none")
+      ("ctf-ratio", po::value<double>(&options.ctf_ratio)->default_value(0.5), "band kept by the CTF")
+      ("record-dir", po::value<std::string>(&options.record_dir)->default_value("."),
+          "directory of the record case, its segments are deleted afterwards")
+      ("segment-size", po::value<size_t>(&options.segment_size)->default_value(1024), "record segment size in MB")
+      ("buffered-io", "record through the page cache instead of O_DIRECT")
+      ("pipeline", po::bool_switch(&options.pipeline), "loop: send each port slot while the capture is still running")
+      ("loop-ctf", po::bool_switch(&options.loop_ctf), "loop: send the CTF of every slot instead of the raw samples")
+      ("average", po::value<size_t>(&options.num_average)->default_value(1), "loop: snapshots averaged per capture")
+      ("loop-record", po::bool_switch(&options.loop_record), "loop: also record every snapshot to --record-dir")
+      ("paced", po::bool_switch(&paced), "deliver samples at the sample rate instead of as fast as possible")
+      ("sim-args", po::value<std::string>(&options.sim_args)->default_value(""),
+          "more simulated radio arguments, see sim_radio.hpp")
+      ("inject-overflow-at", po::value<size_t>(&options.inject_overflow_at)->default_value(0),
+          "overflow the radio before this measured sweep of the capture and loop cases, which then fails (0: none)")
+      ("csv", po::value<std::string>(&csv_path), "also write the results to this CSV file")
+      ("verbose", po::bool_switch(&verbose), "keep the info logs of the pipeline");
+  // clang-format on
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << "bench [options], the capture pipeline on the simulated radio" << std::endl << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+  if (!verbose) spdlog::set_level(spdlog::level::warn);
+
+  try {
+    options.sample_format = ParseSampleFormat(type);
+    options.direct_io = !vm.count("buffered-io");
+    options.sim_args = "type=sim,sim_paced=" + std::string(paced ? "1" : "0")
+        + (options.sim_args.empty() ? "" : "," + options.sim_args);
+
+    std::vector<BenchConfig> configs;
+    for (double rate : ParseList<double>(rates)) {
+      for (size_t num_samps : ParseList<size_t>(samps)) {
+        for (size_t tx : ParseList<size_t>(tx_ports)) {
+          for (size_t rx : ParseList<size_t>(rx_ports)) configs.push_back({rate, num_samps, tx, rx});
+        }
+      }
+    }
+    const std::vector<std::string> case_names = ParseList<std::string>(cases);
+    const std::vector<std::pair<std::string, std::function<BenchResult(BenchSetup &)>>> all_cases{
+        {"capture", RunCapture}, {"udp", RunUdp}, {"ctf", RunCtf}, {"record", RunRecord}, {"loop", RunLoop}};
+    for (const auto &name : case_names) {
+      if (std::none_of(all_cases.begin(), all_cases.end(), [&](const decltype(all_cases[0]) &c) {
+        return c.first == name;
+      })) {
+        throw std::runtime_error("Unknown case: " + name);
+      }
+    }
+
+    std::FILE *csv = nullptr;
+    if (!csv_path.empty()) {
+      csv = std::fopen(csv_path.c_str(), "w");
+      if (!csv) throw std::runtime_error("Could not open " + csv_path);
+      std::fprintf(csv, "case,rate,samps,tx_ports,rx_ports,sweeps_per_s,mb_per_s,p50_ms,p90_ms,p99_ms,max_ms,"
+                   "failed,note\n");
+    }
+
+    std::printf("%s, %zu sweeps per case, %s\n", CpuFormat(options.sample_format), options.num_sweeps,
+                paced ? "paced at the sample rate" : "unpaced");
+    PrintHeader();
+    for (const auto &config : configs) {
+      BenchSetup setup(config, options);
+      for (const auto &bench_case : all_cases) {
+        if (std::find(case_names.begin(), case_names.end(), bench_case.first) == case_names.end()) continue;
+        Report(bench_case.first, config, bench_case.second(setup), csv);
+      }
+    }
+    if (csv) std::fclose(csv);
+  } catch (std::exception &e) {
+    spdlog::error("{}", e.what());
+    return ~0;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,13 @@
+function [band, freq, isStitched] = bandheader(data)
+%BANDHEADER 周波数ホッピング (--hop) の各バンドの前に送られるBANDヘッダを読む
+%   band: --hopのリストでの番号 (1から)，freq: 中心周波数 [Hz]
+%   --stitch の結合CTFでは isStitched = true，freqは先頭ビンの周波数
+data = reshape(uint8(data),1,[]);
+if numel(data) < 16 || ~strcmp(char(data(1:4)),'BAND')
+    error("BAND header not found")
+end
+rawBand = typecast(data(5:8),'uint32');
+isStitched = rawBand == intmax('uint32');
+band = double(rawBand) + 1;
+freq = typecast(data(9:16),'double');
+end
@@ -0,0 +1,22 @@
+function sock = connectcore(addr, port, timeout)
+%CONNECTCORE コアに接続する
+%   起動中のコアは接続を拒否するので，timeout秒になるまで0.2秒おきに再試行する
+%   (起動を固定時間待つ代わり)．接続完了通知 '0' はデバイスの準備ができてから届く
+arguments
+    addr
+    port
+    timeout (1,1) double = 60
+end
+t = tic;
+while(true)
+    try
+        sock = tcpclient(addr, port);
+        return
+    catch err
+        if toc(t) > timeout
+            rethrow(err)
+        end
+        pause(.2)
+    end
+end
+end
@@ -1,7 +1,7 @@
-function doubleVal = cplx2double(data)
-dataSize = size(data);
-dataSize(1) = dataSize(1)*2;
-doubleVal = zeros(dataSize);
-doubleVal(1:2:end,:) = real(data);
-doubleVal(2:2:end,:) = real(data);
+function doubleVal = cplx2double(data)
+dataSize = size(data);
+dataSize(1) = dataSize(1)*2;
+doubleVal = zeros(dataSize);
+doubleVal(1:2:end,:) = real(data);
+doubleVal(2:2:end,:) = real(data);
 end
\ No newline at end of file
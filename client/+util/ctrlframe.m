@@ -0,0 +1,24 @@
+function frame = ctrlframe(command, count, link, sendUdp, label)
+%CTRLFRAME txrx_coreのバイナリ制御フレームを作成する
+%   command: 1 = 送信開始, 2 = 送信停止, 3 = 受信 (count回連続), 4 = 統計, 5 = トレース書き出し,
+%            6 = 設定変更 (labelに "freq=5.2e9" のような key=value を改行区切りで，例 ctrlframe(6,[],[],[],settings))
+%   返信は8バイトのヘッダ ('CS', version, status, length) + payload
+%   受信の返信payloadは uint32 [index count]，statusは 3 = 成功, 4 = 失敗
+%   統計の返信はstatus 7，payloadはPrometheusテキスト形式の文字列
+%   トレースの返信はstatus 8 (--trace未指定なら失敗)
+%   設定変更の返信はstatus 9，payloadは新しい設定が有効になる時刻 (double)．失敗時はstatus 6，payloadは理由
+%   キー: freq, lo-off, rx-gain, tx-gain, bw, rate (送信停止中のみ), samps, tx-ports, rx-ports, pattern,
+%         pattern-file, delay, guard, tx-file, ctf-ratio, hop ("4e9,4.1e9" の周波数リスト，off で単一バンド),
+%         stitch (0/1), sync (0/1), at (適用時刻，200 msの境界に切り上げ)
+if nargin < 2 || isempty(count), count = 1; end
+if nargin < 3 || isempty(link), link = 0; end
+if nargin < 4 || isempty(sendUdp), sendUdp = true; end
+if nargin < 5, label = ""; end
+payload = uint8([]);
+if command == 3
+    payload = [typecast(uint32([count link logical(sendUdp)]),'uint8') uint8(char(label))];
+elseif command == 6
+    payload = uint8(char(label));
+end
+frame = [uint8('CS') uint8(1) uint8(command) typecast(uint32(numel(payload)),'uint8') payload];
+end
@@ -0,0 +1,11 @@
+function complexVal = sc16tocplx(data)
+%SC16TOCPLX SC16ヘッダ付きUDPデータ (--type short) を複素数に変換する
+data = reshape(uint8(data),1,[]);
+if ~strcmp(char(data(1:4)),'SC16')
+    error("SC16 header not found")
+end
+numSamps = double(typecast(data(5:8),'uint32'));
+scale = double(typecast(data(9:12),'single'));
+iq = double(typecast(data(17:16+numSamps*4),'int16'))*scale;
+complexVal = util.tocplx(iq).';
+end
@@ -49,7 +49,6 @@ if isunix
     end
 else
     system(execPath + ".exe " + args + " & exit &");
-    pause(20)
 end
 
 Logger.info("Attempt to connect the UDP socket...")
@@ -57,7 +56,7 @@ udpSock = udpport("LocalHost",ADDR,"LocalPort",UDP_PORT,"Timeout",0.1);
 Logger.info("Successfully connected UDP socket!")
 udpSock.flush
 Logger.info("Attempt to connect the TCP socket...")
-tcpSock = tcpclient(ADDR,TCP_PORT);
+tcpSock = util.connectcore(ADDR,TCP_PORT);
 Logger.info("Successfully connected TCP socket!")
 
 %% data acquisition
@@ -26,13 +26,12 @@ args = sprintf("--freq %.3fe9 --rate %de6 --lo_off -1 --rx-gain 37.5" + ...
     freq/1e9, rate/1e6, nSampsPerOnce, 8 ,8, nDelayTotal, string(TCP_PORT));
 system("..\txrx_core\build\txrx_core.exe " + args + " & exit &");
 
-pause(20)
 Logger.info("Attempt to connect the UDP socket...")
 udpSock = udpport("LocalHost",ADDR,"LocalPort",UDP_PORT,"Timeout",0.1);
 Logger.info("Successfully connected UDP socket!")
 udpSock.flush
 Logger.info("Attempt to connect the TCP socket...")
-tcpSock = tcpclient(ADDR,TCP_PORT);
+tcpSock = util.connectcore(ADDR,TCP_PORT);
 Logger.info("Successfully connected TCP socket!")
 
 %% data acquisition
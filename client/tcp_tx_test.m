@@ -38,12 +38,11 @@ if isunix
     end
 else
     system(execPath + ".exe " + args + " & exit &");
-    pause(20)
 end
 
 udpSock = udpport("LocalHost",ADDR,"LocalPort",UDP_PORT,"Timeout",0.1);
 udpSock.flush
-tcpSock = tcpclient(ADDR,TCP_PORT);
+tcpSock = util.connectcore(ADDR,TCP_PORT);
 
 %% data acquisition
 udpSock.Timeout = 1;
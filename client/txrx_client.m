@@ -21,14 +21,14 @@ nSampsPerOnce = 256;
 nTxPort = 8;
 nRxPort = 8;
 nSampsTotal = nSampsPerOnce * nTxPort * nRxPort * 2;
-nDelayTotal = 256*8*8*2;    %txrx_coreの仕様上，送信信号と同期を取るためnSampsPerOnce(=256)の倍数である必要があります
+nDelayTotal = 0;    %--syncで送信信号の到来位置を相関で求めるので不要 (--syncなしではnSampsPerOnce(=256)の倍数)
 
 nMeasure = 10;
 
 %% setup udp and tcp socket
 
 args = sprintf("--tx-file %s --freq %.3fe9 --rate %de6 --lo_off -1 --tx-gain 20 --rx-gain 15" + ...
-    " --rx-ant TX/RX --ref %s --samps %d --tx-ports %d --rx-ports %d --delay %d" + ...
+    " --rx-ant TX/RX --ref %s --samps %d --tx-ports %d --rx-ports %d --delay %d --sync" + ...
     " --tcp-port %s --repeat", ...
     txFile, freq/1e9, rate/1e6, ref, nSampsPerOnce, nTxPort ,nRxPort, nDelayTotal, string(TCP_PORT));
 if isunix
@@ -53,12 +53,11 @@ if isunix
     end
 else
     system(execPath + ".exe " + args + " & exit &");
-    pause(20)
 end
 
 core_udpSock = udpport("LocalHost",CORE_ADDR,"LocalPort",CORE_UDP_PORT,"Timeout",0.1);
 core_udpSock.flush
-core_tcpSock = tcpclient(CORE_ADDR,CORE_TCP_PORT);
+core_tcpSock = util.connectcore(CORE_ADDR,CORE_TCP_PORT);
 core_udpSock.Timeout = 1;
 
 master_tcpSock = tcpserver(MASTER_TCP_PORT, "Timeout", 600);    %10分間応答が無いとタイムアウト
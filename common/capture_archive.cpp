@@ -0,0 +1,155 @@
+#include "capture_archive.hpp"
+#include "capture_buffer.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint64_t HashConfig(const ArchiveConfig &config) {
+  const auto *bytes = reinterpret_cast<const unsigned char *>(&config);
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < sizeof(config); i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+void SetArchiveLayout(ArchiveConfig &config, const SwitchPattern &pattern, size_t num_samps, size_t guard,
+                      size_t num_delay, size_t num_channels, const std::string &device) {
+  const std::string pattern_string = pattern.ToString(num_samps * 2);
+  if (pattern_string.size() >= sizeof(config.pattern)) {
+    throw std::runtime_error("The switch pattern is too long for the --record header");
+  }
+  config.num_samps = static_cast<uint32_t>(num_samps);
+  config.rx_ports = static_cast<uint32_t>(pattern.num_rx_ports());
+  config.tx_ports = static_cast<uint32_t>(pattern.num_tx_ports());
+  config.guard = static_cast<uint32_t>(guard);
+  config.num_delay = static_cast<uint32_t>(num_delay);
+  config.num_channels = static_cast<uint32_t>(num_channels);
+  std::snprintf(config.device, sizeof(config.device), "%s", device.c_str());
+  std::snprintf(config.pattern, sizeof(config.pattern), "%s", pattern_string.c_str());
+}
+
+ArchiveReader::ArchiveReader(const std::string &path) {
+#if defined(_WIN32)
+  file_handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle_ == INVALID_HANDLE_VALUE) throw std::runtime_error("Could not open " + path);
+  LARGE_INTEGER size;
+  GetFileSizeEx(file_handle_, &size);
+  file_size_ = static_cast<size_t>(size.QuadPart);
+  if (file_size_ > 0) {
+    mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle_) data_ = static_cast<const char *>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+  }
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+  struct stat st;
+  fstat(fd, &st);
+  file_size_ = static_cast<size_t>(st.st_size);
+  if (file_size_ > 0) {
+    void *p = mmap(nullptr, file_size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) data_ = static_cast<const char *>(p);
+  }
+  // the mapping keeps the file alive
+  close(fd);
+#endif
+  if (!data_ or file_size_ < sizeof(ArchiveHeader)) {
+    Unmap();
+    throw std::runtime_error("Could not map " + path);
+  }
+
+  std::memcpy(&header_, data_, sizeof(header_));
+  if (std::memcmp(header_.magic, "CSAR", 4) != 0 or header_.version != kArchiveVersion) {
+    Unmap();
+    throw std::runtime_error(path + " is not a capture archive");
+  }
+
+  // slots of the capture, the guard interval of every slot was dropped while receiving
+  const ArchiveConfig &config = header_.config;
+  const std::string pattern(config.pattern, strnlen(config.pattern, sizeof(config.pattern)));
+  try {
+    pattern_ = SwitchPattern::Parse(pattern, 2 * config.num_samps);
+  } catch (std::exception &) {
+    Unmap();
+    throw;
+  }
+  slot_offsets_.push_back(0);
+  for (const auto &slot : pattern_.slots()) slot_offsets_.push_back(slot_offsets_.back() + slot.dwell - config.guard);
+
+  const uint64_t index_bytes = header_.num_captures * sizeof(IndexEntry);
+  if (header_.index_offset != 0 and header_.index_offset + index_bytes <= file_size_) {
+    index_.resize(header_.num_captures);
+    std::memcpy(index_.data(), data_ + header_.index_offset, index_bytes);
+  } else {
+    RebuildIndex();
+  }
+}
+
+size_t ArchiveReader::Slot(uint32_t tx_port, uint32_t rx_port) const {
+  const size_t slot = pattern_.Find(tx_port, rx_port);
+  if (slot == pattern_.size()) {
+    throw std::runtime_error("Port pair " + std::to_string(tx_port) + ":" + std::to_string(rx_port)
+                                 + " is not in the switch pattern");
+  }
+  return slot;
+}
+
+ArchiveReader::~ArchiveReader() {
+  Unmap();
+}
+
+void ArchiveReader::Unmap() {
+#if defined(_WIN32)
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_handle_) CloseHandle(mapping_handle_);
+  if (file_handle_ and file_handle_ != INVALID_HANDLE_VALUE) CloseHandle(file_handle_);
+  mapping_handle_ = file_handle_ = nullptr;
+#else
+  if (data_) munmap(const_cast<char *>(data_), file_size_);
+#endif
+  data_ = nullptr;
+}
+
+void ArchiveReader::RebuildIndex() {
+  // walk the record headers until the preallocated (zero) tail or a torn record
+  recovered_ = true;
+  uint64_t offset = header_.header_bytes;
+  while (offset + sizeof(RecordHeader) <= file_size_) {
+    RecordHeader record;
+    std::memcpy(&record, data_ + offset, sizeof(record));
+    if (std::memcmp(record.magic, "CREC", 4) != 0 or record.record_bytes == 0
+        or offset + record.record_bytes > file_size_) {
+      break;
+    }
+    index_.push_back({offset, record.payload_bytes, record.sequence, record.device_time, record.config_hash,
+                      record.link, record.sample_format});
+    offset += record.record_bytes;
+  }
+  header_.num_captures = index_.size();
+}
+
+const void *ArchiveReader::payload(size_t capture) const {
+  return data_ + entry(capture).offset + sizeof(RecordHeader);
+}
+
+double ArchiveReader::freq(size_t capture) const {
+  RecordHeader record;
+  std::memcpy(&record, data_ + entry(capture).offset, sizeof(record));
+  return record.freq != 0 ? record.freq : header_.config.freq;
+}
+
+size_t ArchiveReader::sample_size() const {
+  return SampleSize(static_cast<SampleFormat>(header_.config.sample_format));
+}
@@ -0,0 +1,138 @@
+#ifndef COMMON_CAPTURE_ARCHIVE_HPP_
+#define COMMON_CAPTURE_ARCHIVE_HPP_
+
+#include "switch_pattern.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk format of the --record segment files.
+//
+//   ArchiveHeader, padded to kRecordAlignment
+//   record 0: RecordHeader + samples, padded to kRecordAlignment
+//   record 1: ...
+//   IndexEntry[num_captures], padded to kRecordAlignment  (written when the segment is closed)
+//
+// index_offset is 0 while the segment is being written, a reader then rebuilds the index from the
+// record headers. All fields are little endian.
+
+// Block size of the segment files. Records start on a block boundary so that they can be
+// written with O_DIRECT and mapped without copying.
+const size_t kRecordAlignment = 4096;
+const uint32_t kArchiveVersion = 2;
+
+// Measurement setup shared by every capture of a segment.
+// Zero-initialize before filling it in, the config hash covers the padding as well.
+struct ArchiveConfig {
+  double rate;
+  double freq;
+  double rx_gain;
+  double tx_gain;
+  uint32_t sample_format;  // SampleFormat
+  uint32_t num_samps;      // samples per port (half of a default port slot)
+  uint32_t rx_ports;       // highest port of the pattern + 1
+  uint32_t tx_ports;
+  uint32_t guard;
+  uint32_t num_delay;
+  uint32_t tx_node;        // link / tx node of the measurement, per capture in IndexEntry::link
+  uint32_t num_channels;   // rx channels per capture, one after the other (0 in older segments: 1)
+  char device[128];        // UHD device args
+  char pattern[1024];      // switch pattern of the sweep, SwitchPattern::ToString(2 * num_samps)
+};
+
+struct ArchiveHeader {
+  char magic[4];           // "CSAR"
+  uint32_t version;        // kArchiveVersion
+  uint32_t header_bytes;   // offset of the first record
+  uint32_t reserved;
+  uint64_t index_offset;   // 0 until the segment is closed
+  uint64_t num_captures;
+  uint64_t config_hash;
+  ArchiveConfig config;
+};
+
+// In front of every record. The payload follows header_bytes after the start of the record, the next
+// record starts record_bytes after it.
+struct RecordHeader {
+  char magic[4];           // "CREC"
+  uint32_t header_bytes;   // sizeof(RecordHeader)
+  uint64_t payload_bytes;
+  uint64_t record_bytes;   // header + payload + padding to kRecordAlignment
+  uint64_t sequence;       // counts every capture, gaps are dropped captures
+  double device_time;      // start of the capture in device time
+  uint32_t sample_format;  // SampleFormat
+  uint32_t link;
+  uint64_t config_hash;
+  double freq;             // center frequency of the capture, 0 in older records: ArchiveConfig::freq
+};
+static_assert(sizeof(RecordHeader) == 64, "RecordHeader must stay 64 bytes");
+
+struct IndexEntry {
+  uint64_t offset;         // of the RecordHeader in the file
+  uint64_t payload_bytes;
+  uint64_t sequence;
+  double device_time;
+  uint64_t config_hash;
+  uint32_t link;
+  uint32_t sample_format;
+};
+
+// FNV-1a of the config, tells captures taken with different settings apart
+uint64_t HashConfig(const ArchiveConfig &config);
+
+// Fills in the layout of the captures: num_samps, the ports and the text form of pattern (default dwell
+// 2 * num_samps), guard, num_delay, num_channels and the device args. Throws when the pattern does not fit.
+void SetArchiveLayout(ArchiveConfig &config, const SwitchPattern &pattern, size_t num_samps, size_t guard,
+                      size_t num_delay, size_t num_channels, const std::string &device);
+
+// Read-only view of one segment file. The file is memory mapped, so opening it reads the header and
+// the index only and samples are paged in when they are touched.
+class ArchiveReader {
+ public:
+  explicit ArchiveReader(const std::string &path);
+  ~ArchiveReader();
+  ArchiveReader(const ArchiveReader &) = delete;
+  ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+  const ArchiveHeader &header() const { return header_; }
+  size_t size() const { return index_.size(); }
+  const IndexEntry &entry(size_t capture) const { return index_.at(capture); }
+
+  // samples of a capture, num_slots() port slots in pattern order, slot k is slot_samps(k) samples long,
+  // repeated for every channel (channel k starts at k * channel_samps())
+  const void *payload(size_t capture) const;
+  // center frequency of a capture, the band of a frequency hopping sweep
+  double freq(size_t capture) const;
+  size_t sample_size() const;
+  size_t num_channels() const { return header_.config.num_channels > 0 ? header_.config.num_channels : 1; }
+  size_t channel_samps() const { return slot_offsets_.back(); }
+  const SwitchPattern &pattern() const { return pattern_; }
+  size_t num_slots() const { return pattern_.size(); }
+  size_t slot_offset(size_t slot) const { return slot_offsets_.at(slot); }
+  size_t slot_samps(size_t slot) const { return slot_offsets_.at(slot + 1) - slot_offsets_.at(slot); }
+  // first slot of the port pair, throws if the pattern does not visit it
+  size_t Slot(uint32_t tx_port, uint32_t rx_port) const;
+
+  // true if the segment was not closed and the index was rebuilt from the record headers
+  bool recovered() const { return recovered_; }
+
+ private:
+  void RebuildIndex();
+  void Unmap();
+
+  const char *data_ = nullptr;
+  size_t file_size_ = 0;
+#if defined(_WIN32)
+  void *file_handle_ = nullptr;
+  void *mapping_handle_ = nullptr;
+#endif
+  ArchiveHeader header_;
+  SwitchPattern pattern_;
+  std::vector<size_t> slot_offsets_;  // num_slots() + 1 entries, the last one is the capture size
+  std::vector<IndexEntry> index_;
+  bool recovered_ = false;
+};
+
+#endif // COMMON_CAPTURE_ARCHIVE_HPP_
@@ -0,0 +1,163 @@
+#ifndef COMMON_CAPTURE_BUFFER_HPP_
+#define COMMON_CAPTURE_BUFFER_HPP_
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// host sample type of the rx streamer ("cpu format" in UHD terms)
+enum class SampleFormat {
+  kFc32,  // std::complex<float>
+  kSc16,  // std::complex<int16_t>, as it comes off the wire with --otw sc16
+};
+
+// sc16 -> fc32 factor that UHD itself uses, so both formats give the same values
+const float kSc16Scale = 1.0f / 32767.0f;
+
+// accepts the names used by the UHD examples (--type float / short) and the UHD format names
+inline SampleFormat ParseSampleFormat(const std::string &type) {
+  if (type == "float" or type == "fc32") return SampleFormat::kFc32;
+  if (type == "short" or type == "sc16") return SampleFormat::kSc16;
+  throw std::runtime_error("Unknown sample type: " + type);
+}
+
+inline const char *CpuFormat(SampleFormat format) {
+  return format == SampleFormat::kSc16 ? "sc16" : "fc32";
+}
+
+inline size_t SampleSize(SampleFormat format) {
+  return format == SampleFormat::kSc16 ? sizeof(std::complex<int16_t>) : sizeof(std::complex<float>);
+}
+
+// Sent as its own datagram in front of every raw sc16 capture.
+// The int16 I/Q pairs that follow are multiplied by `scale` to get the fc32 values.
+struct Sc16Header {
+  char magic[4];
+  uint32_t num_samps;
+  float scale;
+  uint32_t reserved;
+};
+
+inline Sc16Header MakeSc16Header(size_t num_samps) {
+  return Sc16Header{{'S', 'C', '1', '6'}, static_cast<uint32_t>(num_samps), kSc16Scale, 0};
+}
+
+// Sent as its own datagram in front of the output of every band of a frequency hopping capture.
+// band is the index in the hop list, kStitchedBand for the CTF stitched over all bands, then freq is
+// the frequency of its first bin.
+struct BandHeader {
+  char magic[4];
+  uint32_t band;
+  double freq;
+};
+
+const uint32_t kStitchedBand = 0xffffffff;
+
+inline BandHeader MakeBandHeader(uint32_t band, double freq) {
+  return BandHeader{{'B', 'A', 'N', 'D'}, band, freq};
+}
+
+// Where the samples of one sweep go. The stream is num_delay samples followed by num_slots port slots,
+// slot k is slot_samps(k) samples long (the dwell of the switch pattern). The delay is never received (the
+// stream starts after it) and the first guard samples of every slot (switching transient) are dropped while
+// receiving, so slot k holds kept(k) samples at offset(k) of the capture.
+class CaptureLayout {
+ public:
+  // num_slots slots of the same length
+  CaptureLayout(size_t num_delay, size_t num_slots, size_t slot_samps, size_t guard)
+      : CaptureLayout(num_delay, std::vector<size_t>(num_slots, slot_samps), guard) {}
+
+  CaptureLayout(size_t num_delay, const std::vector<size_t> &slot_samps, size_t guard)
+      : num_delay_(num_delay), guard_(guard) {
+    size_t stream_end = 0;
+    for (size_t samps : slot_samps) {
+      if (samps <= guard) throw std::runtime_error("Port slots must be longer than the guard interval");
+      stream_end += samps;
+      slot_ends_.push_back(stream_end);
+    }
+  }
+
+  size_t num_delay() const { return num_delay_; }
+  size_t num_slots() const { return slot_ends_.size(); }
+  size_t guard() const { return guard_; }
+  size_t slot_samps(size_t slot) const { return slot_begin(slot + 1) - slot_begin(slot); }
+  size_t kept(size_t slot) const { return slot_samps(slot) - guard_; }
+  size_t offset(size_t slot) const { return slot_begin(slot) - slot * guard_; }
+  // stream samples up to the end of slot, delay included
+  size_t stream_end(size_t slot) const { return num_delay_ + slot_ends_[slot]; }
+  size_t stream_samps() const { return num_delay_ + slot_begin(num_slots()); }
+  size_t capture_samps() const { return slot_begin(num_slots()) - num_slots() * guard_; }
+
+  // Maps stream sample stream_pos to its place in the capture, false if it is dropped (delay or guard).
+  // num_segment_samps is how many samples from stream_pos on are contiguous with it on both sides.
+  bool Locate(size_t stream_pos, size_t &capture_pos, size_t &num_segment_samps) const {
+    if (stream_pos < num_delay_) {
+      num_segment_samps = num_delay_ - stream_pos;
+      return false;
+    }
+    if (guard_ == 0) {
+      // slots are contiguous in the capture
+      capture_pos = stream_pos - num_delay_;
+      num_segment_samps = stream_samps() - stream_pos;
+      return true;
+    }
+    const size_t slot = std::upper_bound(slot_ends_.begin(), slot_ends_.end(), stream_pos - num_delay_)
+        - slot_ends_.begin();
+    const size_t pos = stream_pos - num_delay_ - slot_begin(slot);
+    if (pos < guard_) {
+      num_segment_samps = guard_ - pos;
+      return false;
+    }
+    capture_pos = offset(slot) + pos - guard_;
+    num_segment_samps = slot_samps(slot) - pos;
+    return true;
+  }
+
+ private:
+  size_t slot_begin(size_t slot) const { return slot == 0 ? 0 : slot_ends_[slot - 1]; }
+
+  size_t num_delay_;
+  size_t guard_;
+  std::vector<size_t> slot_ends_;  // end of every slot in the stream, counted from the end of the delay
+};
+
+// Sample storage for one capture, allocated once. recv() writes into it at a sample offset.
+// Every channel has its own num_samps samples (planar), the channels follow each other in one allocation,
+// so the whole multi-channel capture can be passed on as one block of bytes(size()) * num_channels().
+class CaptureBuffer {
+ public:
+  CaptureBuffer(SampleFormat format, size_t num_samps, size_t num_channels = 1)
+      : format_(format), sample_size_(SampleSize(format)), num_samps_(num_samps), num_channels_(num_channels),
+        storage_(num_samps * num_channels * sample_size_) {}
+
+  SampleFormat format() const { return format_; }
+  size_t sample_size() const { return sample_size_; }
+  size_t size() const { return num_samps_; }  // per channel
+  size_t num_channels() const { return num_channels_; }
+  size_t bytes(size_t num_samps) const { return num_samps * sample_size_; }
+
+  void *at(size_t offset, size_t chan = 0) { return storage_.data() + (chan * num_samps_ + offset) * sample_size_; }
+  const void *at(size_t offset, size_t chan = 0) const {
+    return storage_.data() + (chan * num_samps_ + offset) * sample_size_;
+  }
+
+  const std::complex<float> *fc32(size_t offset, size_t chan = 0) const {
+    return static_cast<const std::complex<float> *>(at(offset, chan));
+  }
+  const std::complex<int16_t> *sc16(size_t offset, size_t chan = 0) const {
+    return static_cast<const std::complex<int16_t> *>(at(offset, chan));
+  }
+
+ private:
+  SampleFormat format_;
+  size_t sample_size_;
+  size_t num_samps_;
+  size_t num_channels_;
+  std::vector<char> storage_;
+};
+
+#endif // COMMON_CAPTURE_BUFFER_HPP_
@@ -0,0 +1,254 @@
+#include "capture_recorder.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace {
+
+size_t AlignUp(size_t n) {
+  return (n + kRecordAlignment - 1) / kRecordAlignment * kRecordAlignment;
+}
+
+char *AllocateAligned(size_t num_bytes) {
+#if defined(_WIN32)
+  void *p = _aligned_malloc(num_bytes, kRecordAlignment);
+#else
+  void *p = nullptr;
+  if (posix_memalign(&p, kRecordAlignment, num_bytes) != 0) p = nullptr;
+#endif
+  if (!p) throw std::runtime_error("Could not allocate the recorder buffer pool");
+  return static_cast<char *>(p);
+}
+
+void FreeAligned(char *p) {
+#if defined(_WIN32)
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+// header block of a segment, index_offset stays 0 until the index is written
+void FillHeader(char *block, const ArchiveConfig &config, uint64_t config_hash, uint64_t index_offset,
+                uint64_t num_captures) {
+  std::memset(block, 0, kRecordAlignment);
+  ArchiveHeader header{{'C', 'S', 'A', 'R'}, kArchiveVersion, static_cast<uint32_t>(kRecordAlignment), 0,
+                       index_offset, num_captures, config_hash, config};
+  std::memcpy(block, &header, sizeof(header));
+}
+
+}  // namespace
+
+CaptureRecorder::CaptureRecorder(const RecorderOptions &options)
+    : options_(options),
+      buffer_bytes_(AlignUp(sizeof(RecordHeader) + options.max_record_bytes)),
+      free_buffers_(options.num_buffers),
+      full_buffers_(options.num_buffers),
+      record_hash_(HashConfig(options.config)),
+      config_hash_(record_hash_) {
+  if (options_.num_buffers == 0) throw std::runtime_error("The recorder needs at least one buffer");
+  // a segment holds at least one record
+  options_.segment_bytes = std::max(AlignUp(options_.segment_bytes), kRecordAlignment + buffer_bytes_);
+  pool_ = AllocateAligned(buffer_bytes_ * options_.num_buffers);
+  // touch every page now, not on the capture thread
+  std::memset(pool_, 0, buffer_bytes_ * options_.num_buffers);
+  // the first segment is opened here, so that a bad prefix or an unwritable directory reaches the caller
+  try {
+    OpenSegment();
+  } catch (...) {
+    FreeAligned(pool_);
+    throw;
+  }
+  for (size_t i = 0; i < options_.num_buffers; i++) free_buffers_.Push(i);
+  spdlog::info("Recorder: {} buffers of {} bytes, {} byte segments {}_*.dat",
+               options_.num_buffers, buffer_bytes_, options_.segment_bytes, options_.prefix);
+  thread_ = std::thread([this]() { WriterWorker(); });
+}
+
+CaptureRecorder::~CaptureRecorder() {
+  running_ = false;
+  wake_.notify_one();
+  thread_.join();
+  FreeAligned(pool_);
+  spdlog::info("Recorder: {} captures, {} bytes written, {} dropped",
+               num_recorded(), bytes_written(), num_dropped());
+}
+
+bool CaptureRecorder::Record(const void *data, size_t num_bytes, double device_time, uint32_t sample_format,
+                             uint32_t link, double freq) {
+  const uint64_t sequence = sequence_++;
+  size_t index;
+  if (num_bytes > options_.max_record_bytes or !free_buffers_.Pop(index)) {
+    num_dropped_++;
+    return false;
+  }
+  char *record = buffer(index);
+  const size_t record_bytes = AlignUp(sizeof(RecordHeader) + num_bytes);
+  RecordHeader header{{'C', 'R', 'E', 'C'}, sizeof(RecordHeader), num_bytes, record_bytes, sequence,
+                      device_time, sample_format, link, record_hash_, freq};
+  std::memcpy(record, &header, sizeof(header));
+  std::memcpy(record + sizeof(header), data, num_bytes);
+  // zero the padding so stale samples of an earlier capture never reach the file
+  std::memset(record + sizeof(header) + num_bytes, 0, record_bytes - sizeof(header) - num_bytes);
+  // cannot fail, there are as many queue slots as buffers
+  full_buffers_.Push({index, record_bytes});
+  wake_.notify_one();
+  return true;
+}
+
+void CaptureRecorder::SetConfig(const ArchiveConfig &config) {
+  const uint64_t hash = HashConfig(config);
+  if (hash == record_hash_) return;
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  next_configs_.emplace_back(hash, config);
+  record_hash_ = hash;
+}
+
+void CaptureRecorder::WriterWorker() {
+  for (;;) {
+    Pending pending;
+    if (!full_buffers_.Pop(pending)) {
+      if (!running_) break;
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      // the timeout covers a notify that came between Pop() and wait
+      wake_.wait_for(lock, std::chrono::milliseconds(10));
+      continue;
+    }
+    // a failed write or segment costs the record, the writer keeps draining the queue
+    bool written = false;
+    try {
+      written = WriteRecord(buffer(pending.buffer), pending.num_bytes);
+    } catch (std::exception &e) {
+      spdlog::error("Recorder: {}", e.what());
+    }
+    if (written) {
+      num_recorded_++;
+    } else {
+      num_dropped_++;
+    }
+    free_buffers_.Push(pending.buffer);
+  }
+  CloseSegment();
+}
+
+bool CaptureRecorder::WriteRecord(const char *data, size_t num_bytes) {
+  RecordHeader record;
+  std::memcpy(&record, data, sizeof(record));
+  // a segment holds the captures of one config, the header cannot describe more
+  if (record.config_hash != config_hash_) {
+    CloseSegment();
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    while (!next_configs_.empty() and config_hash_ != record.config_hash) {
+      config_hash_ = next_configs_.front().first;
+      options_.config = next_configs_.front().second;
+      next_configs_.pop_front();
+    }
+  }
+  const bool expired = options_.segment_seconds > 0
+      and std::chrono::steady_clock::now() - segment_opened_ > std::chrono::duration<double>(options_.segment_seconds);
+  if ((fd_ >= 0 or file_) and (segment_written_ + num_bytes > options_.segment_bytes or expired)) {
+    CloseSegment();
+  }
+  if (fd_ < 0 and !file_) OpenSegment();
+
+  if (!WriteAt(data, num_bytes, segment_written_)) return false;
+  index_.push_back({segment_written_, record.payload_bytes, record.sequence, record.device_time, record.config_hash,
+                    record.link, record.sample_format});
+  segment_written_ += num_bytes;
+  bytes_written_ += num_bytes;
+  return true;
+}
+
+bool CaptureRecorder::WriteAt(const char *data, size_t num_bytes, uint64_t offset) {
+#if defined(__linux__)
+  size_t done = 0;
+  while (done < num_bytes) {
+    ssize_t n = pwrite(fd_, data + done, num_bytes - done, static_cast<off_t>(offset + done));
+    if (n < 0 and errno == EINTR) continue;
+    if (n <= 0) {
+      spdlog::error("Recorder: write failed: {}", std::strerror(errno));
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+#else
+  if (std::fseek(file_, static_cast<long>(offset), SEEK_SET) != 0
+      or std::fwrite(data, 1, num_bytes, file_) != num_bytes) {
+    spdlog::error("Recorder: write failed");
+    return false;
+  }
+#endif
+  return true;
+}
+
+void CaptureRecorder::OpenSegment() {
+  char name[32];
+  std::snprintf(name, sizeof(name), "_%04zu.dat", segment_number_++);
+  const std::string path = options_.prefix + name;
+  segment_opened_ = std::chrono::steady_clock::now();
+  index_.clear();
+#if defined(__linux__)
+  segment_direct_ = options_.direct_io;
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | (segment_direct_ ? O_DIRECT : 0), 0644);
+  if (fd_ < 0 and segment_direct_ and errno == EINVAL) {
+    // e.g. tmpfs, fall back to the page cache
+    segment_direct_ = false;
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd_ < 0) throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+  // reserve the whole segment up front so the file system does not allocate on every write
+  if (posix_fallocate(fd_, 0, static_cast<off_t>(options_.segment_bytes)) != 0) {
+    spdlog::warn("Recorder: could not preallocate {}", path);
+  }
+#else
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) throw std::runtime_error("Could not open " + path);
+#endif
+  char *block = AllocateAligned(kRecordAlignment);
+  FillHeader(block, options_.config, config_hash_, 0, 0);
+  WriteAt(block, kRecordAlignment, 0);
+  FreeAligned(block);
+  segment_written_ = kRecordAlignment;
+  spdlog::info("Recorder: writing {}{}", path, segment_direct_ ? " (O_DIRECT)" : "");
+}
+
+void CaptureRecorder::CloseSegment() {
+  if (fd_ < 0 and !file_) return;
+  // index at the end, then the header that points at it
+  const uint64_t index_offset = segment_written_;
+  const size_t index_bytes = AlignUp(index_.size() * sizeof(IndexEntry));
+  if (index_bytes > 0) {
+    char *block = AllocateAligned(index_bytes);
+    std::memset(block, 0, index_bytes);
+    std::memcpy(block, index_.data(), index_.size() * sizeof(IndexEntry));
+    if (WriteAt(block, index_bytes, index_offset)) segment_written_ += index_bytes;
+    FreeAligned(block);
+  }
+  char *block = AllocateAligned(kRecordAlignment);
+  FillHeader(block, options_.config, config_hash_, index_bytes > 0 ? index_offset : 0, index_.size());
+  WriteAt(block, kRecordAlignment, 0);
+  FreeAligned(block);
+
+#if defined(__linux__)
+  // drop the preallocated tail
+  if (ftruncate(fd_, static_cast<off_t>(segment_written_)) != 0) {
+    spdlog::warn("Recorder: could not truncate segment {}", segment_number_ - 1);
+  }
+  close(fd_);
+  fd_ = -1;
+#else
+  std::fclose(file_);
+  file_ = nullptr;
+#endif
+}
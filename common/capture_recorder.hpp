@@ -0,0 +1,97 @@
+#ifndef COMMON_CAPTURE_RECORDER_HPP_
+#define COMMON_CAPTURE_RECORDER_HPP_
+
+#include "capture_archive.hpp"
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct RecorderOptions {
+  std::string prefix;           // segments are <prefix>_<n>.dat, see capture_archive.hpp for the format
+  ArchiveConfig config{};       // written to the header of every segment
+  size_t max_record_bytes = 0;  // largest payload passed to Record()
+  size_t num_buffers = 8;       // captures that can wait for the disk
+  size_t segment_bytes = 1ull << 30;
+  double segment_seconds = 0;   // 0: rotate by size only
+  bool direct_io = true;        // O_DIRECT where available
+};
+
+// Appends captures to preallocated archive segment files on a background thread.
+// Record() copies the capture into a free buffer of a preallocated pool and returns, it never waits
+// for the disk. When the pool is exhausted the capture is dropped and counted instead.
+// The constructor opens the first segment and throws when it cannot. Later I/O errors are logged on the
+// writer thread and the records they hit are counted as dropped.
+class CaptureRecorder {
+ public:
+  explicit CaptureRecorder(const RecorderOptions &options);
+  ~CaptureRecorder();
+
+  // called from one thread only (the capture thread), freq: center frequency when it is not the one of the config
+  bool Record(const void *data, size_t num_bytes, double device_time, uint32_t sample_format, uint32_t link = 0,
+              double freq = 0);
+  // The captures recorded from now on go to a new segment with config in its header (capture thread).
+  // The buffers keep their size, larger captures are dropped.
+  void SetConfig(const ArchiveConfig &config);
+
+  size_t max_record_bytes() const { return options_.max_record_bytes; }
+
+  size_t num_recorded() const { return num_recorded_.load(std::memory_order_relaxed); }
+  size_t num_dropped() const { return num_dropped_.load(std::memory_order_relaxed); }
+  uint64_t bytes_written() const { return bytes_written_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Pending {
+    size_t buffer;
+    size_t num_bytes;  // aligned record size
+  };
+
+  void WriterWorker();
+  void OpenSegment();
+  void CloseSegment();
+  bool WriteRecord(const char *data, size_t num_bytes);
+  bool WriteAt(const char *data, size_t num_bytes, uint64_t offset);
+  char *buffer(size_t index) const { return pool_ + index * buffer_bytes_; }
+
+  RecorderOptions options_;
+  size_t buffer_bytes_;
+  char *pool_ = nullptr;
+  SpscQueue<size_t> free_buffers_;   // writer -> capture thread
+  SpscQueue<Pending> full_buffers_;  // capture thread -> writer
+  uint64_t sequence_ = 0;
+  uint64_t record_hash_;  // config of the captures being recorded
+
+  // configs set but not written yet, in order, the writer takes the one a record asks for
+  std::mutex config_mutex_;
+  std::deque<std::pair<uint64_t, ArchiveConfig>> next_configs_;
+
+  std::thread thread_;
+  std::atomic<bool> running_{true};
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+
+  // writer thread only
+  int fd_ = -1;
+  std::FILE *file_ = nullptr;  // where O_DIRECT / pwrite are not available
+  size_t segment_number_ = 0;
+  uint64_t segment_written_ = 0;
+  std::chrono::steady_clock::time_point segment_opened_;
+  bool segment_direct_ = false;
+  std::vector<IndexEntry> index_;  // of the open segment
+  uint64_t config_hash_;  // of the open segment
+
+  std::atomic<size_t> num_recorded_{0};
+  std::atomic<size_t> num_dropped_{0};
+  std::atomic<uint64_t> bytes_written_{0};
+};
+
+#endif // COMMON_CAPTURE_RECORDER_HPP_
@@ -0,0 +1,663 @@
+#include "capture_server.hpp"
+#include "control_channel.hpp"
+#include "ctf_engine.hpp"
+#include "device_setup.hpp"
+#include "frame_sync.hpp"
+#include "metrics.hpp"
+#include "rx_capture.hpp"
+#include "snapshot_averager.hpp"
+#include "spsc_queue.hpp"
+#include "trace.hpp"
+#include "tx_scheduler.hpp"
+#include "worker_pool.hpp"
+
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <complex>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+std::atomic<bool> keep_transmitting{false};
+std::atomic<bool> stop_signal_called{false};
+
+Histogram &capture_seconds = Metrics().AddHistogram("capture_seconds", "from scheduling a capture to its reply");
+Counter &captures_done = Metrics().AddCounter("captures_total", "captures answered as done (3)");
+Counter &captures_failed = Metrics().AddCounter("captures_failed_total", "captures answered as failed (4)");
+Gauge &sync_offset_gauge = Metrics().AddGauge("sync_offset_millisamples",
+                                              "--sync: arrival of the TX waveform after the sweep boundary");
+Gauge &sync_drift_gauge = Metrics().AddGauge("sync_drift_millisamples_per_second",
+                                             "--sync: change of the arrival between the last two captures");
+
+void TransmitWorker(ControlChannel &control, const uhd::tx_streamer::sptr &tx_stream, PlanHandoff &plans,
+                    bool continuous, double stream_time) {
+  TraceThreadName("tx");
+  control.Reply(ReplyStatus::kTxStarted); // 送信開始通知
+  const double timeout = 1.5;
+  // every sweep goes out with the plan scheduled for it
+  std::shared_ptr<SweepPlan> plan = plans.At(stream_time);
+  size_t num_underflows = 0, num_late = 0;
+  auto scheduler_at = [&](double time) -> TxScheduler & {
+    auto next = plans.At(time);
+    if (next != plan) {
+      spdlog::info("TX switches to the new configuration at {}", time);
+      num_underflows += plan->tx_scheduler->num_underflows();
+      num_late += plan->tx_scheduler->num_late();
+      plan = next;
+    }
+    return *plan->tx_scheduler;
+  };
+  if (continuous) {
+    // one timed start, then every sweep (padded to 200 ms) follows the previous one without end of burst
+    spdlog::info("Send Time: {} (continuous)", stream_time);
+    for (size_t sweep = 0; keep_transmitting and !stop_signal_called; sweep++) {
+      TxScheduler &tx_scheduler = scheduler_at(stream_time + 0.2 * static_cast<double>(sweep));
+      tx_scheduler.Send(tx_stream, sweep == 0 ? stream_time : -1, false, timeout);
+      tx_scheduler.PollAsync(tx_stream);
+    }
+    plan->tx_scheduler->EndBurst(tx_stream);
+  } else {
+    spdlog::info("Send Time: {} (one burst every 200 ms)", stream_time);
+    for (size_t sweep = 0; keep_transmitting; sweep++) {
+      const double time = stream_time + 0.2 * static_cast<double>(sweep);
+      TxScheduler &tx_scheduler = scheduler_at(time);
+      // the sweep is exactly one burst, its last frame carries the end of burst
+      tx_scheduler.Send(tx_stream, time, true, timeout);
+      // send() blocks until the device has room, so the ACK of the previous burst is only collected here
+      tx_scheduler.PollAsync(tx_stream);
+      if (stop_signal_called) break;
+    }
+    spdlog::info("Result: {}", (plan->tx_scheduler->PollAsync(tx_stream, true, timeout) ? "success" : "failure"));
+  }
+  spdlog::info("TX underflows: {}, late packets: {}", num_underflows + plan->tx_scheduler->num_underflows(),
+               num_late + plan->tx_scheduler->num_late());
+  control.Reply(ReplyStatus::kTxStopped); // 送信停止通知
+}
+
+// part of the capture buffer that is ready to be sent, num_samps == 0 ends the capture
+struct SampleRange {
+  size_t offset;
+  size_t num_samps;
+};
+
+// What the captures of one plan are written to, allocated once per plan and reused by every capture.
+// recv() writes into rx_buffs directly, the delay and the guard interval of every slot never reach it.
+// Every channel has its own plane, CTF and averager, and the channels are processed in parallel.
+// A frequency hopping plan has all of them once per band, indexed [band][chan].
+struct CaptureBuffers {
+  CaptureBuffers(const SweepPlan &plan, SampleFormat sample_format, size_t num_channels, size_t max_rx_samps,
+                 size_t num_average, bool variance);
+
+  std::vector<CaptureBuffer> rx_buffs;
+  CaptureBuffer rx_scratch;
+  // with --ctf, the CTF of every slot is sent instead of the raw samples
+  std::vector<std::vector<std::vector<std::complex<float>>>> ctf_buffs;
+  // with --average, snapshots are accumulated here (the CTF with --ctf, the raw samples otherwise)
+  std::vector<std::vector<SnapshotAverager>> averagers;
+  // with --stitch, the CTF of every slot over all bands, [chan]
+  std::vector<std::vector<std::complex<float>>> stitched;
+  // with --sync, the sweep searched for the start of the TX waveform
+  CaptureBuffer sync_buff;
+  // with --pipeline, each port slot is handed to the transport thread as soon as it is complete
+  SpscQueue<SampleRange> slot_queue;
+};
+
+CaptureBuffers::CaptureBuffers(const SweepPlan &plan, SampleFormat sample_format, size_t num_channels,
+                               size_t max_rx_samps, size_t num_average, bool variance)
+    : rx_scratch(sample_format, max_rx_samps, num_channels),
+      ctf_buffs(plan.num_bands(), std::vector<std::vector<std::complex<float>>>(num_channels)),
+      sync_buff(sample_format, plan.frame_sync ? plan.frame_sync->window() : 0, num_channels),
+      slot_queue(plan.layout->num_slots() + 1) {
+  const size_t num_slots = plan.layout->num_slots();
+  const bool ctf = !plan.ctf_engines.empty();
+  for (size_t band = 0; band < plan.num_bands(); band++) {
+    rx_buffs.emplace_back(sample_format, plan.layout->capture_samps(), num_channels);
+    if (ctf) {
+      for (auto &ctf_buff : ctf_buffs[band]) ctf_buff.resize(num_slots * plan.ctf_engines[0]->num_bins());
+    }
+    averagers.emplace_back(num_channels, SnapshotAverager(
+        num_average > 1 ? (ctf ? ctf_buffs[band][0].size() : plan.layout->capture_samps()) : 0, variance));
+  }
+  if (plan.stitcher) stitched.assign(num_channels, std::vector<std::complex<float>>(
+      num_slots * plan.stitcher->num_bins()));
+  spdlog::info("Allocated capture buffer: {} bands x {} channels x {} {} samples", plan.num_bands(), num_channels,
+               plan.layout->capture_samps(), CpuFormat(sample_format));
+}
+
+// CTF of the port slot of channel chan whose useful samples start at offset
+void ProcessCtf(CtfEngine &ctf_engine, const CaptureBuffer &buff, size_t offset, size_t chan,
+                std::complex<float> *ctf) {
+  if (buff.format() == SampleFormat::kSc16) {
+    ctf_engine.Process(buff.sc16(offset, chan), ctf);
+  } else {
+    ctf_engine.Process(buff.fc32(offset, chan), ctf);
+  }
+}
+
+// --sync: receives the sweep at stream_time from its boundary on into buff and finds where the TX waveform starts
+// in it (channel 0), -1 when it is not there
+double AcquireSweep(FrameSync &frame_sync, const uhd::rx_streamer::sptr &rx_stream, RxRing *rx_ring,
+                    CaptureBuffer &buff, CaptureBuffer &scratch, double stream_time, double time_now, double rate) {
+  const CaptureLayout layout(0, 1, frame_sync.window(), 0);
+  size_t num_rcvd_samps;
+  if (rx_ring) {
+    const double timeout = stream_time - time_now + static_cast<double>(layout.stream_samps()) / rate + 1.0;
+    num_rcvd_samps = rx_ring->Extract(rx_ring->TimeToTick(stream_time), layout, buff, timeout);
+  } else {
+    num_rcvd_samps = ReceiveSweep(rx_stream, layout, buff, scratch, stream_time, rate);
+  }
+  if (num_rcvd_samps < layout.stream_samps()) return -1;
+  return buff.format() == SampleFormat::kSc16 ? frame_sync.Acquire(buff.sc16(0)) : frame_sync.Acquire(buff.fc32(0));
+}
+
+// Sends the raw slots, or their CTF when there are ctf_engines (one per channel, ctf_buffs holds one CTF
+// per slot and channel). Every channel goes to its own streamer, the channels of a slot in parallel.
+UdpSendStats TransportWorker(const std::vector<std::unique_ptr<UdpStreamer>> &udp_streamers,
+                             SpscQueue<SampleRange> &slot_queue, const CaptureBuffer &buff,
+                             const std::vector<std::unique_ptr<CtfEngine>> &ctf_engines,
+                             std::vector<std::vector<std::complex<float>>> &ctf_buffs, WorkerPool &channel_pool) {
+  TraceThreadName("transport");
+  std::vector<UdpSendStats> channel_stats(buff.num_channels());
+  SampleRange range{};
+  size_t slot = 0;
+  for (;;) {
+    if (!slot_queue.Pop(range)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (range.num_samps == 0) break;
+    channel_pool.ParallelFor(buff.num_channels(), [&](size_t chan) {
+      UdpSendStats stats;
+      if (!ctf_engines.empty()) {
+        CtfEngine &ctf_engine = *ctf_engines[chan];
+        std::complex<float> *ctf = &ctf_buffs[chan][slot * ctf_engine.num_bins()];
+        // the CTF uses the last num_samps samples of the slot, the rest is the switching guard interval
+        ProcessCtf(ctf_engine, buff, range.offset + range.num_samps - ctf_engine.num_samps(), chan, ctf);
+        stats = udp_streamers[chan]->Send(ctf, ctf_engine.num_bins() * sizeof(*ctf));
+      } else {
+        stats = udp_streamers[chan]->Send(buff.at(range.offset, chan), buff.bytes(range.num_samps));
+      }
+      channel_stats[chan] += stats;
+    });
+    slot++;
+  }
+  UdpSendStats total_stats;
+  for (const auto &stats : channel_stats) total_stats += stats;
+  return total_stats;
+}
+
+}  // namespace
+
+ArchiveConfig RecordConfig(const SweepPlan &plan, Radio &usrp, const std::string &args, SampleFormat sample_format,
+                           size_t num_channels) {
+  const SweepConfig &config = plan.config;
+  ArchiveConfig archive{};
+  // the tuning of a reconfiguration is still to come, so it is taken from the settings where they have it.
+  // A new rate is already set, the device runs at it from here on.
+  archive.rate = usrp.get_rx_rate();
+  archive.freq = config.device.freq;
+  archive.rx_gain = config.device.rx.gain ? *config.device.rx.gain : usrp.get_rx_gain();
+  archive.tx_gain = config.device.tx.gain ? *config.device.tx.gain : usrp.get_tx_gain();
+  archive.sample_format = static_cast<uint32_t>(sample_format);
+  SetArchiveLayout(archive, plan.pattern, config.num_samps, config.guard, config.num_delay, num_channels, args);
+  return archive;
+}
+
+void StopTransmitting() {
+  stop_signal_called = true;
+  keep_transmitting = false;
+}
+
+void TuneWorker(Radio &usrp, GpioScheduler &gpio, PlanHandoff &plans, const std::atomic<bool> &running) {
+  TraceThreadName("tune");
+  // as left by the bring-up
+  DeviceSettings tuned = plans.Latest()->config.device;
+  auto boundary = static_cast<long long>(std::ceil(usrp.get_time_now().get_real_secs() * 5)) + 1;
+  while (running) {
+    const double time = static_cast<double>(boundary) / 5;
+    // issued during the sweep two before, the command is at least 100 ms ahead of the device
+    const double wait = time - 0.3 - usrp.get_time_now().get_real_secs();
+    if (wait > 0) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(std::min(wait, 0.05)));
+      continue;
+    }
+    if (wait < -0.1) {
+      // a late command would retune in the middle of a sweep, the tuning waits for the next boundary instead
+      spdlog::warn("Tuning fell behind at {}", time);
+      boundary = static_cast<long long>(std::ceil(usrp.get_time_now().get_real_secs() * 5)) + 2;
+      continue;
+    }
+    const auto previous = plans.At(time - 0.2);
+    const DeviceSettings next = plans.At(time)->TuningAt(time);
+    if (!SameTuning(tuned, next) or next.rate != tuned.rate) {
+      // in turn with the switching: a retune queued behind switch commands of later sweeps would come too late
+      const double command_time = time - 0.2 + previous->sweep_seconds();
+      gpio.Schedule(command_time, RetuneCommands(next), [&usrp, next, command_time]() {
+        Retune(usrp, next, command_time);
+      });
+      tuned = next;
+    }
+    boundary++;
+  }
+}
+
+void SocketWorker(boost::asio::io_context &io_context, boost::asio::ip::tcp::acceptor &acceptor,
+                  const Radio::sptr &usrp,
+                  const uhd::rx_streamer::sptr &rx_stream,
+                  const uhd::tx_streamer::sptr &tx_stream,
+                  PlanHandoff &plans, bool tx_continuous,
+                  const std::vector<std::unique_ptr<UdpStreamer>> &udp_streamers,
+                  const std::string &rx_file, const std::string &device_args, bool pipeline,
+                  size_t num_average, bool variance, SampleFormat sample_format, RxRing *rx_ring,
+                  CaptureRecorder *recorder, GpioScheduler &gpio, const std::string &trace_path) {
+  TraceThreadName("control");
+  boost::asio::ip::tcp::socket socket(io_context);
+  acceptor.accept(socket);
+  spdlog::info("TCP Connected");
+  ControlChannel control(socket);
+  control.Reply(ReplyStatus::kConnected); // 接続完了通知
+
+  std::thread gpio_thread;
+  std::thread tx_thread;
+
+  // the antenna switch timelines of the plans are queued ahead as timed commands
+  usrp->set_gpio_attr("FP0", "CTRL", ATR_CONTROL, ATR_MASKS);
+  usrp->set_gpio_attr("FP0", "DDR", GPIO_DDR, ATR_MASKS);
+  // the rate the device runs at: the delay, the switching and the sync offset are in samples of it
+  double rate = usrp->get_rx_rate();
+  // cleared to end the open ended Run() of the tx GPIO thread, at a stop or when a new plan is scheduled
+  std::atomic<bool> tx_gpio_running{false};
+
+  const size_t num_channels = rx_stream->get_num_channels();
+  std::unique_ptr<CaptureBuffers> buffers(new CaptureBuffers(*plans.Latest(), sample_format, num_channels,
+                                                             rx_stream->get_max_num_samps(), num_average, variance));
+  WorkerPool channel_pool(num_channels);
+
+  // next 200 ms boundary that leaves enough time to schedule the sweep, not before the last configuration
+  double time_now, stream_time;
+  double not_before = 0;
+  std::chrono::steady_clock::time_point scheduled;
+  auto next_stream_time = [&]() {
+    scheduled = std::chrono::steady_clock::now();
+    time_now = usrp->get_time_now().get_real_secs();
+    TraceClockSync(time_now);
+    stream_time = std::ceil(time_now * 5) / 5;
+    // with --continuous the samples are already streaming, so only the GPIO commands need the margin: more than
+    // the issue lead of the scheduler, so that they keep their place before the tx switching
+    if (stream_time < time_now + (rx_ring ? 0.03 : 0.05)) {
+      stream_time += 0.2;
+    }
+    stream_time = std::max(stream_time, not_before);
+  };
+
+  // --sync: where the TX waveform arrives after the sweep boundary, found once per plan and followed from capture
+  // to capture. The captures start sync_offset samples late, sync_residual is the fraction of a sample left over.
+  std::shared_ptr<SweepPlan> sync_plan;
+  long long sync_offset = 0;
+  double sync_residual = 0, sync_time = 0;
+
+  ControlCommand command;
+  while (control.Read(command)) {
+    next_stream_time();
+
+    if (command.id == CommandId::kStartTx) {
+      keep_transmitting = true;
+      tx_gpio_running = true;
+      gpio_thread = std::thread([&, stream_time]() {
+        TraceThreadName("gpio tx");
+        // one Run() per plan, the next plan takes over at the sweep it was scheduled for
+        size_t sweep = 0;
+        while (keep_transmitting) {
+          const double time = stream_time + 0.2 * static_cast<double>(sweep);
+          tx_gpio_running = true;
+          // a stop between the loop condition and here must not start an open ended run
+          if (!keep_transmitting) break;
+          double until;
+          auto plan = plans.At(time, &until);
+          const auto num_sweeps = static_cast<size_t>(until > 0 ? std::llround((until - time) / 0.2) : 0);
+          const double delay = static_cast<double>(plan->config.num_delay) / plan->config.device.rate;
+          sweep += gpio.Run(plan->tx_timeline, time + delay, num_sweeps, 0.2, tx_gpio_running);
+        }
+      });
+      tx_thread = std::thread([&, stream_time]() {
+        TransmitWorker(control, tx_stream, plans, tx_continuous, stream_time);
+      });
+    } else if (command.id == CommandId::kStopTx) {
+      keep_transmitting = false;
+      tx_gpio_running = false;
+      spdlog::info("Stop Transmitting");
+      if (gpio_thread.joinable()) gpio_thread.join();
+      if (tx_thread.joinable()) tx_thread.join();
+    } else if (command.id == CommandId::kStats) {
+      control.ReplyStats(Metrics().Render());
+    } else if (command.id == CommandId::kTrace) {
+      const bool written = !trace_path.empty() and WriteChromeTrace(trace_path);
+      if (written) spdlog::info("Trace written to {}", trace_path);
+      control.Reply(written ? ReplyStatus::kTraceWritten : ReplyStatus::kBadRequest);
+    } else if (command.id == CommandId::kConfigure) {
+      // The new plan and its buffers are built here while the tx thread keeps sending the current one. It takes
+      // over at a sweep boundary, the tune thread retunes at the end of the last sweep before it.
+      const auto current = plans.Latest();
+      try {
+        double at;
+        SweepConfig config = Reconfigure(current->config, command.settings, at);
+        const bool new_rate = config.device.rate != current->config.device.rate;
+        if (new_rate and (tx_thread.joinable() or rx_ring)) {
+          throw std::runtime_error("The rate can only be changed while not transmitting, and not with --continuous");
+        }
+        if (new_rate) {
+          // nothing is streaming, so the rate is changed right away and the plan is built on the one the device took
+          usrp->set_rx_rate(config.device.rate);
+          usrp->set_tx_rate(config.device.rate);
+          config.device.rate = usrp->get_rx_rate();
+        }
+        auto plan = BuildSweepPlan(config, num_channels, tx_stream->get_max_num_samps(), MAN_GPIO_MASK);
+        if (rx_ring and plan->layout->stream_samps() * 4 > rx_ring->capacity()) {
+          throw std::runtime_error("The sweep does not fit the --continuous ring buffer");
+        }
+        ArchiveConfig archive_config{};
+        if (recorder) {
+          archive_config = RecordConfig(*plan, *usrp, device_args, sample_format, num_channels);
+          if (plan->layout->capture_samps() * SampleSize(sample_format) * num_channels
+              > recorder->max_record_bytes()) {
+            throw std::runtime_error("The capture does not fit the --record buffers");
+          }
+        }
+        std::unique_ptr<CaptureBuffers> next_buffers(new CaptureBuffers(
+            *plan, sample_format, num_channels, rx_stream->get_max_num_samps(), num_average, variance));
+        if (new_rate) {
+          rate = config.device.rate;
+          spdlog::info("Actual Rate: {} Msps", rate / 1e6);
+          gpio.set_rate(rate);
+        }
+
+        time_now = usrp->get_time_now().get_real_secs();
+        const double time = plans.Schedule(plan, std::max(at, time_now + 0.25), time_now);
+        // the open ended GPIO run stops and the next one ends where the new plan begins
+        tx_gpio_running = false;
+        buffers = std::move(next_buffers);
+        not_before = time;
+        if (recorder) recorder->SetConfig(archive_config);
+        spdlog::info("Configured: {} MHz, {} slots of {} samples per sweep from {}", config.device.freq / 1e6,
+                     plan->pattern.size(), plan->pattern.sweep_samps(), time);
+        control.ReplyConfigured(time);
+      } catch (std::exception &e) {
+        // the device goes back to the rate of the current plan
+        if (usrp->get_rx_rate() != rate) {
+          usrp->set_rx_rate(rate);
+          usrp->set_tx_rate(rate);
+        }
+        spdlog::warn("Configuration rejected: {}", e.what());
+        control.ReplyError(e.what());
+      }
+    } else if (command.id == CommandId::kCapture) {
+      //Rx
+      // the plan of the captures is the latest one, every capture after a configuration is at or after its time
+      const auto plan = plans.At(stream_time);
+      const CaptureLayout &layout = *plan->layout;
+      const size_t num_slots = layout.num_slots();
+      const size_t total_num_samps = layout.stream_samps();
+      const double num_delay_time = static_cast<double>(plan->config.num_delay) / rate;
+      const auto &ctf_engines = plan->ctf_engines;
+      const bool ctf = !ctf_engines.empty();
+      // a hopping capture is num_average sweeps of every band, the bands one after the other
+      const bool hopping = !plan->config.hop_freqs.empty();
+      const size_t num_bands = plan->num_bands();
+      const size_t num_sweeps = num_average * num_bands;
+      auto &ctf_buffs = buffers->ctf_buffs;
+      auto &averagers = buffers->averagers;
+      auto &slot_queue = buffers->slot_queue;
+
+      const bool send_udp = (command.flags & kCaptureSendUdp) != 0;
+      // with --average, only the mean of the snapshots is sent, with --stitch only the CTF over all bands,
+      // so there is nothing to stream per slot
+      const bool stream_slots = send_udp and pipeline and num_average == 1 and !plan->stitcher;
+      const bool send_raw = num_average == 1 and !ctf;
+      if (!command.label.empty()) {
+        spdlog::info("Capture batch: {} x link {} ({})", command.count, command.link, command.label);
+      }
+      // a batch runs its captures back to back, each one is answered as soon as it is done
+      for (uint32_t capture = 0; capture < command.count; capture++) {
+        if (capture > 0) next_stream_time();
+        TraceScope trace_capture("capture", stream_time, capture);
+        if (plan->frame_sync and sync_plan != plan) {
+          // one sweep to find the TX waveform, the capture takes the next one. It is switched from the boundary
+          // on, without the delay, so that a waveform arriving within the delay is heard from its start.
+          std::atomic<bool> sync_gpio_running{true};
+          std::thread sync_gpio_thread([&]() {
+            TraceThreadName("gpio rx");
+            gpio.Run(plan->rx_timeline, stream_time, 1, 0.2, sync_gpio_running);
+          });
+          const double found = AcquireSweep(*plan->frame_sync, rx_stream, rx_ring, buffers->sync_buff,
+                                            buffers->rx_scratch, stream_time, time_now, rate);
+          sync_gpio_running = false;
+          sync_gpio_thread.join();
+          stream_time += 0.2;
+          if (found < 0) {
+            spdlog::warn("Frame sync: no TX waveform in the sweep at {}", stream_time - 0.2);
+            control.ReplyCapture(false, capture, command.count); // 受信失敗通知
+            captures_failed.Add();
+            continue;
+          }
+          sync_plan = plan;
+          sync_offset = std::llround(found);
+          sync_residual = found - static_cast<double>(sync_offset);
+          sync_time = stream_time - 0.2;
+          sync_offset_gauge.Set(std::llround(found * 1e3));
+          spdlog::info("Frame sync: TX waveform {:.2f} samples after the sweep boundary", found);
+        }
+        // the sweep has one port of tail after its last slot, the captures can start at most that late
+        if (plan->frame_sync and (sync_offset < 0 or sync_offset > static_cast<long long>(plan->config.num_samps))) {
+          spdlog::warn("Frame sync: offset {} samples is outside the tail of 0 to {} samples, acquiring again",
+                       sync_offset, plan->config.num_samps);
+          sync_plan.reset();
+          control.ReplyCapture(false, capture, command.count); // 受信失敗通知
+          captures_failed.Add();
+          continue;
+        }
+        // the captures and the rx switching start where the TX waveform arrives
+        const auto sync_samps = static_cast<size_t>(plan->frame_sync ? sync_offset : 0);
+        const double sync_time_offset = static_cast<double>(sync_samps) / rate;
+        UdpSendStats send_stats;
+        for (auto &band_averagers : averagers) {
+          for (auto &averager : band_averagers) averager.Reset();
+        }
+
+        // the switch commands of the snapshots are queued ahead, merged with the tx switching
+        std::atomic<bool> rx_gpio_running{true};
+        std::thread rx_gpio_thread([&]() {
+          TraceThreadName("gpio rx");
+          gpio.Run(plan->rx_timeline, stream_time + num_delay_time + sync_time_offset, num_sweeps, 0.2,
+                   rx_gpio_running);
+        });
+
+        size_t num_acc_samps = 0;
+        for (size_t sweep = 0; sweep < num_sweeps; sweep++) {
+          const double snapshot_time = stream_time + 0.2 * static_cast<double>(sweep);
+          const size_t band = plan->BandAt(snapshot_time);
+          CaptureBuffer &rx_buffs = buffers->rx_buffs[band];
+
+          std::thread transport_thread;
+          size_t num_queued_slots = 0;
+          if (stream_slots) {
+            if (hopping) {
+              auto header = MakeBandHeader(static_cast<uint32_t>(band), plan->BandFreq(band));
+              for (const auto &udp_streamer : udp_streamers) udp_streamer->Send(&header, sizeof(header));
+            }
+            if (send_raw and sample_format == SampleFormat::kSc16) {
+              auto header = MakeSc16Header(layout.capture_samps());
+              for (const auto &udp_streamer : udp_streamers) udp_streamer->Send(&header, sizeof(header));
+            }
+            slot_queue.Clear();
+            transport_thread = std::thread([&]() {
+              send_stats += TransportWorker(udp_streamers, slot_queue, rx_buffs, ctf_engines, ctf_buffs[band],
+                                            channel_pool);
+            });
+          }
+
+          auto on_recv = [&](size_t num_rcvd_samps) {
+            while (stream_slots and num_queued_slots < num_slots
+                and num_rcvd_samps >= layout.stream_end(num_queued_slots)) {
+              slot_queue.Push({layout.offset(num_queued_slots), layout.kept(num_queued_slots)});
+              num_queued_slots++;
+            }
+          };
+          if (rx_ring) {
+            // cut the sweep out of the continuous stream by its start time
+            const double timeout = snapshot_time - time_now + static_cast<double>(total_num_samps) / rate + 1.0;
+            num_acc_samps = rx_ring->Extract(rx_ring->TimeToTick(snapshot_time) + sync_samps, layout, rx_buffs,
+                                             timeout, on_recv);
+          } else {
+            num_acc_samps = ReceiveSweep(rx_stream, layout, rx_buffs, buffers->rx_scratch,
+                                         snapshot_time + sync_time_offset, rate, on_recv);
+          }
+
+          if (stream_slots) {
+            slot_queue.Push({0, 0});
+            transport_thread.join();
+          }
+          if (num_acc_samps < total_num_samps) break;
+          // every snapshot is persisted, the copy is queued and written on the recorder thread
+          if (recorder) {
+            recorder->Record(rx_buffs.at(0), rx_buffs.bytes(layout.capture_samps()) * num_channels,
+                             snapshot_time + sync_time_offset, static_cast<uint32_t>(sample_format), command.link,
+                             hopping ? plan->BandFreq(band) : 0);
+          }
+
+          channel_pool.ParallelFor(num_channels, [&](size_t chan) {
+            auto &ctf_buff = ctf_buffs[band][chan];
+            if (ctf and !stream_slots) {
+              CtfEngine &ctf_engine = *ctf_engines[chan];
+              for (size_t slot = 0; slot < num_slots; slot++) {
+                ProcessCtf(ctf_engine, rx_buffs, layout.offset(slot) + layout.kept(slot) - ctf_engine.num_samps(),
+                           chan, &ctf_buff[slot * ctf_engine.num_bins()]);
+              }
+            }
+            SnapshotAverager &averager = averagers[band][chan];
+            if (num_average > 1 and ctf) {
+              averager.Add(ctf_buff.data());
+            } else if (num_average > 1 and sample_format == SampleFormat::kSc16) {
+              averager.Add(rx_buffs.sc16(0, chan));
+            } else if (num_average > 1) {
+              averager.Add(rx_buffs.fc32(0, chan));
+            }
+          });
+        }
+        // stops the remaining snapshots early when one failed
+        rx_gpio_running = false;
+        rx_gpio_thread.join();
+
+        if (num_acc_samps < total_num_samps) {
+          spdlog::warn("Did not receive all samples: {} out of {}", num_acc_samps, total_num_samps);
+          // with --pipeline the slots that were complete are already sent, the client drops them on this reply
+          control.ReplyCapture(false, capture, command.count); // 受信失敗通知
+          captures_failed.Add();
+        } else {
+          num_acc_samps = layout.capture_samps();
+          auto rcvd_time = usrp->get_time_now().get_real_secs();
+          spdlog::info("Recieved {} x {} samples at {}", num_sweeps, num_acc_samps, rcvd_time);
+          FrameSync *frame_sync = plan->frame_sync.get();
+          if (frame_sync and layout.kept(0) >= frame_sync->period()) {
+            // the last period of the first slot of the last sweep against the waveform: how far the arrival
+            // has moved since the lock, the captures follow it by whole samples
+            const double last_time = stream_time + 0.2 * static_cast<double>(num_sweeps - 1);
+            const CaptureBuffer &last_buffs = buffers->rx_buffs[plan->BandAt(last_time)];
+            const size_t period = frame_sync->period();
+            const size_t pos = layout.offset(0) + layout.kept(0) - period;
+            double residual = (sample_format == SampleFormat::kSc16 ? frame_sync->Track(last_buffs.sc16(pos))
+                                                                     : frame_sync->Track(last_buffs.fc32(pos)))
+                + static_cast<double>((layout.stream_end(0) - period) % period);
+            residual -= std::floor(residual / static_cast<double>(period) + 0.5) * static_cast<double>(period);
+            const double drift = (residual - sync_residual) / (last_time - sync_time);
+            spdlog::info("Frame sync: offset {:.2f} samples, drift {:.4f} samples/s",
+                         static_cast<double>(sync_offset) + residual, drift);
+            sync_offset_gauge.Set(std::llround((static_cast<double>(sync_offset) + residual) * 1e3));
+            sync_drift_gauge.Set(std::llround(drift * 1e3));
+            if (std::abs(residual) >= 0.5) {
+              sync_offset += std::llround(residual);
+              residual -= static_cast<double>(std::llround(residual));
+            }
+            sync_residual = residual;
+            sync_time = last_time;
+          }
+          if (send_udp and !stream_slots) {
+            std::vector<UdpSendStats> channel_stats(num_channels);
+            channel_pool.ParallelFor(num_channels, [&](size_t chan) {
+              UdpStreamer &udp_streamer = *udp_streamers[chan];
+              if (num_average > 1) {
+                for (auto &band_averagers : averagers) band_averagers[chan].Finish();
+              }
+              if (plan->stitcher) {
+                // the CTF (its mean with --average) of every slot joined over the bands, in one go
+                const CtfStitcher &stitcher = *plan->stitcher;
+                const size_t num_bins = ctf_engines[chan]->num_bins();
+                auto &stitched = buffers->stitched[chan];
+                std::vector<const std::complex<float> *> band_ctfs(num_bands);
+                for (size_t slot = 0; slot < num_slots; slot++) {
+                  for (size_t band = 0; band < num_bands; band++) {
+                    band_ctfs[band] = (num_average > 1 ? averagers[band][chan].mean() : ctf_buffs[band][chan]).data()
+                        + slot * num_bins;
+                  }
+                  stitcher.Stitch(band_ctfs, &stitched[slot * stitcher.num_bins()]);
+                }
+                auto header = MakeBandHeader(kStitchedBand, stitcher.first_freq());
+                udp_streamer.Send(&header, sizeof(header));
+                channel_stats[chan] = udp_streamer.Send(stitched.data(), stitched.size() * sizeof(stitched.front()));
+                return;
+              }
+              // every band in the order of the hop list, each one after its header
+              for (size_t band = 0; band < num_bands; band++) {
+                if (hopping) {
+                  auto header = MakeBandHeader(static_cast<uint32_t>(band), plan->BandFreq(band));
+                  udp_streamer.Send(&header, sizeof(header));
+                }
+                if (num_average > 1) {
+                  // mean first, then the variance of every element
+                  const SnapshotAverager &averager = averagers[band][chan];
+                  channel_stats[chan] += udp_streamer.Send(averager.mean().data(),
+                                                           averager.size() * sizeof(averager.mean().front()));
+                  if (averager.with_variance()) {
+                    channel_stats[chan] += udp_streamer.Send(averager.variance().data(),
+                                                             averager.size() * sizeof(averager.variance().front()));
+                  }
+                } else if (ctf) {
+                  const auto &ctf_buff = ctf_buffs[band][chan];
+                  channel_stats[chan] += udp_streamer.Send(ctf_buff.data(), ctf_buff.size() * sizeof(ctf_buff.front()));
+                } else {
+                  if (sample_format == SampleFormat::kSc16) {
+                    auto header = MakeSc16Header(num_acc_samps);
+                    udp_streamer.Send(&header, sizeof(header));
+                  }
+                  const CaptureBuffer &rx_buffs = buffers->rx_buffs[band];
+                  channel_stats[chan] += udp_streamer.Send(rx_buffs.at(0, chan), rx_buffs.bytes(num_acc_samps));
+                }
+              }
+            });
+            for (const auto &stats : channel_stats) send_stats += stats;
+          }
+          spdlog::info("Sent {} bytes in {} datagrams: {:.1f} MB/s",
+                       send_stats.num_bytes, send_stats.num_datagrams, send_stats.MegabytesPerSecond());
+          if (!rx_file.empty()) {
+            std::ofstream outfile(rx_file, std::ofstream::binary);
+            for (const auto &rx_buffs : buffers->rx_buffs) {
+              for (size_t chan = 0; chan < num_channels; chan++) {
+                outfile.write((const char *) rx_buffs.at(0, chan), std::streamsize(rx_buffs.bytes(num_acc_samps)));
+              }
+            }
+            outfile.close();
+          }
+          control.ReplyCapture(true, capture, command.count); // 受信完了通知
+          captures_done.Add();
+        }
+        capture_seconds.Observe(std::chrono::steady_clock::now() - scheduled);
+      }
+    }
+  }
+  spdlog::info("TCP Disconnected");
+  keep_transmitting = false;
+  tx_gpio_running = false;
+  if (gpio_thread.joinable()) gpio_thread.join();
+  if (tx_thread.joinable()) tx_thread.join();
+  io_context.stop();
+}
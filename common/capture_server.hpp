@@ -0,0 +1,100 @@
+#ifndef COMMON_CAPTURE_SERVER_HPP_
+#define COMMON_CAPTURE_SERVER_HPP_
+
+#include "capture_buffer.hpp"
+#include "capture_recorder.hpp"
+#include "gpio_schedule.hpp"
+#include "radio.hpp"
+#include "rx_ring.hpp"
+#include "sweep_plan.hpp"
+#include "udp_streamer.hpp"
+
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The control side of txrx_core: the client connection and the threads it starts (tx, switching, tuning),
+// the captures with everything done to them on the way to the client (pipeline, CTF, averaging, recording).
+// Kept out of the core so that the bench measures the same path.
+
+// GPIO pin config
+#define AMP_GPIO_MASK 0x00
+#define MAN_GPIO_MASK 0xFF
+#define ATR_MASKS (AMP_GPIO_MASK | MAN_GPIO_MASK)
+#define ATR_CONTROL (AMP_GPIO_MASK)
+#define GPIO_DDR (AMP_GPIO_MASK | MAN_GPIO_MASK)
+
+// The sweep plans by the device time of the first sweep they are used for. The control thread schedules a new
+// plan at a sweep boundary that no thread has asked for yet, so every sweep is sent, switched and captured
+// with one plan, and the tx thread goes from one plan to the next without a pause.
+class PlanHandoff {
+ public:
+  explicit PlanHandoff(std::shared_ptr<SweepPlan> plan) {
+    plans_[-std::numeric_limits<double>::infinity()] = std::move(plan);
+  }
+
+  // plan of the sweep at time (on the 200 ms grid), until is set to the start of the next one (0: none yet)
+  std::shared_ptr<SweepPlan> At(double time, double *until = nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reached_ = std::max(reached_, time);
+    auto next = plans_.upper_bound(time + 1e-6);
+    if (until) *until = next == plans_.end() ? 0 : next->first;
+    return std::prev(next)->second;
+  }
+
+  std::shared_ptr<SweepPlan> Latest() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return plans_.rbegin()->second;
+  }
+
+  // Schedules plan from the first sweep boundary at or after earliest that comes after every sweep asked for
+  // and every plan scheduled so far, returns its time. Plans whose last sweep is over by now are dropped.
+  double Schedule(std::shared_ptr<SweepPlan> plan, double earliest, double now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double boundary = std::max({std::ceil(earliest * 5 - 1e-6), std::round(reached_ * 5) + 1,
+                                      std::round(plans_.rbegin()->first * 5) + 1});
+    const double time = boundary / 5;
+    plans_[time] = std::move(plan);
+    while (plans_.size() > 1 and std::next(plans_.begin())->first <= now - 0.4) plans_.erase(plans_.begin());
+    return time;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<double, std::shared_ptr<SweepPlan>> plans_;
+  double reached_ = -std::numeric_limits<double>::infinity();
+};
+
+// everything needed to interpret the samples later, for the --record segment header
+ArchiveConfig RecordConfig(const SweepPlan &plan, Radio &usrp, const std::string &args, SampleFormat sample_format,
+                           size_t num_channels);
+
+// Ctrl + C: the tx thread stops after its current sweep and does not start again
+void StopTransmitting();
+
+// Issues the tuning of every sweep, the one of its plan and of its band when hopping, as a timed command at the
+// end of the sweep before it. The LOs settle in the rest of the sweep period, so no settling sample is ever
+// sent or captured. Runs a little over one sweep ahead, nothing is issued while the tuning stays the same.
+void TuneWorker(Radio &usrp, GpioScheduler &gpio, PlanHandoff &plans, const std::atomic<bool> &running);
+
+// Serves one client accepted on acceptor until it disconnects, then stops io_context. The tx and the rx
+// switching go through gpio, the captures use the plan scheduled for their sweep in plans, the samples go to
+// one udp_streamer per channel. rx_ring (--continuous) and recorder (--record) may be null.
+void SocketWorker(boost::asio::io_context &io_context, boost::asio::ip::tcp::acceptor &acceptor,
+                  const Radio::sptr &usrp,
+                  const uhd::rx_streamer::sptr &rx_stream,
+                  const uhd::tx_streamer::sptr &tx_stream,
+                  PlanHandoff &plans, bool tx_continuous,
+                  const std::vector<std::unique_ptr<UdpStreamer>> &udp_streamers,
+                  const std::string &rx_file, const std::string &device_args, bool pipeline,
+                  size_t num_average, bool variance, SampleFormat sample_format, RxRing *rx_ring,
+                  CaptureRecorder *recorder, GpioScheduler &gpio, const std::string &trace_path);
+
+#endif // COMMON_CAPTURE_SERVER_HPP_
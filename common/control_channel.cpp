@@ -0,0 +1,202 @@
+#include "control_channel.hpp"
+
+#include <spdlog/spdlog.h>
+#include <boost/algorithm/string.hpp>
+#include <cstring>
+#include <vector>
+
+bool ControlChannel::Read(ControlCommand &command) {
+  for (;;) {
+    char first;
+    boost::system::error_code error;
+    boost::asio::read(socket_, boost::asio::buffer(&first, 1), error);
+    if (error == boost::asio::error::eof or error == boost::asio::error::connection_reset) {
+      return false;
+    } else if (error) {
+      spdlog::warn("Control connection lost: {}", error.message());
+      Close();
+      return false;
+    }
+
+    command = ControlCommand();
+    ReplyStatus status = ReplyStatus::kBadRequest;
+    bool ok;
+    if (first == kControlMagic[0]) {
+      binary_ = true;
+      ok = ReadFrame(command, status);
+      // a frame that was cut off or whose header is broken closes the connection
+      if (!socket_.is_open()) return false;
+    } else {
+      // old text command, the rest of it is whatever already arrived
+      std::string message(1, first);
+      std::vector<char> rest(socket_.available());
+      if (!rest.empty()) {
+        boost::asio::read(socket_, boost::asio::buffer(rest), error);
+        if (error) {
+          spdlog::warn("Control connection lost: {}", error.message());
+          Close();
+          return false;
+        }
+        message.append(rest.begin(), rest.end());
+      }
+      spdlog::info("TCP Received: {}", message);
+      ok = ParseText(message, command, status);
+    }
+    if (ok) return true;
+    spdlog::warn("Rejected control command, status {}", static_cast<int>(status));
+    Reply(status);
+  }
+}
+
+bool ControlChannel::ReadFrame(ControlCommand &command, ReplyStatus &error) {
+  ControlHeader header;
+  header.magic[0] = kControlMagic[0];
+  boost::system::error_code read_error;
+  boost::asio::read(socket_, boost::asio::buffer(reinterpret_cast<char *>(&header) + 1, sizeof(header) - 1),
+                    read_error);
+  if (read_error) {
+    spdlog::warn("Control connection lost in a frame header: {}", read_error.message());
+    Close();
+    return false;
+  }
+  if (header.magic[1] != kControlMagic[1] or header.version != kControlVersion
+      or header.length > kMaxControlPayload) {
+    // the stream cannot be resynchronized after a broken header
+    spdlog::warn("Invalid control frame header, closing the connection");
+    error = ReplyStatus::kBadRequest;
+    Reply(error);
+    Close();
+    return false;
+  }
+  std::vector<char> payload(header.length);
+  if (!payload.empty()) boost::asio::read(socket_, boost::asio::buffer(payload), read_error);
+  if (read_error) {
+    spdlog::warn("Control connection lost in a frame of {} bytes: {}", header.length, read_error.message());
+    Close();
+    return false;
+  }
+  spdlog::info("TCP Received: command {} ({} bytes)", static_cast<int>(header.code), header.length);
+
+  command.id = static_cast<CommandId>(header.code);
+  switch (command.id) {
+    case CommandId::kStartTx:
+    case CommandId::kStopTx:
+    case CommandId::kStats:
+    case CommandId::kTrace:
+      return true;
+    case CommandId::kConfigure:
+      command.settings.assign(payload.begin(), payload.end());
+      return true;
+    case CommandId::kCapture: {
+      if (payload.size() < sizeof(CapturePayload)) {
+        error = ReplyStatus::kBadRequest;
+        return false;
+      }
+      CapturePayload capture;
+      std::memcpy(&capture, payload.data(), sizeof(capture));
+      if (capture.count == 0) {
+        error = ReplyStatus::kBadRequest;
+        return false;
+      }
+      command.count = capture.count;
+      command.link = capture.link;
+      command.flags = capture.flags;
+      command.label.assign(payload.begin() + sizeof(capture), payload.end());
+      return true;
+    }
+  }
+  error = ReplyStatus::kUnknownCommand;
+  return false;
+}
+
+bool ControlChannel::ParseText(const std::string &message, ControlCommand &command, ReplyStatus &error) {
+  // "3$txNode$label$sendUdp" from multilinkMaster, the plain digit otherwise
+  std::vector<std::string> fields;
+  boost::split(fields, message, boost::is_any_of("$"));
+  boost::trim(fields[0]);
+  if (fields[0] == "1") {
+    command.id = CommandId::kStartTx;
+  } else if (fields[0] == "2") {
+    command.id = CommandId::kStopTx;
+  } else if (fields[0] == "stats") {
+    command.id = CommandId::kStats;
+  } else if (fields[0] == "trace") {
+    command.id = CommandId::kTrace;
+  } else if (fields[0] == "config") {
+    command.id = CommandId::kConfigure;
+    // the settings stay '$' separated, the pattern may contain spaces
+    const size_t settings = message.find('$');
+    if (settings != std::string::npos) command.settings = message.substr(settings + 1);
+  } else if (fields[0] == "3") {
+    command.id = CommandId::kCapture;
+    if (fields.size() == 4) {
+      try {
+        command.link = static_cast<uint32_t>(std::stoul(fields[1]));
+      } catch (std::exception &) {
+        error = ReplyStatus::kBadRequest;
+        return false;
+      }
+      command.label = fields[2];
+      boost::trim(fields[3]);
+      command.flags = (fields[3] == "true" or fields[3] == "1") ? static_cast<uint32_t>(kCaptureSendUdp) : 0u;
+    } else if (fields.size() != 1) {
+      error = ReplyStatus::kBadRequest;
+      return false;
+    }
+  } else {
+    error = ReplyStatus::kUnknownCommand;
+    return false;
+  }
+  return true;
+}
+
+template <typename Buffers>
+void ControlChannel::Write(const Buffers &buffers) {
+  // a peer that is gone is noticed by the next Read()
+  boost::system::error_code error;
+  boost::asio::write(socket_, buffers, error);
+  if (error) spdlog::warn("Control reply not sent: {}", error.message());
+}
+
+void ControlChannel::Close() {
+  boost::system::error_code ignored;
+  socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+  socket_.close(ignored);
+}
+
+void ControlChannel::Reply(ReplyStatus status, const void *payload, size_t length) {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  if (!binary_) {
+    const char code = static_cast<char>('0' + static_cast<int>(status));
+    Write(boost::asio::buffer(&code, 1));
+    return;
+  }
+  ControlHeader header{{kControlMagic[0], kControlMagic[1]}, kControlVersion, static_cast<uint8_t>(status),
+                       static_cast<uint32_t>(length)};
+  std::vector<boost::asio::const_buffer> buffers{boost::asio::buffer(&header, sizeof(header))};
+  if (length > 0) buffers.push_back(boost::asio::buffer(payload, length));
+  Write(buffers);
+}
+
+void ControlChannel::ReplyStats(const std::string &text) {
+  if (binary_) {
+    Reply(ReplyStatus::kStats, text.data(), text.size());
+    return;
+  }
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  Write(boost::asio::buffer(text));
+}
+
+void ControlChannel::ReplyCapture(bool success, uint32_t index, uint32_t count) {
+  CaptureReplyPayload payload{index, count};
+  Reply(success ? ReplyStatus::kCaptureDone : ReplyStatus::kCaptureFailed, &payload, sizeof(payload));
+}
+
+void ControlChannel::ReplyConfigured(double time) {
+  ConfigureReplyPayload payload{time};
+  Reply(ReplyStatus::kConfigured, &payload, sizeof(payload));
+}
+
+void ControlChannel::ReplyError(const std::string &reason) {
+  Reply(ReplyStatus::kBadRequest, reason.data(), reason.size());
+}
@@ -0,0 +1,124 @@
+#ifndef COMMON_CONTROL_CHANNEL_HPP_
+#define COMMON_CONTROL_CHANNEL_HPP_
+
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// TCP control protocol.
+//
+// Binary frame, little endian, used in both directions:
+//   char     magic[2]  "CS"
+//   uint8_t  version   kControlVersion
+//   uint8_t  code      CommandId in requests, ReplyStatus in replies
+//   uint32_t length    payload bytes that follow
+//
+// The single character commands of the old text protocol ("1", "2", "3", "3$tx$label$flag") are still
+// accepted, and are answered with the single character status ('0' + ReplyStatus).
+// "stats" in text form is answered with the metrics text as it is, "trace" like the binary kTrace.
+// "config$key=value$key=value..." is kConfigure.
+constexpr char kControlMagic[2] = {'C', 'S'};
+constexpr uint8_t kControlVersion = 1;
+constexpr uint32_t kMaxControlPayload = 64 * 1024;
+
+enum class CommandId : uint8_t {
+  kStartTx = 1,
+  kStopTx = 2,
+  kCapture = 3,
+  kStats = 4,  // no payload, answered with kStats
+  kTrace = 5,  // no payload, writes the --trace file, answered with kTraceWritten (kBadRequest without --trace)
+  // payload: "key=value" settings, one per line (sweep_plan.hpp), answered with kConfigured once they are
+  // scheduled, or kBadRequest with the reason as payload
+  kConfigure = 6,
+};
+
+enum class ReplyStatus : uint8_t {
+  kConnected = 0,
+  kTxStarted = 1,
+  kTxStopped = 2,
+  kCaptureDone = 3,
+  // the datagrams received since the previous reply belong to the failed capture and are to be dropped:
+  // with --pipeline the slots that were complete before the failure have already been sent
+  kCaptureFailed = 4,
+  kUnknownCommand = 5,
+  kBadRequest = 6,
+  kStats = 7,  // payload: metrics in the Prometheus text format
+  kTraceWritten = 8,
+  kConfigured = 9,  // payload: ConfigureReplyPayload
+};
+
+#pragma pack(push, 1)
+struct ControlHeader {
+  char magic[2];
+  uint8_t version;
+  uint8_t code;
+  uint32_t length;
+};
+
+// payload of kCapture, followed by the label (length - sizeof(CapturePayload) bytes, no terminator)
+struct CapturePayload {
+  uint32_t count;  // number of captures run back to back, one reply each
+  uint32_t link;   // tx node / link number the capture belongs to
+  uint32_t flags;  // CaptureFlags
+};
+
+// payload of kCaptureDone / kCaptureFailed
+struct CaptureReplyPayload {
+  uint32_t index;  // 0 based index of the capture in the batch
+  uint32_t count;
+};
+
+// payload of kConfigured
+struct ConfigureReplyPayload {
+  double time;  // device time of the first sweep with the new settings, every later capture is at or after it
+};
+#pragma pack(pop)
+
+enum CaptureFlags : uint32_t {
+  kCaptureSendUdp = 1u << 0,  // send the samples / CTF over UDP
+};
+
+struct ControlCommand {
+  CommandId id = CommandId::kCapture;
+  uint32_t count = 1;
+  uint32_t link = 0;
+  uint32_t flags = kCaptureSendUdp;
+  std::string label;
+  std::string settings;  // kConfigure
+};
+
+// One accepted control connection. Read() is called from one thread, Reply() may be called from any.
+class ControlChannel {
+ public:
+  explicit ControlChannel(boost::asio::ip::tcp::socket &socket) : socket_(socket) {}
+
+  // Blocks for the next command. Returns false when the peer disconnected, also in the middle of a frame, and
+  // after a frame header that is broken: that one is answered with kBadRequest and the connection is closed.
+  // Other malformed or unknown commands are answered here and skipped. Never throws on the peer's account.
+  bool Read(ControlCommand &command);
+
+  void Reply(ReplyStatus status, const void *payload = nullptr, size_t length = 0);
+  void ReplyCapture(bool success, uint32_t index, uint32_t count);
+  void ReplyStats(const std::string &text);
+  void ReplyConfigured(double time);
+  // kBadRequest, with the reason as payload in the binary form
+  void ReplyError(const std::string &reason);
+
+  // true once the peer sent a binary frame, replies are framed from then on
+  bool binary() const { return binary_; }
+
+ private:
+  bool ReadFrame(ControlCommand &command, ReplyStatus &error);
+  bool ParseText(const std::string &message, ControlCommand &command, ReplyStatus &error);
+  // write_mutex_ held, errors are logged
+  template <typename Buffers>
+  void Write(const Buffers &buffers);
+  void Close();
+
+  boost::asio::ip::tcp::socket &socket_;
+  std::mutex write_mutex_;
+  bool binary_ = false;
+};
+
+#endif // COMMON_CONTROL_CHANNEL_HPP_
@@ -0,0 +1,141 @@
+#include "control_client.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+ControlClient::ControlClient(boost::asio::io_context &io_context) : io_context_(io_context), socket_(io_context) {}
+
+void ControlClient::Connect(const std::string &addr, unsigned short port, double timeout) {
+  auto promise = std::make_shared<std::promise<boost::system::error_code>>();
+  auto notice = std::make_shared<char>(0);
+  boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::make_address(addr), port);
+  boost::asio::post(io_context_, [this, endpoint, promise, notice]() {
+    socket_.async_connect(endpoint, [this, promise, notice](const boost::system::error_code &error) {
+      if (error) {
+        promise->set_value(error);
+        return;
+      }
+      socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+      // the node greets in the text form until it has seen a binary frame
+      boost::asio::async_read(socket_, boost::asio::buffer(notice.get(), 1),
+                              [promise, notice](const boost::system::error_code &error, size_t) {
+                                if (!error and *notice != '0' + static_cast<int>(ReplyStatus::kConnected)) {
+                                  promise->set_value(boost::asio::error::make_error_code(
+                                      boost::asio::error::invalid_argument));
+                                  return;
+                                }
+                                promise->set_value(error);
+                              });
+    });
+  });
+  auto result = promise->get_future();
+  if (result.wait_for(std::chrono::duration<double>(timeout)) != std::future_status::ready) {
+    Close();
+    result.wait();
+    throw std::runtime_error("Timed out connecting to " + addr + ":" + std::to_string(port));
+  }
+  boost::system::error_code error = result.get();
+  if (error) throw std::runtime_error("Cannot connect to " + addr + ":" + std::to_string(port) + ": " +
+                                      error.message());
+}
+
+std::future<ControlReply> ControlClient::Send(const ControlCommand &command) {
+  // shared_ptr since the handler that queues it has to be copyable
+  std::shared_ptr<Pending> pending(new Pending);
+  std::vector<char> payload;
+  if (command.id == CommandId::kCapture) {
+    CapturePayload capture{command.count, command.link, command.flags};
+    payload.resize(sizeof(capture) + command.label.size());
+    std::memcpy(payload.data(), &capture, sizeof(capture));
+    std::memcpy(payload.data() + sizeof(capture), command.label.data(), command.label.size());
+  } else if (command.id == CommandId::kConfigure) {
+    payload.assign(command.settings.begin(), command.settings.end());
+  }
+  ControlHeader header{{kControlMagic[0], kControlMagic[1]}, kControlVersion, static_cast<uint8_t>(command.id),
+                       static_cast<uint32_t>(payload.size())};
+  pending->frame.resize(sizeof(header) + payload.size());
+  std::memcpy(pending->frame.data(), &header, sizeof(header));
+  if (!payload.empty()) std::memcpy(pending->frame.data() + sizeof(header), payload.data(), payload.size());
+  pending->num_replies = command.id == CommandId::kCapture ? std::max<uint32_t>(command.count, 1) : 1;
+  auto result = pending->promise.get_future();
+  boost::asio::post(io_context_, [this, pending]() {
+    pending_.push_back(pending);
+    if (pending_.size() == 1) WriteNext();
+  });
+  return result;
+}
+
+void ControlClient::Close() {
+  boost::asio::post(io_context_, [this]() {
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+  });
+}
+
+void ControlClient::WriteNext() {
+  if (pending_.empty()) return;
+  if (!socket_.is_open()) {
+    Fail(boost::asio::error::make_error_code(boost::asio::error::not_connected));
+    return;
+  }
+  boost::asio::async_write(socket_, boost::asio::buffer(pending_.front()->frame),
+                           [this](const boost::system::error_code &error, size_t) {
+                             if (error) {
+                               Fail(error);
+                               return;
+                             }
+                             ReadReply();
+                           });
+}
+
+void ControlClient::ReadReply() {
+  boost::asio::async_read(socket_, boost::asio::buffer(&header_, sizeof(header_)), [this](
+      const boost::system::error_code &error, size_t) {
+    if (error) {
+      Fail(error);
+      return;
+    }
+    if (header_.magic[0] != kControlMagic[0] or header_.magic[1] != kControlMagic[1] or
+        header_.length > kMaxControlPayload) {
+      Fail(boost::asio::error::make_error_code(boost::asio::error::invalid_argument));
+      return;
+    }
+    payload_.resize(header_.length);
+    boost::asio::async_read(socket_, boost::asio::buffer(payload_), [this](const boost::system::error_code &error,
+                                                                           size_t) {
+      if (error) {
+        Fail(error);
+        return;
+      }
+      Pending &pending = *pending_.front();
+      const auto status = static_cast<ReplyStatus>(header_.code);
+      // a failed capture of a batch is kept over the later successful ones
+      if (pending.reply.status != ReplyStatus::kCaptureFailed) {
+        pending.reply.status = status;
+        pending.reply.payload = payload_;
+      }
+      // only captures are answered more than once, anything else ends the batch early
+      if (--pending.num_replies > 0 and
+          (status == ReplyStatus::kCaptureDone or status == ReplyStatus::kCaptureFailed)) {
+        ReadReply();
+        return;
+      }
+      pending.promise.set_value(std::move(pending.reply));
+      pending_.pop_front();
+      WriteNext();
+    });
+  });
+}
+
+void ControlClient::Fail(const boost::system::error_code &error) {
+  boost::system::error_code ignored;
+  socket_.close(ignored);
+  for (auto &pending : pending_) {
+    pending->reply.error = error;
+    pending->reply.status = ReplyStatus::kBadRequest;
+    pending->promise.set_value(std::move(pending->reply));
+  }
+  pending_.clear();
+}
@@ -0,0 +1,56 @@
+#ifndef COMMON_CONTROL_CLIENT_HPP_
+#define COMMON_CONTROL_CLIENT_HPP_
+
+#include "control_channel.hpp"
+
+#include <boost/asio.hpp>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// answer of a node to one command
+struct ControlReply {
+  boost::system::error_code error;  // set when the connection failed, status is kBadRequest then
+  ReplyStatus status = ReplyStatus::kBadRequest;
+  std::vector<char> payload;
+};
+
+// Client end of the control protocol (control_channel.hpp), the binary frames only.
+// All I/O runs on io_context, which must be run by exactly one thread; the other calls may come from any
+// thread. Commands are queued and sent one at a time, each is answered before the next goes out.
+class ControlClient {
+ public:
+  explicit ControlClient(boost::asio::io_context &io_context);
+
+  // Connects and reads the kConnected notice, throws when that fails or takes longer than timeout seconds.
+  void Connect(const std::string &addr, unsigned short port, double timeout);
+
+  // The reply to command; a capture batch (count > 1) is complete at its last reply, the first
+  // kCaptureFailed of the batch is what is returned then.
+  std::future<ControlReply> Send(const ControlCommand &command);
+
+  // closes the connection, what is still waiting for a reply ends with operation_aborted
+  void Close();
+
+ private:
+  struct Pending {
+    std::vector<char> frame;
+    uint32_t num_replies;
+    ControlReply reply;
+    std::promise<ControlReply> promise;
+  };
+
+  void WriteNext();
+  void ReadReply();
+  void Fail(const boost::system::error_code &error);
+
+  boost::asio::io_context &io_context_;
+  boost::asio::ip::tcp::socket socket_;
+  std::deque<std::shared_ptr<Pending>> pending_;  // io thread only, the front one is on the wire
+  ControlHeader header_;
+  std::vector<char> payload_;
+};
+
+#endif // COMMON_CONTROL_CLIENT_HPP_
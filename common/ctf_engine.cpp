@@ -0,0 +1,53 @@
+#include "ctf_engine.hpp"
+
+#include "capture_buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+CtfEngine::CtfEngine(const std::vector<std::complex<float>> &reference, size_t num_samps, double ratio)
+    : fft_(num_samps), inv_reference_(num_samps), work_(num_samps) {
+  if (reference.size() < num_samps) {
+    throw std::invalid_argument("reference waveform is shorter than one port slot");
+  }
+  num_bins_ = static_cast<size_t>(std::lround(static_cast<double>(num_samps) * ratio)) & ~static_cast<size_t>(1);
+  if (num_bins_ == 0 || num_bins_ > num_samps) {
+    throw std::invalid_argument("CTF band ratio must be in (0, 1]");
+  }
+  std::copy(reference.begin(), reference.begin() + static_cast<std::ptrdiff_t>(num_samps), inv_reference_.begin());
+  fft_.Forward(inv_reference_.data());
+  for (auto &bin : inv_reference_) {
+    bin = 1.0f / bin;
+  }
+}
+
+void CtfEngine::Process(const std::complex<float> *samps, std::complex<float> *ctf) {
+  std::copy(samps, samps + fft_.size(), work_.begin());
+  ProcessWork(ctf);
+}
+
+void CtfEngine::Process(const std::complex<int16_t> *samps, std::complex<float> *ctf) {
+  for (size_t k = 0; k < fft_.size(); k++) {
+    work_[k] = std::complex<float>(samps[k].real() * kSc16Scale, samps[k].imag() * kSc16Scale);
+  }
+  ProcessWork(ctf);
+}
+
+void CtfEngine::ProcessWork(std::complex<float> *ctf) {
+  const size_t n = fft_.size();
+  fft_.Forward(work_.data());
+  for (size_t k = 0; k < n; k++) {
+    work_[k] *= inv_reference_[k];
+  }
+
+  // DC repair (util.fixctf): mean amplitude and mean phase of the bins next to DC
+  const float dc_phase = (std::arg(work_[1]) + std::arg(work_[n - 1])) / 2;
+  const float dc_amp = (std::abs(work_[1]) + std::abs(work_[n - 1])) / 2;
+  work_[0] = std::polar(dc_amp, dc_phase);
+
+  // keep the middle of the band: bins [0, num_bins/2) and [n - num_bins/2, n)
+  const size_t half = num_bins_ / 2;
+  std::copy(work_.begin(), work_.begin() + static_cast<std::ptrdiff_t>(half), ctf);
+  std::copy(work_.end() - static_cast<std::ptrdiff_t>(half), work_.end(), ctf + half);
+}
@@ -0,0 +1,39 @@
+#ifndef COMMON_CTF_ENGINE_HPP_
+#define COMMON_CTF_ENGINE_HPP_
+
+#include "fft.hpp"
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Channel transfer function of one port slot, same as the clients compute it:
+//   ctf = util.fixctf(fft(yt) ./ fft(reference), ratio)
+// i.e. the DC bin is repaired from its two neighbours and only the middle `ratio` of the band is kept,
+// in MATLAB's bin order (non-negative frequencies first, then negative ones).
+class CtfEngine {
+ public:
+  // reference: transmitted waveform, its first num_samps samples are used
+  CtfEngine(const std::vector<std::complex<float>> &reference, size_t num_samps, double ratio = 0.5);
+
+  // samps: num_samps() received samples of one port slot (guard interval already skipped)
+  // ctf:   num_bins() output values
+  void Process(const std::complex<float> *samps, std::complex<float> *ctf);
+  // sc16 samples, scaled by kSc16Scale on the way in
+  void Process(const std::complex<int16_t> *samps, std::complex<float> *ctf);
+
+  size_t num_samps() const { return fft_.size(); }
+  size_t num_bins() const { return num_bins_; }
+
+ private:
+  // FFT, reference division, DC repair and band trimming of the samples already in work_
+  void ProcessWork(std::complex<float> *ctf);
+
+  Fft fft_;
+  size_t num_bins_;
+  std::vector<std::complex<float>> inv_reference_;  // 1 / fft(reference)
+  std::vector<std::complex<float>> work_;
+};
+
+#endif // COMMON_CTF_ENGINE_HPP_
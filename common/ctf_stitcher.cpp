@@ -0,0 +1,41 @@
+#include "ctf_stitcher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+CtfStitcher::CtfStitcher(const std::vector<double> &freqs, size_t num_bins, double bin_spacing)
+    : band_bins_(num_bins) {
+  if (freqs.empty() or num_bins == 0 or bin_spacing <= 0) throw std::invalid_argument("Nothing to stitch");
+  const double lowest = *std::min_element(freqs.begin(), freqs.end());
+  size_t span = 0;
+  for (double freq : freqs) {
+    const double offset = (freq - lowest) / bin_spacing;
+    if (std::abs(offset - std::round(offset)) > 1e-3) {
+      throw std::invalid_argument("The hop frequencies must be multiples of rate / samps apart to be stitched");
+    }
+    offsets_.push_back(static_cast<size_t>(std::llround(offset)));
+    span = std::max(span, offsets_.back() + num_bins);
+  }
+  weights_.assign(span, 0);
+  for (size_t offset : offsets_) {
+    for (size_t k = 0; k < num_bins; k++) weights_[offset + k] += 1;
+  }
+  for (auto &weight : weights_) {
+    if (weight > 0) weight = 1 / weight;
+  }
+  first_freq_ = lowest - static_cast<double>(num_bins / 2) * bin_spacing;
+}
+
+void CtfStitcher::Stitch(const std::vector<const std::complex<float> *> &bands, std::complex<float> *out) const {
+  std::fill(out, out + num_bins(), std::complex<float>(0, 0));
+  const size_t half = band_bins_ / 2;
+  for (size_t band = 0; band < offsets_.size(); band++) {
+    // the negative frequencies are the second half of a band, the non-negative ones the first
+    std::complex<float> *dst = out + offsets_[band];
+    const std::complex<float> *ctf = bands[band];
+    for (size_t k = 0; k < half; k++) dst[k] += ctf[half + k];
+    for (size_t k = half; k < band_bins_; k++) dst[k] += ctf[k - half];
+  }
+  for (size_t k = 0; k < num_bins(); k++) out[k] *= weights_[k];
+}
@@ -0,0 +1,32 @@
+#ifndef COMMON_CTF_STITCHER_HPP_
+#define COMMON_CTF_STITCHER_HPP_
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// Joins the CTFs of the bands of a frequency hopping sweep into one CTF over the whole span.
+// Every band is a CtfEngine output: num_bins bins bin_spacing Hz apart around the center frequency of the band,
+// in MATLAB's bin order. The output is in ascending frequency from the lowest bin of the lowest band, bins
+// covered by two bands get their mean and bins between bands that do not touch are 0.
+// Each band keeps the phase of its own LO tuning, only the magnitude is continuous across the joins.
+class CtfStitcher {
+ public:
+  // freqs: center frequency of every band, multiples of bin_spacing apart (throws otherwise)
+  CtfStitcher(const std::vector<double> &freqs, size_t num_bins, double bin_spacing);
+
+  // bands[b]: CTF of band b, num_bins values; out: num_bins() values
+  void Stitch(const std::vector<const std::complex<float> *> &bands, std::complex<float> *out) const;
+
+  size_t num_bins() const { return weights_.size(); }
+  // frequency of the first output bin
+  double first_freq() const { return first_freq_; }
+
+ private:
+  size_t band_bins_;
+  std::vector<size_t> offsets_;  // output bin of the lowest bin of every band
+  std::vector<float> weights_;   // 1 / number of bands covering the bin, 0 in gaps
+  double first_freq_;
+};
+
+#endif // COMMON_CTF_STITCHER_HPP_
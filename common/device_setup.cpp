@@ -0,0 +1,229 @@
+#include "device_setup.hpp"
+
+#include <spdlog/spdlog.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// the sensors change within a few ms, polling is what replaces the fixed waits
+constexpr auto kPollPeriod = std::chrono::milliseconds(5);
+
+double Seconds(Clock::time_point from, Clock::time_point to) {
+  return std::chrono::duration<double>(to - from).count();
+}
+
+// polls ready() until it is true, false after timeout seconds (0: no timeout)
+bool PollUntil(const std::function<bool()> &ready, double timeout) {
+  const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(timeout));
+  while (!ready()) {
+    if (timeout > 0 and Clock::now() > deadline) return false;
+    std::this_thread::sleep_for(kPollPeriod);
+  }
+  return true;
+}
+
+bool HasSensor(const std::vector<std::string> &names, const std::string &name) {
+  return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+void SetupRxChain(Radio &radio, const DeviceSettings &settings) {
+  const auto start = Clock::now();
+  spdlog::info("Setting RX Rate: {} Msps", settings.rate / 1e6);
+  radio.set_rx_rate(settings.rate);
+  spdlog::info("Actual RX Rate: {} Msps", radio.get_rx_rate() / 1e6);
+  for (size_t chan : settings.channels) {
+    uhd::tune_request_t tune_request(settings.freq, settings.lo_off);
+    radio.set_rx_freq(tune_request, chan);
+    spdlog::info("Actual RX Freq (channel {}): {} MHz", chan, radio.get_rx_freq(chan) / 1e6);
+    if (settings.rx.gain) {
+      radio.set_rx_gain(*settings.rx.gain, chan);
+      spdlog::info("Actual RX Gain (channel {}): {} dB", chan, radio.get_rx_gain(chan));
+    }
+    if (settings.rx.bandwidth) {
+      radio.set_rx_bandwidth(*settings.rx.bandwidth, chan);
+      spdlog::info("Actual RX Bandwidth (channel {}): {} MHz", chan, radio.get_rx_bandwidth(chan) / 1e6);
+    }
+    if (settings.rx.antenna) {
+      radio.set_rx_antenna(*settings.rx.antenna, chan);
+      spdlog::info("Actual RX Antenna (channel {}): {}", chan, radio.get_rx_antenna(chan));
+    }
+  }
+  radio.set_rx_dc_offset(true);
+  spdlog::info("RX chains set up in {:.3f} s", Seconds(start, Clock::now()));
+}
+
+void SetupTxChain(Radio &radio, const DeviceSettings &settings) {
+  const auto start = Clock::now();
+  spdlog::info("Setting TX Rate: {} Msps", settings.rate / 1e6);
+  radio.set_tx_rate(settings.rate);
+  spdlog::info("Actual TX Rate: {} Msps", radio.get_tx_rate() / 1e6);
+  for (size_t chan : settings.channels) {
+    uhd::tune_request_t tune_request(settings.freq, settings.lo_off);
+    radio.set_tx_freq(tune_request, chan);
+    spdlog::info("Actual TX Freq (channel {}): {} MHz", chan, radio.get_tx_freq(chan) / 1e6);
+    if (settings.tx.gain) {
+      radio.set_tx_gain(*settings.tx.gain, chan);
+      spdlog::info("Actual TX Gain (channel {}): {} dB", chan, radio.get_tx_gain(chan));
+    }
+    if (settings.tx.bandwidth) {
+      radio.set_tx_bandwidth(*settings.tx.bandwidth, chan);
+      spdlog::info("Actual TX Bandwidth (channel {}): {} MHz", chan, radio.get_tx_bandwidth(chan) / 1e6);
+    }
+    if (settings.tx.antenna) {
+      radio.set_tx_antenna(*settings.tx.antenna, chan);
+      spdlog::info("Actual TX Antenna (channel {}): {}", chan, radio.get_tx_antenna(chan));
+    }
+  }
+  spdlog::info("TX chains set up in {:.3f} s", Seconds(start, Clock::now()));
+}
+
+void WaitForLoLock(Radio &radio, const DeviceSettings &settings, bool rx) {
+  const char *name = rx ? "RX" : "TX";
+  for (size_t chan : settings.channels) {
+    const auto names = rx ? radio.get_rx_sensor_names(chan) : radio.get_tx_sensor_names(chan);
+    if (!HasSensor(names, "lo_locked")) continue;
+    auto read = [&]() {
+      return rx ? radio.get_rx_sensor("lo_locked", chan) : radio.get_tx_sensor("lo_locked", chan);
+    };
+    if (!PollUntil([&]() { return read().to_bool(); }, settings.lock_timeout)) {
+      throw std::runtime_error(std::string(name) + " LO of channel " + std::to_string(chan) + " did not lock");
+    }
+    spdlog::info("Checking {}: {}", name, read().to_pp_string());
+  }
+}
+
+} // namespace
+
+StartupTimer::StartupTimer() : start_(Clock::now()), last_(start_) {}
+
+void StartupTimer::Mark(const std::string &phase) {
+  const auto now = Clock::now();
+  phases_.emplace_back(phase, Seconds(last_, now));
+  last_ = now;
+}
+
+void StartupTimer::Report() const {
+  std::string breakdown;
+  for (const auto &phase : phases_) {
+    breakdown += fmt::format("{}{} {:.3f} s", breakdown.empty() ? "" : ", ", phase.first, phase.second);
+  }
+  spdlog::info("Ready {:.3f} s after start: {}", Seconds(start_, last_), breakdown);
+}
+
+std::vector<size_t> ParseChannels(const std::string &channels, size_t num_channels) {
+  std::vector<std::string> channel_strings;
+  std::vector<size_t> channel_nums;
+  boost::split(channel_strings, channels, boost::is_any_of("\"',"));
+  for (const auto &kChannelString : channel_strings) {
+    size_t chan = boost::lexical_cast<int>(kChannelString);
+    if (chan >= num_channels) {
+      throw std::runtime_error("Invalid channel(s) specified.");
+    } else {
+      channel_nums.push_back(chan);
+    }
+  }
+  return channel_nums;
+}
+
+void BringUp(Radio &radio, const DeviceSettings &settings, StartupTimer &timer) {
+  spdlog::info("Locking mboard clocks");
+  radio.set_clock_source(settings.clock_source);
+  radio.set_time_source(settings.time_source.empty() ? settings.clock_source : settings.time_source);
+
+  // the chains are set up while the reference locks, the LOs lock again to it anyway. One thread sets up both of
+  // them unless concurrent setup was asked for.
+  std::future<void> rx_chain, tx_chain;
+  if (settings.concurrent) {
+    if (settings.rx.enabled) rx_chain = std::async(std::launch::async, [&]() { SetupRxChain(radio, settings); });
+    if (settings.tx.enabled) tx_chain = std::async(std::launch::async, [&]() { SetupTxChain(radio, settings); });
+  } else {
+    rx_chain = std::async(std::launch::async, [&]() {
+      if (settings.rx.enabled) SetupRxChain(radio, settings);
+      if (settings.tx.enabled) SetupTxChain(radio, settings);
+    });
+  }
+
+  const auto mboard_sensors = radio.get_mboard_sensor_names(0);
+  if (settings.clock_source == "gpsdo" and HasSensor(mboard_sensors, "gps_locked")) {
+    spdlog::info("Waiting for GPSDO lock...");
+    if (!PollUntil([&]() { return radio.get_mboard_sensor("gps_locked", 0).to_bool(); }, settings.gps_timeout)) {
+      throw std::runtime_error("GPSDO did not lock");
+    }
+    spdlog::info("GPSDO Locked");
+  }
+  if (settings.clock_source != "internal" and HasSensor(mboard_sensors, "ref_locked")) {
+    if (!PollUntil([&]() { return radio.get_mboard_sensor("ref_locked", 0).to_bool(); }, settings.lock_timeout)) {
+      throw std::runtime_error("Reference clock did not lock");
+    }
+    spdlog::info("Checking: {}", radio.get_mboard_sensor("ref_locked", 0).to_pp_string());
+  }
+  if (rx_chain.valid()) rx_chain.get();
+  if (tx_chain.valid()) tx_chain.get();
+  timer.Mark("tune");
+
+  if (settings.rx.enabled) WaitForLoLock(radio, settings, true);
+  if (settings.tx.enabled) WaitForLoLock(radio, settings, false);
+  timer.Mark("lock");
+}
+
+PpsTimeReset::PpsTimeReset(Radio &radio)
+    : radio_(radio), set_time_(Clock::now()), time_at_set_(radio.get_time_now().get_real_secs()) {
+  radio_.set_time_next_pps(uhd::time_spec_t(0.0));
+}
+
+bool PpsTimeReset::Wait(double timeout) {
+  // Without the edge the device time runs on from time_at_set_, after it the device time is at most the time
+  // since the reset was set. The two are at least time_at_set_ apart, however much later this is called.
+  // They cannot be told apart when the time was about 0 already: wait a whole period then.
+  if (time_at_set_ < 0.5) {
+    std::this_thread::sleep_until(set_time_ + std::chrono::milliseconds(1100));
+    return true;
+  }
+  const double waited = Seconds(set_time_, Clock::now());
+  return PollUntil([&]() {
+    return radio_.get_time_now().get_real_secs() < time_at_set_ + Seconds(set_time_, Clock::now()) - 0.25;
+  }, std::max(timeout - waited, 0.001));
+}
+
+void Retune(Radio &radio, const DeviceSettings &settings, double command_time) {
+  std::lock_guard<std::mutex> lock(radio.command_mutex());
+  if (command_time > 0) radio.set_command_time(uhd::time_spec_t(command_time));
+  for (size_t chan : settings.channels) {
+    uhd::tune_request_t tune_request(settings.freq, settings.lo_off);
+    if (settings.rx.enabled) {
+      radio.set_rx_freq(tune_request, chan);
+      if (settings.rx.gain) radio.set_rx_gain(*settings.rx.gain, chan);
+      if (settings.rx.bandwidth) radio.set_rx_bandwidth(*settings.rx.bandwidth, chan);
+    }
+    if (settings.tx.enabled) {
+      radio.set_tx_freq(tune_request, chan);
+      if (settings.tx.gain) radio.set_tx_gain(*settings.tx.gain, chan);
+      if (settings.tx.bandwidth) radio.set_tx_bandwidth(*settings.tx.bandwidth, chan);
+    }
+  }
+  if (command_time > 0) radio.clear_command_time();
+  spdlog::debug("Retune to {} MHz at {}", settings.freq / 1e6, command_time);
+}
+
+size_t RetuneCommands(const DeviceSettings &settings) {
+  size_t num_commands = 0;
+  for (const ChainSettings *chain : {&settings.rx, &settings.tx}) {
+    if (chain->enabled) num_commands += 1 + (chain->gain ? 1 : 0) + (chain->bandwidth ? 1 : 0);
+  }
+  return num_commands * settings.channels.size();
+}
+
+bool SameTuning(const DeviceSettings &a, const DeviceSettings &b) {
+  return a.freq == b.freq and a.lo_off == b.lo_off and a.rx.gain == b.rx.gain and a.tx.gain == b.tx.gain
+      and a.rx.bandwidth == b.rx.bandwidth and a.tx.bandwidth == b.tx.bandwidth;
+}
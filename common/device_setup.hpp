@@ -0,0 +1,86 @@
+#ifndef COMMON_DEVICE_SETUP_HPP_
+#define COMMON_DEVICE_SETUP_HPP_
+
+#include "radio.hpp"
+
+#include <boost/optional.hpp>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+// settings of one direction, applied to every channel; what is not set stays at the device default
+struct ChainSettings {
+  bool enabled = false;
+  boost::optional<double> gain;
+  boost::optional<double> bandwidth;
+  boost::optional<std::string> antenna;
+};
+
+// what the cores set up before streaming
+struct DeviceSettings {
+  std::vector<size_t> channels;
+  std::string clock_source = "internal";
+  std::string time_source;  // empty: same as clock_source
+  double rate = 0;
+  double freq = 0;
+  double lo_off = 0;
+  ChainSettings rx, tx;
+  double lock_timeout = 5;  // seconds for the reference and LO lock sensors
+  double gps_timeout = 0;   // seconds for the GPSDO to lock, 0: as long as it takes (minutes when cold)
+  // set up the rx and tx chains on two threads. Off by default: the one setup thread already runs while the
+  // reference locks, so a second one only takes off what the chains need beyond the lock (the "tune" phase of the
+  // startup line), while UHD does not promise that concurrent setters are safe and the chains race on the tuning
+  // of devices with a shared rx / tx LO. Only for devices known to cope, and only where both chains are enabled.
+  bool concurrent = false;
+};
+
+// Phases of the startup and how long each took, logged as one line once the device is ready.
+class StartupTimer {
+ public:
+  StartupTimer();
+
+  // ends the current phase
+  void Mark(const std::string &phase);
+  void Report() const;
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_;
+  std::vector<std::pair<std::string, double>> phases_;
+};
+
+// "0,1" -> {0, 1}, throws for channels the device does not have
+std::vector<size_t> ParseChannels(const std::string &channels, size_t num_channels);
+
+// Clock and time source, rate, frequency, gain, bandwidth and antenna of every channel, then waits for the
+// lock sensors the device has. The rx and tx chains are set up one after the other (with settings.concurrent at
+// the same time) while the reference locks, and the sensors are polled, so this returns as soon as the device is
+// ready. Throws when a lock does not come in time. Adds the phases "tune" and "lock" to timer.
+void BringUp(Radio &radio, const DeviceSettings &settings, StartupTimer &timer);
+
+// Frequency, gain and bandwidth of every channel of the enabled chains as timed commands at command_time
+// (device time, <= 0: right away). Rate, antenna and clocks are left as they are, the rate cannot be timed.
+void Retune(Radio &radio, const DeviceSettings &settings, double command_time);
+// device commands that Retune() queues
+size_t RetuneCommands(const DeviceSettings &settings);
+
+// true when Retune() would not change anything going from a to b
+bool SameTuning(const DeviceSettings &a, const DeviceSettings &b);
+
+// Sets the device time to 0 at the next PPS edge. Setup that does not read the device time (streamers, files,
+// sockets) runs while the edge is still to come, Wait() returns once it has passed.
+class PpsTimeReset {
+ public:
+  explicit PpsTimeReset(Radio &radio);
+
+  // false if no edge was seen within timeout seconds of the reset
+  bool Wait(double timeout = 2.1);
+
+ private:
+  Radio &radio_;
+  std::chrono::steady_clock::time_point set_time_;
+  double time_at_set_;  // device time when the reset was set
+};
+
+#endif // COMMON_DEVICE_SETUP_HPP_
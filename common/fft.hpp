@@ -0,0 +1,29 @@
+#ifndef COMMON_FFT_HPP_
+#define COMMON_FFT_HPP_
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// In-place radix-2 FFT for a fixed power-of-two length.
+// Twiddles and the bit-reversal permutation are computed once, so Forward() does no allocation.
+class Fft {
+ public:
+  explicit Fft(size_t size);
+
+  void Forward(std::complex<float> *data) const;
+  // unnormalized inverse, scale by 1/size() yourself if needed
+  void Inverse(std::complex<float> *data) const;
+
+  size_t size() const { return size_; }
+
+ private:
+  void Transform(std::complex<float> *data, const std::vector<std::complex<float>> &twiddles) const;
+
+  size_t size_;
+  std::vector<size_t> bit_reverse_;
+  std::vector<std::complex<float>> twiddles_;      // exp(-j*2*pi*k/size), k < size/2
+  std::vector<std::complex<float>> inv_twiddles_;  // complex conjugate of twiddles_
+};
+
+#endif // COMMON_FFT_HPP_
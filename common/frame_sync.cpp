@@ -0,0 +1,103 @@
+#include "frame_sync.hpp"
+
+#include "capture_buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+size_t NextPowerOfTwo(size_t n) {
+  size_t size = 2;
+  while (size < n) size <<= 1;
+  return size;
+}
+
+// the conjugated FFT of reference, zero padded to the size of fft
+std::vector<std::complex<float>> ConjugateSpectrum(const Fft &fft, const std::vector<std::complex<float>> &reference) {
+  std::vector<std::complex<float>> spectrum(fft.size());
+  std::copy(reference.begin(), reference.end(), spectrum.begin());
+  fft.Forward(spectrum.data());
+  for (auto &bin : spectrum) bin = std::conj(bin);
+  return spectrum;
+}
+
+}  // namespace
+
+FrameSync::FrameSync(const std::vector<std::complex<float>> &reference, size_t window)
+    : window_(window),
+      search_fft_(NextPowerOfTwo(window + reference.size())),
+      period_fft_(reference.size()),
+      search_reference_(ConjugateSpectrum(search_fft_, reference)),
+      period_reference_(ConjugateSpectrum(period_fft_, reference)),
+      work_(search_fft_.size()),
+      magnitude_(search_fft_.size()) {
+  if (window < 2 * reference.size()) throw std::invalid_argument("The sync window must hold two waveform periods");
+}
+
+double FrameSync::Acquire(const std::complex<float> *samples) {
+  std::copy(samples, samples + window_, work_.begin());
+  return AcquireWork();
+}
+
+double FrameSync::Acquire(const std::complex<int16_t> *samples) {
+  for (size_t k = 0; k < window_; k++) {
+    work_[k] = std::complex<float>(samples[k].real() * kSc16Scale, samples[k].imag() * kSc16Scale);
+  }
+  return AcquireWork();
+}
+
+double FrameSync::Track(const std::complex<float> *samples) {
+  std::copy(samples, samples + period(), work_.begin());
+  return TrackWork();
+}
+
+double FrameSync::Track(const std::complex<int16_t> *samples) {
+  for (size_t k = 0; k < period(); k++) {
+    work_[k] = std::complex<float>(samples[k].real() * kSc16Scale, samples[k].imag() * kSc16Scale);
+  }
+  return TrackWork();
+}
+
+void FrameSync::Correlate(const Fft &fft, const std::vector<std::complex<float>> &conj_reference) {
+  const size_t n = fft.size();
+  fft.Forward(work_.data());
+  for (size_t k = 0; k < n; k++) work_[k] *= conj_reference[k];
+  fft.Inverse(work_.data());
+  for (size_t k = 0; k < n; k++) magnitude_[k] = std::abs(work_[k]);
+}
+
+double FrameSync::Interpolate(size_t k, size_t size) const {
+  const double before = magnitude_[(k + size - 1) % size];
+  const double peak = magnitude_[k];
+  const double after = magnitude_[(k + 1) % size];
+  const double curvature = before - 2 * peak + after;
+  return curvature < 0 ? 0.5 * (before - after) / curvature : 0;
+}
+
+double FrameSync::AcquireWork() {
+  std::fill(work_.begin() + static_cast<std::ptrdiff_t>(window_), work_.end(), std::complex<float>(0, 0));
+  Correlate(search_fft_, search_reference_);
+  // only the lags where the whole reference lies inside the window
+  const auto first = magnitude_.begin();
+  const auto last = magnitude_.begin() + static_cast<std::ptrdiff_t>(window_ - period() + 1);
+  const float peak = *std::max_element(first, last);
+  const float mean = std::accumulate(first, last, 0.0f) / static_cast<float>(last - first);
+  if (peak < 4 * mean) return -1;
+  // the waveform repeats, so every period after the start peaks about as high: the start is the first of them
+  auto k = static_cast<size_t>(std::find_if(first, last, [&](float value) { return value >= peak / 2; }) - first);
+  while (k + 1 < static_cast<size_t>(last - first) and magnitude_[k + 1] > magnitude_[k]) k++;
+  return static_cast<double>(k) + Interpolate(k, search_fft_.size());
+}
+
+double FrameSync::TrackWork() {
+  Correlate(period_fft_, period_reference_);
+  const size_t n = period();
+  const auto k = static_cast<size_t>(std::max_element(magnitude_.begin(), magnitude_.begin()
+      + static_cast<std::ptrdiff_t>(n)) - magnitude_.begin());
+  double lag = static_cast<double>(k) + Interpolate(k, n);
+  if (lag >= static_cast<double>(n) / 2) lag -= static_cast<double>(n);
+  return lag;
+}
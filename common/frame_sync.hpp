@@ -0,0 +1,48 @@
+#ifndef COMMON_FRAME_SYNC_HPP_
+#define COMMON_FRAME_SYNC_HPP_
+
+#include "fft.hpp"
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Finds the TX waveform in the received stream by FFT cross-correlation against it.
+// Acquire() looks for the start of a sweep: the first correlation peak in a window received from before the
+// burst arrives. Track() measures where one received period lies within the waveform period, to follow the
+// offset from capture to capture. Offsets are in samples, the fraction from a parabola through the peak.
+class FrameSync {
+ public:
+  // reference: one period of the TX waveform, a power of two samples long (throws otherwise),
+  // window: samples searched by Acquire(), at least two periods
+  FrameSync(const std::vector<std::complex<float>> &reference, size_t window);
+
+  // where the reference starts in samples[0, window()), -1 when no peak stands out of the noise
+  double Acquire(const std::complex<float> *samples);
+  double Acquire(const std::complex<int16_t> *samples);
+  // lag of samples[0, period()): samples[i] ~ reference[(i - lag) % period()], in [-period() / 2, period() / 2)
+  double Track(const std::complex<float> *samples);
+  double Track(const std::complex<int16_t> *samples);
+
+  size_t period() const { return period_fft_.size(); }
+  size_t window() const { return window_; }
+
+ private:
+  // |correlation| of work_ with the reference, conj_reference is the conjugated FFT of the zero padded reference
+  void Correlate(const Fft &fft, const std::vector<std::complex<float>> &conj_reference);
+  // fraction of a sample from the peak at k and its neighbours (wrapping around the correlation)
+  double Interpolate(size_t k, size_t size) const;
+  double AcquireWork();
+  double TrackWork();
+
+  size_t window_;
+  Fft search_fft_;  // window + period, rounded up: no wrap around for the lags that are searched
+  Fft period_fft_;
+  std::vector<std::complex<float>> search_reference_;
+  std::vector<std::complex<float>> period_reference_;
+  std::vector<std::complex<float>> work_;
+  std::vector<float> magnitude_;
+};
+
+#endif // COMMON_FRAME_SYNC_HPP_
@@ -0,0 +1,227 @@
+#include "gpio_schedule.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+Histogram &gpio_lead_seconds = Metrics().AddHistogram("gpio_lead_seconds",
+                                                      "how far ahead of its time a GPIO command was issued");
+Counter &gpio_commands = Metrics().AddCounter("gpio_commands_total", "timed GPIO commands issued");
+Counter &gpio_late = Metrics().AddCounter("gpio_late_total", "GPIO commands issued after their time");
+Counter &gpio_reordered = Metrics().AddCounter("gpio_reordered_total",
+                                               "timed commands queued after a later one had been issued");
+Gauge &gpio_max_depth = Metrics().AddGauge("gpio_queue_depth_max", "deepest the GPIO command queue has been");
+
+// drops writes of the state that is already on the output
+void AppendEvent(std::vector<GpioEvent> &timeline, uint64_t offset, uint32_t state) {
+  if (timeline.empty() or timeline.back().state != state) timeline.push_back({offset, state});
+}
+
+// one write per change of the selected port, ports the mask does not drive are rejected
+SweepTimeline SwitchTimeline(const SwitchPattern &pattern, uint32_t mask, bool tx) {
+  SweepTimeline timeline;
+  for (const auto &slot : pattern.slots()) {
+    const uint32_t port = tx ? slot.tx_port : slot.rx_port;
+    if (((mask >> port) & 1u) == 0) {
+      throw std::runtime_error("Switch port " + std::to_string(port) + " is not driven by the GPIO mask");
+    }
+    AppendEvent(timeline.events, timeline.num_samps, mask & ~(1u << port));
+    timeline.num_samps += slot.dwell;
+  }
+  return timeline;
+}
+
+}  // namespace
+
+SweepTimeline RxSwitchTimeline(const SwitchPattern &pattern, uint32_t mask) {
+  return SwitchTimeline(pattern, mask, false);
+}
+
+SweepTimeline TxSwitchTimeline(const SwitchPattern &pattern, uint32_t mask) {
+  return SwitchTimeline(pattern, mask, true);
+}
+
+GpioScheduler::GpioScheduler(const Radio::sptr &usrp, double rate, uint32_t mask,
+                             size_t queue_depth, const std::string &bank, double issue_lead)
+    : usrp_(usrp), mask_(mask), queue_depth_(std::max<size_t>(queue_depth, 1)), bank_(bank),
+      issue_lead_(issue_lead), rate_(rate) {
+  device_time_ = usrp_->get_time_now().get_real_secs();
+  host_time_ = std::chrono::steady_clock::now();
+  thread_ = std::thread([this]() { IssuerWorker(); });
+}
+
+GpioScheduler::~GpioScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    if (!queue_.empty()) spdlog::warn("GPIO: {} timed commands dropped", queue_.size());
+  }
+  wake_.notify_one();
+  done_.notify_all();
+  thread_.join();
+}
+
+double GpioScheduler::DeviceTimeNow() {
+  const auto now = std::chrono::steady_clock::now();
+  if (now - host_time_ > std::chrono::seconds(1)) {
+    device_time_ = usrp_->get_time_now().get_real_secs();
+    host_time_ = std::chrono::steady_clock::now();
+    TraceClockSync(device_time_);
+    return device_time_;
+  }
+  return device_time_ + std::chrono::duration<double>(now - host_time_).count();
+}
+
+void GpioScheduler::set_rate(double rate) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rate_ = rate;
+}
+
+void GpioScheduler::Push(Command command) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    command.order = num_queued_++;
+    if (command.pending) ++*command.pending;
+    queue_.push_back(std::move(command));
+    std::push_heap(queue_.begin(), queue_.end(), Later());
+  }
+  wake_.notify_one();
+}
+
+void GpioScheduler::Schedule(double time, size_t num_commands, std::function<void()> command) {
+  Push({time, 0, 0, 0, num_commands, std::move(command), 0, nullptr});
+}
+
+void GpioScheduler::IssuerWorker() {
+  TraceThreadName("gpio issue");
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    if (queue_.empty()) {
+      wake_.wait(lock);
+      continue;
+    }
+    const double now = DeviceTimeNow();
+    while (!in_flight_.empty() and in_flight_.front() <= now) in_flight_.pop_front();
+    // not before issue_lead_ ahead of its time, and only when the device queue has room for it
+    const Command &next = queue_.front();
+    double wait = next.time - issue_lead_ - now;
+    if (wait <= 0 and !in_flight_.empty() and in_flight_.size() + next.num_commands > queue_depth_) {
+      wait = in_flight_.front() - now;
+    }
+    if (wait > 0) {
+      wake_.wait_for(lock, std::chrono::duration<double>(wait));
+      continue;
+    }
+    const Command command = next;
+    std::pop_heap(queue_.begin(), queue_.end(), Later());
+    queue_.pop_back();
+
+    // the device runs its queue in order, a command behind a later one runs late
+    if (command.time < last_issued_) {
+      gpio_reordered.Add();
+      if (num_reordered_++ == 0) {
+        spdlog::warn("Timed command for {} queued after one for {} had been issued", command.time, last_issued_);
+      }
+    }
+    last_issued_ = std::max(last_issued_, command.time);
+    const double lead = command.time - now;
+    gpio_lead_seconds.Observe(lead);
+    if (lead < 0) {
+      gpio_late.Add();
+      if (num_late_++ == 0) spdlog::warn("GPIO command for {} issued late", command.time);
+    }
+    for (size_t k = 0; k < command.num_commands; k++) in_flight_.push_back(command.time);
+    gpio_max_depth.Max(static_cast<int64_t>(in_flight_.size()));
+    if (in_flight_.size() > max_depth_.load(std::memory_order_relaxed)) {
+      max_depth_.store(in_flight_.size(), std::memory_order_relaxed);
+    }
+
+    lock.unlock();
+    Issue(command);
+    lock.lock();
+    num_issued_ += command.num_commands;
+    gpio_commands.Add(command.num_commands);
+    if (command.pending) --*command.pending;
+    done_.notify_all();
+  }
+}
+
+void GpioScheduler::Issue(const Command &command) {
+  if (command.action) {
+    command.action();
+    return;
+  }
+  {
+    // the command time applies to nothing else
+    std::lock_guard<std::mutex> lock(usrp_->command_mutex());
+    usrp_->set_command_time(uhd::time_spec_t::from_ticks(command.tick, command.rate));
+    usrp_->set_gpio_attr(bank_, "OUT", command.state, mask_);
+    usrp_->clear_command_time();
+  }
+  TraceInstant("gpio command", command.time, command.state);
+}
+
+size_t GpioScheduler::Run(const SweepTimeline &timeline, double start_time, size_t num_sweeps, double period,
+                          const std::atomic<bool> &keep_running) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const double rate = rate_;
+  lock.unlock();
+  size_t pending = 0;  // commands of this run not issued yet, counted under mutex_
+  auto push = [&](long long tick, uint32_t state) {
+    Push({static_cast<double>(tick) / rate, tick, rate, state, 1, nullptr, 0, &pending});
+  };
+
+  const long long start_tick = std::llround(start_time * rate);
+  const long long period_ticks = std::llround(period * rate);
+  auto sweep_tick = [&](size_t sweep) { return start_tick + static_cast<long long>(sweep) * period_ticks; };
+  const size_t sweep_commands = timeline.events.size();
+  size_t sweep = 0;
+  lock.lock();
+  while ((num_sweeps == 0 or sweep < num_sweeps) and keep_running and running_) {
+    // compiled ahead for as long as the queue has room for another sweep, a stop is looked at every issue lead
+    if (pending > 0 and pending + sweep_commands > queue_depth_) {
+      done_.wait_for(lock, std::chrono::duration<double>(issue_lead_));
+      continue;
+    }
+    lock.unlock();
+    for (const auto &event : timeline.events) {
+      push(sweep_tick(sweep) + static_cast<long long>(event.offset), event.state);
+    }
+    lock.lock();
+    sweep++;
+  }
+
+  long long idle_tick = sweep > 0 ? sweep_tick(sweep - 1) + static_cast<long long>(timeline.num_samps) : start_tick;
+  if (num_sweeps == 0 or sweep < num_sweeps) {
+    // stopped: the sweeps that are not due yet are taken back and the output goes idle at the end of the last one
+    // kept, but not before anything the issuer may have handed to the device already
+    const long long due_tick = std::llround((DeviceTimeNow() + 2 * issue_lead_) * rate);
+    size_t kept = sweep;
+    while (kept > 0 and sweep_tick(kept - 1) > due_tick) kept--;
+    if (kept < sweep) {
+      const long long cancel_tick = sweep_tick(kept);
+      const auto taken = std::remove_if(queue_.begin(), queue_.end(), [&](const Command &command) {
+        return command.pending == &pending and command.tick >= cancel_tick;
+      });
+      pending -= static_cast<size_t>(queue_.end() - taken);
+      queue_.erase(taken, queue_.end());
+      std::make_heap(queue_.begin(), queue_.end(), Later());
+      sweep = kept;
+      idle_tick = kept > 0 ? sweep_tick(kept - 1) + static_cast<long long>(timeline.num_samps) : start_tick;
+    }
+    if (sweep > 0) idle_tick = std::max(idle_tick, due_tick);
+  }
+  lock.unlock();
+  // idle once the last sweep is over
+  if (!timeline.events.empty()) push(idle_tick, mask_);
+
+  lock.lock();
+  done_.wait(lock, [&]() { return pending == 0 or !running_; });
+  spdlog::info("GPIO finished: {} commands, max queue depth {}, {} late", num_issued(), max_depth(), num_late());
+  return sweep;
+}
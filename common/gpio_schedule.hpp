@@ -0,0 +1,117 @@
+#ifndef COMMON_GPIO_SCHEDULE_HPP_
+#define COMMON_GPIO_SCHEDULE_HPP_
+
+#include "radio.hpp"
+#include "switch_pattern.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one timed write of the GPIO output register, offset in samples from the start of the sweep
+struct GpioEvent {
+  uint64_t offset;
+  uint32_t state;
+};
+
+// GPIO writes of one sweep, the output goes back to idle num_samps samples after the sweep start
+struct SweepTimeline {
+  std::vector<GpioEvent> events;
+  uint64_t num_samps = 0;
+};
+
+// Antenna switch timelines of one sweep, the rx node follows the rx port and the tx node the tx port of
+// every pattern slot. Port j is selected by pulling bit j of mask low, idle is all bits high.
+// Writes that would not change the output are left out, so a tx port held over several slots is one write.
+SweepTimeline RxSwitchTimeline(const SwitchPattern &pattern, uint32_t mask);
+SweepTimeline TxSwitchTimeline(const SwitchPattern &pattern, uint32_t mask);
+
+// Issues sweep timelines and other timed commands to the one time ordered command queue of the device.
+// Runs from several threads (the tx and the rx switching) and Schedule() are merged into one queue on the host,
+// which an issuer thread hands to the device in time order, at most queue_depth commands deep between them.
+// A command is held back until it is issue_lead seconds from its time, so anything queued more than that ahead
+// keeps its place in time even when it comes after a later one. The device time is read now and then and
+// tracked on the host clock in between, so topping up the queue costs no extra round trips.
+// Commands whose time has already passed when they are issued are counted as late.
+class GpioScheduler {
+ public:
+  GpioScheduler(const Radio::sptr &usrp, double rate, uint32_t mask,
+                size_t queue_depth = 64, const std::string &bank = "FP0", double issue_lead = 0.02);
+  // commands that are not issued yet are dropped
+  ~GpioScheduler();
+
+  // Runs num_sweeps sweeps (0: as long as keep_running), one every period seconds from start_time
+  // (device time), then returns the output to idle at the end of the last one. Sweeps are queued ahead until
+  // queue_depth commands of the run wait to be issued. Clearing keep_running makes Run() stop after the sweep
+  // that is due, the sweeps queued behind it are taken back.
+  // Returns the number of sweeps run, once all of them are issued. The next Run() can take over from there with
+  // another timeline.
+  size_t Run(const SweepTimeline &timeline, double start_time, size_t num_sweeps, double period,
+             const std::atomic<bool> &keep_running);
+  // Any other timed write (a retune) in turn with the GPIO writes: command is called at its turn and sets and
+  // clears the command time itself, num_commands is how many device commands it queues.
+  void Schedule(double time, size_t num_commands, std::function<void()> command);
+  // sample rate of the timelines of the runs started after this
+  void set_rate(double rate);
+
+  size_t num_issued() const { return num_issued_.load(std::memory_order_relaxed); }
+  size_t num_late() const { return num_late_.load(std::memory_order_relaxed); }
+  size_t max_depth() const { return max_depth_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Command {
+    double time;           // device time, the order of the queue
+    long long tick;        // exact time of a GPIO write, in ticks of rate
+    double rate;
+    uint32_t state;
+    size_t num_commands;
+    std::function<void()> action;  // empty for a GPIO write
+    uint64_t order;        // commands of the same time stay in the order they were queued
+    size_t *pending;       // of the Run() that queued it
+  };
+  struct Later {
+    bool operator()(const Command &a, const Command &b) const {
+      return a.time > b.time or (a.time == b.time and a.order > b.order);
+    }
+  };
+
+  void Push(Command command);
+  void IssuerWorker();
+  void Issue(const Command &command);
+  // device time estimate, read from the device when it is more than a second old (mutex_ held)
+  double DeviceTimeNow();
+
+  Radio::sptr usrp_;
+  uint32_t mask_;
+  size_t queue_depth_;
+  std::string bank_;
+  double issue_lead_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;  // issuer: a new command
+  std::condition_variable done_;  // Run(): a command was issued
+  double rate_;
+  std::vector<Command> queue_;  // heap ordered by Later, a stopped Run() takes its sweeps back out of it
+  uint64_t num_queued_ = 0;
+  double last_issued_ = 0;     // time of the latest command handed to the device
+  std::deque<double> in_flight_;  // times of the issued commands not yet executed, one per device command
+  bool running_ = true;
+  // device time estimate: device_time_ at host_time_ plus the host clock since then
+  double device_time_ = 0;
+  std::chrono::steady_clock::time_point host_time_;
+  std::thread thread_;
+
+  std::atomic<size_t> num_issued_{0};
+  std::atomic<size_t> num_late_{0};
+  std::atomic<size_t> num_reordered_{0};
+  std::atomic<size_t> max_depth_{0};
+};
+
+#endif // COMMON_GPIO_SCHEDULE_HPP_
@@ -0,0 +1,109 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+void Gauge::Max(int64_t value) {
+  int64_t current = value_.load(std::memory_order_relaxed);
+  while (value > current and !value_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void Histogram::Observe(double seconds) {
+  size_t k = 0;
+  const double micros = seconds * 1e6;
+  if (micros > 1) {
+    // smallest k with micros <= 2^k
+    int exponent;
+    const double mantissa = std::frexp(micros, &exponent);
+    k = std::min<size_t>(static_cast<size_t>(mantissa == 0.5 ? exponent - 1 : exponent), kNumBuckets - 1);
+  }
+  buckets_[k].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  if (seconds > 0) sum_ns_.fetch_add(static_cast<uint64_t>(seconds * 1e9), std::memory_order_relaxed);
+}
+
+double Histogram::UpperBound(size_t bucket) {
+  return bucket + 1 < kNumBuckets ? std::ldexp(1e-6, static_cast<int>(bucket)) : INFINITY;
+}
+
+size_t MetricsRegistry::Find(const std::string &name, Type type) const {
+  for (const auto &entry : entries_) {
+    if (entry.name == name and entry.type == type) return entry.index;
+  }
+  return SIZE_MAX;
+}
+
+Counter &MetricsRegistry::AddCounter(const std::string &name, const std::string &help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t index = Find(name, Type::kCounter);
+  if (index != SIZE_MAX) return counters_[index];
+  entries_.push_back({name, help, Type::kCounter, counters_.size()});
+  counters_.emplace_back();
+  return counters_.back();
+}
+
+Gauge &MetricsRegistry::AddGauge(const std::string &name, const std::string &help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t index = Find(name, Type::kGauge);
+  if (index != SIZE_MAX) return gauges_[index];
+  entries_.push_back({name, help, Type::kGauge, gauges_.size()});
+  gauges_.emplace_back();
+  return gauges_.back();
+}
+
+Histogram &MetricsRegistry::AddHistogram(const std::string &name, const std::string &help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t index = Find(name, Type::kHistogram);
+  if (index != SIZE_MAX) return histograms_[index];
+  entries_.push_back({name, help, Type::kHistogram, histograms_.size()});
+  histograms_.emplace_back();
+  return histograms_.back();
+}
+
+std::string MetricsRegistry::Render() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string text;
+  char line[256];
+  for (const auto &entry : entries_) {
+    const std::string name = "cs_" + entry.name;
+    text += "# HELP " + name + " " + entry.help + "\n";
+    if (entry.type == Type::kCounter) {
+      text += "# TYPE " + name + " counter\n";
+      std::snprintf(line, sizeof(line), "%s %llu\n", name.c_str(),
+                    static_cast<unsigned long long>(counters_[entry.index].value()));
+      text += line;
+    } else if (entry.type == Type::kGauge) {
+      text += "# TYPE " + name + " gauge\n";
+      std::snprintf(line, sizeof(line), "%s %lld\n", name.c_str(),
+                    static_cast<long long>(gauges_[entry.index].value()));
+      text += line;
+    } else {
+      // buckets are cumulative in the exposition format
+      const Histogram &histogram = histograms_[entry.index];
+      text += "# TYPE " + name + " histogram\n";
+      uint64_t cumulative = 0;
+      for (size_t k = 0; k < Histogram::kNumBuckets; k++) {
+        cumulative += histogram.bucket(k);
+        if (k + 1 < Histogram::kNumBuckets) {
+          std::snprintf(line, sizeof(line), "%s_bucket{le=\"%.9g\"} %llu\n", name.c_str(), Histogram::UpperBound(k),
+                        static_cast<unsigned long long>(cumulative));
+        } else {
+          std::snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", name.c_str(),
+                        static_cast<unsigned long long>(cumulative));
+        }
+        text += line;
+      }
+      std::snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n", name.c_str(), histogram.sum(),
+                    name.c_str(), static_cast<unsigned long long>(histogram.count()));
+      text += line;
+    }
+  }
+  return text;
+}
+
+MetricsRegistry &Metrics() {
+  static MetricsRegistry registry;
+  return registry;
+}
@@ -0,0 +1,89 @@
+#ifndef COMMON_METRICS_HPP_
+#define COMMON_METRICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process wide counters and histograms of the hot paths.
+// Updating one is a relaxed atomic add, so they can be touched from the recv / send loops. The registry
+// is only locked when a metric is added (at static initialization) and when the text is rendered.
+
+class Counter {
+ public:
+  void Add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+ public:
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  // keeps the largest value seen
+  void Max(int64_t value);
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+// Histogram of durations in seconds, bucket k counts the values up to 1 us * 2^k, the last one the rest
+// (about 8 s and up). Negative values land in the first bucket.
+class Histogram {
+ public:
+  static const size_t kNumBuckets = 25;
+
+  void Observe(double seconds);
+  void Observe(std::chrono::steady_clock::duration duration) {
+    Observe(std::chrono::duration<double>(duration).count());
+  }
+
+  static double UpperBound(size_t bucket);
+  uint64_t bucket(size_t k) const { return buckets_[k].load(std::memory_order_relaxed); }
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  double sum() const { return static_cast<double>(sum_ns_.load(std::memory_order_relaxed)) * 1e-9; }
+
+ private:
+  std::atomic<uint64_t> buckets_[kNumBuckets] = {};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_ns_{0};
+};
+
+class MetricsRegistry {
+ public:
+  // the returned metric lives as long as the registry, adding the same name twice returns the first one
+  Counter &AddCounter(const std::string &name, const std::string &help);
+  Gauge &AddGauge(const std::string &name, const std::string &help);
+  Histogram &AddHistogram(const std::string &name, const std::string &help);
+
+  // Prometheus text exposition format (version 0.0.4), every name prefixed with "cs_"
+  std::string Render() const;
+
+ private:
+  enum class Type { kCounter, kGauge, kHistogram };
+  struct Entry {
+    std::string name;
+    std::string help;
+    Type type;
+    size_t index;
+  };
+  size_t Find(const std::string &name, Type type) const;
+
+  mutable std::mutex mutex_;
+  std::vector<Entry> entries_;
+  std::deque<Counter> counters_;
+  std::deque<Gauge> gauges_;
+  std::deque<Histogram> histograms_;
+};
+
+// metrics of the whole process
+MetricsRegistry &Metrics();
+
+#endif // COMMON_METRICS_HPP_
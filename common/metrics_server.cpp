@@ -0,0 +1,39 @@
+#include "metrics_server.hpp"
+#include "metrics.hpp"
+
+#include <spdlog/spdlog.h>
+#include <memory>
+#include <string>
+
+MetricsServer::MetricsServer(unsigned short port)
+    : acceptor_(io_context_, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)) {
+  Accept();
+  thread_ = std::thread([this]() { io_context_.run(); });
+  spdlog::info("Metrics on http://127.0.0.1:{}/metrics", port);
+}
+
+MetricsServer::~MetricsServer() {
+  io_context_.stop();
+  if (thread_.joinable()) thread_.join();
+}
+
+void MetricsServer::Accept() {
+  auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_context_);
+  acceptor_.async_accept(*socket, [this, socket](const boost::system::error_code &error) {
+    if (error) return;
+    // the request itself does not matter, only that it is complete before the answer goes out
+    auto request = std::make_shared<boost::asio::streambuf>(4096);
+    boost::asio::async_read_until(*socket, *request, "\r\n\r\n",
+                                  [socket, request](const boost::system::error_code &, size_t) {
+      auto response = std::make_shared<std::string>(Metrics().Render());
+      response->insert(0, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+          + std::to_string(response->size()) + "\r\nConnection: close\r\n\r\n");
+      boost::asio::async_write(*socket, boost::asio::buffer(*response),
+                               [socket, response](const boost::system::error_code &, size_t) {
+        boost::system::error_code ignored;
+        socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+      });
+    });
+    Accept();
+  });
+}
@@ -0,0 +1,22 @@
+#ifndef COMMON_METRICS_SERVER_HPP_
+#define COMMON_METRICS_SERVER_HPP_
+
+#include <boost/asio.hpp>
+#include <thread>
+
+// Serves Metrics().Render() over HTTP on 127.0.0.1:port for a Prometheus scraper (or curl), any path.
+// Runs on its own thread, one request per connection.
+class MetricsServer {
+ public:
+  explicit MetricsServer(unsigned short port);
+  ~MetricsServer();
+
+ private:
+  void Accept();
+
+  boost::asio::io_context io_context_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  std::thread thread_;
+};
+
+#endif // COMMON_METRICS_SERVER_HPP_
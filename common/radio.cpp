@@ -0,0 +1,15 @@
+#include "radio.hpp"
+#include "sim_radio.hpp"
+#include "uhd_radio.hpp"
+
+#include <boost/algorithm/string.hpp>
+
+Radio::sptr MakeRadio(const std::string &args) {
+  std::vector<std::string> fields;
+  boost::split(fields, args, boost::is_any_of(","));
+  for (auto &field : fields) {
+    boost::trim(field);
+    if (field == "type=sim") return std::make_shared<SimRadio>(SimRadioOptions::Parse(args));
+  }
+  return std::make_shared<UhdRadio>(args);
+}
@@ -0,0 +1,92 @@
+#ifndef COMMON_RADIO_HPP_
+#define COMMON_RADIO_HPP_
+
+#include <uhd/stream.hpp>
+#include <uhd/types/sensors.hpp>
+#include <uhd/types/time_spec.hpp>
+#include <uhd/types/tune_request.hpp>
+#include <uhd/types/tune_result.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The radio the cores run on: the calls of uhd::usrp::multi_usrp they use, under the same names and with
+// the same defaults, so that the whole pipeline runs unchanged on a UHD device (UhdRadio) or on the
+// simulated radio (SimRadio). Samples still move through the plain UHD streamer interfaces.
+class Radio {
+ public:
+  typedef std::shared_ptr<Radio> sptr;
+  static const size_t kAllChans = static_cast<size_t>(~0);
+  static const size_t kAllMboards = static_cast<size_t>(~0);
+
+  virtual ~Radio() = default;
+
+  virtual std::string get_pp_string() = 0;
+  virtual size_t get_rx_num_channels() = 0;
+  virtual size_t get_tx_num_channels() = 0;
+
+  // clocks and time
+  virtual std::vector<std::string> get_clock_sources(size_t mboard) = 0;
+  virtual void set_clock_source(const std::string &source, size_t mboard = kAllMboards) = 0;
+  virtual void set_time_source(const std::string &source, size_t mboard = kAllMboards) = 0;
+  virtual uhd::time_spec_t get_time_now(size_t mboard = 0) = 0;
+  virtual uhd::time_spec_t get_time_last_pps(size_t mboard = 0) = 0;
+  virtual void set_time_next_pps(const uhd::time_spec_t &time_spec, size_t mboard = kAllMboards) = 0;
+  virtual void set_command_time(const uhd::time_spec_t &time_spec, size_t mboard = kAllMboards) = 0;
+  virtual void clear_command_time(size_t mboard = kAllMboards) = 0;
+
+  // sensors
+  virtual uhd::sensor_value_t get_mboard_sensor(const std::string &name, size_t mboard = 0) = 0;
+  virtual std::vector<std::string> get_mboard_sensor_names(size_t mboard = 0) = 0;
+  virtual uhd::sensor_value_t get_rx_sensor(const std::string &name, size_t chan = 0) = 0;
+  virtual std::vector<std::string> get_rx_sensor_names(size_t chan = 0) = 0;
+  virtual uhd::sensor_value_t get_tx_sensor(const std::string &name, size_t chan = 0) = 0;
+  virtual std::vector<std::string> get_tx_sensor_names(size_t chan = 0) = 0;
+
+  // front ends
+  virtual void set_rx_subdev_spec(const std::string &spec, size_t mboard = kAllMboards) = 0;
+  virtual void set_rx_rate(double rate, size_t chan = kAllChans) = 0;
+  virtual double get_rx_rate(size_t chan = 0) = 0;
+  virtual void set_tx_rate(double rate, size_t chan = kAllChans) = 0;
+  virtual double get_tx_rate(size_t chan = 0) = 0;
+  virtual uhd::tune_result_t set_rx_freq(const uhd::tune_request_t &tune_request, size_t chan = 0) = 0;
+  virtual double get_rx_freq(size_t chan = 0) = 0;
+  virtual uhd::tune_result_t set_tx_freq(const uhd::tune_request_t &tune_request, size_t chan = 0) = 0;
+  virtual double get_tx_freq(size_t chan = 0) = 0;
+  virtual void set_rx_gain(double gain, size_t chan = 0) = 0;
+  virtual double get_rx_gain(size_t chan = 0) = 0;
+  virtual void set_tx_gain(double gain, size_t chan = 0) = 0;
+  virtual double get_tx_gain(size_t chan = 0) = 0;
+  virtual void set_rx_bandwidth(double bandwidth, size_t chan = 0) = 0;
+  virtual double get_rx_bandwidth(size_t chan = 0) = 0;
+  virtual void set_tx_bandwidth(double bandwidth, size_t chan = 0) = 0;
+  virtual double get_tx_bandwidth(size_t chan = 0) = 0;
+  virtual void set_rx_antenna(const std::string &antenna, size_t chan = 0) = 0;
+  virtual std::string get_rx_antenna(size_t chan = 0) = 0;
+  virtual void set_tx_antenna(const std::string &antenna, size_t chan = 0) = 0;
+  virtual std::string get_tx_antenna(size_t chan = 0) = 0;
+  virtual void set_rx_dc_offset(bool enable, size_t chan = kAllChans) = 0;
+
+  // GPIO banks, set_command_time() applies to the writes as on the device
+  virtual void set_gpio_attr(const std::string &bank, const std::string &attr, uint32_t value,
+                             uint32_t mask = 0xffffffff, size_t mboard = 0) = 0;
+
+  // streamers
+  virtual uhd::rx_streamer::sptr get_rx_stream(const uhd::stream_args_t &args) = 0;
+  virtual uhd::tx_streamer::sptr get_tx_stream(const uhd::stream_args_t &args) = 0;
+
+  // The command time holds for every later call on the device, whichever thread makes it. Threads that issue
+  // timed commands hold this lock from set_command_time() to their last timed call.
+  std::mutex &command_mutex() { return command_mutex_; }
+
+ private:
+  std::mutex command_mutex_;
+};
+
+// "type=sim[,...]" makes a SimRadio (arguments in sim_radio.hpp), anything else opens a UHD device
+Radio::sptr MakeRadio(const std::string &args);
+
+#endif // COMMON_RADIO_HPP_
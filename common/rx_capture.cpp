@@ -0,0 +1,85 @@
+#include "rx_capture.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <uhd/exception.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+Histogram &recv_seconds = Metrics().AddHistogram("rx_recv_seconds", "duration of one rx recv() call");
+Counter &rx_overflows = Metrics().AddCounter("rx_overflows_total", "rx overflows reported by the radio");
+Counter &rx_errors = Metrics().AddCounter("rx_errors_total", "rx timeouts and other receiver errors");
+
+}  // namespace
+
+size_t ReceiveSweep(const uhd::rx_streamer::sptr &rx_stream, const CaptureLayout &layout,
+                    CaptureBuffer &buff, CaptureBuffer &scratch, double stream_time, double rate,
+                    const std::function<void(size_t)> &on_recv) {
+  const size_t total_num_samps = layout.stream_samps();
+  const size_t num_delay = layout.num_delay();
+
+  // setup streaming, the start is moved past the delay in whole samples of the sample clock
+  uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
+  stream_cmd.num_samps = total_num_samps - num_delay;
+  stream_cmd.stream_now = false;
+  stream_cmd.time_spec = uhd::time_spec_t::from_ticks(std::llround(stream_time * rate)
+                                                      + static_cast<long long>(num_delay), rate);
+  rx_stream->issue_stream_cmd(stream_cmd);
+  TraceInstant("rx stream command", stream_time, static_cast<int64_t>(stream_cmd.num_samps));
+  TraceScope trace("rx sweep", stream_time);
+
+  // meta-data will be filled in by recv()
+  uhd::rx_metadata_t md;
+  const size_t max_rx_samps = std::min(rx_stream->get_max_num_samps(), scratch.size());
+  const size_t num_channels = rx_stream->get_num_channels();
+  if (buff.num_channels() != num_channels or scratch.num_channels() != num_channels) {
+    throw std::runtime_error("Capture buffers do not have a channel per channel of the rx streamer");
+  }
+  std::vector<void *> dsts(num_channels);
+
+  // the first call to recv() will block this many seconds before receiving
+  double timeout = 0.5;
+
+  // stream positions count from stream_time, the first sample that arrives is the one after the delay
+  size_t num_acc_samps = num_delay;
+  while (num_acc_samps < total_num_samps) {
+    // pick the destination of the next samples and how many of them belong there
+    size_t capture_pos = 0, num_segment_samps;
+    const bool keep = layout.Locate(num_acc_samps, capture_pos, num_segment_samps);
+    for (size_t chan = 0; chan < num_channels; chan++) {
+      dsts[chan] = keep ? buff.at(capture_pos, chan) : scratch.at(0, chan);
+    }
+
+    // receive a single packet (or the part of it up to the segment end)
+    size_t num_rx_samps;
+    const auto recv_start = std::chrono::steady_clock::now();
+    try {
+      num_rx_samps = rx_stream->recv(dsts, std::min(max_rx_samps, num_segment_samps), md, timeout);
+    } catch (uhd::io_error &e) {
+      spdlog::error("Caught an IO exception: {}", e.what());
+      rx_errors.Add();
+      break;
+    }
+    recv_seconds.Observe(std::chrono::steady_clock::now() - recv_start);
+    // use a small timeout for subsequent packetnumber of seconds in the future to receives
+    timeout = 0.1;
+
+    // handle the error code
+    if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
+      spdlog::error("Receiver error: {}", md.strerror());
+      (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW ? rx_overflows : rx_errors).Add();
+      break;
+    }
+
+    num_acc_samps += num_rx_samps;
+    if (on_recv) on_recv(num_acc_samps);
+  }
+  trace.set_arg(static_cast<int64_t>(num_acc_samps));
+  return num_acc_samps;
+}
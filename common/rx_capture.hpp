@@ -0,0 +1,20 @@
+#ifndef COMMON_RX_CAPTURE_HPP_
+#define COMMON_RX_CAPTURE_HPP_
+
+#include "capture_buffer.hpp"
+
+#include <uhd/stream.hpp>
+#include <functional>
+
+// Receives one sweep described by layout, starting at stream_time.
+// The delay is skipped on the device: the stream starts num_delay samples (at rate) after stream_time, so the
+// delay samples are never sent to the host. Guard samples are received into scratch (at least max_num_samps
+// of the streamer) and dropped, the kept part of slot k lands in buff at layout.offset(k). buff and scratch
+// have a channel per channel of the streamer, recv() writes every channel straight into its own plane.
+// on_recv gets the number of stream samples received so far (the delay included) after every recv() call.
+// Returns the number of stream samples received, the delay included, layout.stream_samps() on success.
+size_t ReceiveSweep(const uhd::rx_streamer::sptr &rx_stream, const CaptureLayout &layout,
+                    CaptureBuffer &buff, CaptureBuffer &scratch, double stream_time, double rate,
+                    const std::function<void(size_t)> &on_recv = nullptr);
+
+#endif // COMMON_RX_CAPTURE_HPP_
@@ -0,0 +1,173 @@
+#include "rx_ring.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <uhd/exception.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// same metrics as the one shot receive in rx_capture.cpp
+Histogram &recv_seconds = Metrics().AddHistogram("rx_recv_seconds", "duration of one rx recv() call");
+Counter &rx_overflows = Metrics().AddCounter("rx_overflows_total", "rx overflows reported by the radio");
+Counter &rx_errors = Metrics().AddCounter("rx_errors_total", "rx timeouts and other receiver errors");
+Counter &ring_lost = Metrics().AddCounter("rx_ring_lost_total",
+                                          "sweeps that could not be cut out of the ring (lost, overwritten, late)");
+
+}  // namespace
+
+RxRing::RxRing(const uhd::rx_streamer::sptr &rx_stream, SampleFormat format, size_t capacity, double rate)
+    : rx_stream_(rx_stream), ring_(format, capacity, rx_stream->get_num_channels()), rate_(rate),
+      max_rx_samps_(rx_stream->get_max_num_samps()), dsts_(ring_.num_channels()) {}
+
+RxRing::~RxRing() {
+  Stop();
+}
+
+void RxRing::Start(double start_time) {
+  if (running_) return;
+  running_ = true;
+  thread_ = std::thread([this, start_time]() { ReceiveWorker(start_time); });
+}
+
+void RxRing::Stop() {
+  running_ = false;
+  if (thread_.joinable()) thread_.join();
+}
+
+uint64_t RxRing::TimeToTick(double time) const {
+  return static_cast<uint64_t>(std::llround(time * rate_));
+}
+
+void RxRing::ReceiveWorker(double start_time) {
+  TraceThreadName("rx ring");
+  uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+  stream_cmd.stream_now = false;
+  stream_cmd.time_spec = uhd::time_spec_t(start_time);
+  rx_stream_->issue_stream_cmd(stream_cmd);
+  spdlog::info("Begin continuous streaming into a {} sample ring at {}", ring_.size(), start_time);
+
+  uhd::rx_metadata_t md;
+  bool synced = false;
+  uint64_t next_tick = 0;
+  // the first packet arrives at start_time, which is at most a few hundred ms ahead
+  double timeout = 3.0;
+  while (running_) {
+    const auto pos = static_cast<size_t>(next_tick % ring_.size());
+    for (size_t chan = 0; chan < dsts_.size(); chan++) dsts_[chan] = ring_.at(pos, chan);
+    size_t num_rx_samps;
+    const auto recv_start = std::chrono::steady_clock::now();
+    try {
+      num_rx_samps = rx_stream_->recv(dsts_, std::min(max_rx_samps_, ring_.size() - pos), md, timeout);
+    } catch (uhd::io_error &e) {
+      spdlog::error("Caught an IO exception: {}", e.what());
+      rx_errors.Add();
+      synced = false;
+      continue;
+    }
+    recv_seconds.Observe(std::chrono::steady_clock::now() - recv_start);
+    timeout = 0.1;
+
+    if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
+      continue;
+    } else if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
+      // streaming goes on after an overflow, but samples are missing
+      num_overflows_++;
+      rx_overflows.Add();
+      TraceInstant("rx overflow");
+      synced = false;
+      continue;
+    } else if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
+      spdlog::error("Receiver error: {}", md.strerror());
+      rx_errors.Add();
+      synced = false;
+      continue;
+    }
+    if (num_rx_samps == 0) continue;
+
+    const auto tick = static_cast<uint64_t>(md.time_spec.to_ticks(rate_));
+    if (!synced or tick != next_tick) {
+      // the packet was written where the expected tick goes, drop it and restart the valid range after it
+      next_tick = tick + num_rx_samps;
+      valid_tick_.store(next_tick, std::memory_order_release);
+      write_tick_.store(next_tick, std::memory_order_release);
+      synced = true;
+      continue;
+    }
+    next_tick += num_rx_samps;
+    write_tick_.store(next_tick, std::memory_order_release);
+  }
+
+  stream_cmd.stream_mode = uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS;
+  stream_cmd.stream_now = true;
+  rx_stream_->issue_stream_cmd(stream_cmd);
+  // drain what is left in flight so the next stream command starts clean
+  for (size_t chan = 0; chan < dsts_.size(); chan++) dsts_[chan] = ring_.at(0, chan);
+  while (rx_stream_->recv(dsts_, max_rx_samps_, md, 0.1) > 0) {}
+  spdlog::info("Continuous streaming stopped, {} overflows", num_overflows());
+}
+
+size_t RxRing::Extract(uint64_t first_tick, const CaptureLayout &layout, CaptureBuffer &buff, double timeout,
+                       const std::function<void(size_t)> &on_copy) {
+  const size_t total_num_samps = layout.stream_samps();
+  if (total_num_samps > ring_.size()) {
+    spdlog::error("Sweep of {} samples does not fit the {} sample ring", total_num_samps, ring_.size());
+    return 0;
+  }
+  if (buff.num_channels() != ring_.num_channels()) {
+    spdlog::error("Capture buffer has {} channels, the ring {}", buff.num_channels(), ring_.num_channels());
+    return 0;
+  }
+  TraceScope trace("rx extract", static_cast<double>(first_tick) / rate_);
+  const auto deadline = std::chrono::steady_clock::now()
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+
+  // the delay is neither waited for nor copied
+  size_t num_copied_samps = layout.num_delay();
+  while (num_copied_samps < total_num_samps) {
+    const uint64_t tick = first_tick + num_copied_samps;
+    const uint64_t write_tick = write_tick_.load(std::memory_order_acquire);
+    if (tick < valid_tick_.load(std::memory_order_acquire) or write_tick + max_rx_samps_ > tick + ring_.size()) {
+      spdlog::error("Samples at tick {} were lost", tick);
+      break;
+    }
+    if (write_tick <= tick) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        spdlog::error("Timed out waiting for tick {}", tick);
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      continue;
+    }
+
+    size_t num_avail_samps = std::min<size_t>(static_cast<size_t>(write_tick - tick),
+                                              total_num_samps - num_copied_samps);
+    const size_t num_chunk_samps = num_avail_samps;
+    while (num_avail_samps > 0) {
+      size_t capture_pos = 0, num_segment_samps;
+      bool keep = layout.Locate(num_copied_samps, capture_pos, num_segment_samps);
+      // do not run over the end of the ring
+      const auto ring_pos = static_cast<size_t>((first_tick + num_copied_samps) % ring_.size());
+      num_segment_samps = std::min(std::min(num_segment_samps, num_avail_samps), ring_.size() - ring_pos);
+      for (size_t chan = 0; keep and chan < ring_.num_channels(); chan++) {
+        std::memcpy(buff.at(capture_pos, chan), ring_.at(ring_pos, chan), ring_.bytes(num_segment_samps));
+      }
+      num_copied_samps += num_segment_samps;
+      num_avail_samps -= num_segment_samps;
+    }
+    // the writer may have lapped the chunk while it was copied, a recv() in progress covers up to max_rx_samps_ more
+    if (write_tick_.load(std::memory_order_acquire) + max_rx_samps_ > tick + ring_.size()) {
+      spdlog::error("Samples at tick {} were overwritten while copying", tick);
+      num_copied_samps -= num_chunk_samps;
+      break;
+    }
+    if (on_copy) on_copy(num_copied_samps);
+  }
+  if (num_copied_samps < total_num_samps) ring_lost.Add();
+  trace.set_arg(static_cast<int64_t>(num_copied_samps));
+  return num_copied_samps;
+}
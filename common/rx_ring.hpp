@@ -0,0 +1,51 @@
+#ifndef COMMON_RX_RING_HPP_
+#define COMMON_RX_RING_HPP_
+
+#include "capture_buffer.hpp"
+
+#include <uhd/stream.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Continuous RX into a ring buffer indexed by device time (sample ticks since time 0).
+// The stream is started once, snapshots are cut out of the ring by their start time
+// instead of issuing a stream command per snapshot. The ring has a plane per channel of the streamer.
+class RxRing {
+ public:
+  RxRing(const uhd::rx_streamer::sptr &rx_stream, SampleFormat format, size_t capacity, double rate);
+  ~RxRing();
+
+  // starts continuous streaming at start_time (device time) on a background thread
+  void Start(double start_time);
+  void Stop();
+
+  // Copies the sweep starting at first_tick into buff (every channel) according to layout, waiting for
+  // samples that have not arrived yet. on_copy gets the number of stream samples copied so far.
+  // Returns the number of stream samples copied, layout.stream_samps() on success, less if the samples
+  // were lost (overflow, overwritten) or did not arrive within timeout seconds.
+  size_t Extract(uint64_t first_tick, const CaptureLayout &layout, CaptureBuffer &buff, double timeout,
+                 const std::function<void(size_t)> &on_copy = nullptr);
+
+  uint64_t TimeToTick(double time) const;
+  size_t capacity() const { return ring_.size(); }
+  size_t num_overflows() const { return num_overflows_.load(std::memory_order_relaxed); }
+
+ private:
+  void ReceiveWorker(double start_time);
+
+  uhd::rx_streamer::sptr rx_stream_;
+  CaptureBuffer ring_;
+  double rate_;
+  size_t max_rx_samps_;
+  std::vector<void *> dsts_;  // recv() destinations, one per channel
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> write_tick_{0};  // tick of the next sample to be written
+  std::atomic<uint64_t> valid_tick_{0};  // first tick after the last discontinuity
+  std::atomic<size_t> num_overflows_{0};
+};
+
+#endif // COMMON_RX_RING_HPP_
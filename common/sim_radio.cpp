@@ -0,0 +1,702 @@
+#include "sim_radio.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const size_t kMaxNumSamps = 2000;  // samples per packet, about what a 10 GbE link carries
+const size_t kNoiseTableSize = 1 << 16;
+const double kTxBuffer = 0.05;  // seconds of samples the device takes ahead of its clock
+const double kAirKept = 1.0;  // seconds transmitted samples and GPIO writes are kept for the rx side
+
+enum class CpuFormat { kFc32, kSc16 };
+
+CpuFormat ParseCpuFormat(const std::string &format) {
+  if (format == "fc32") return CpuFormat::kFc32;
+  if (format == "sc16") return CpuFormat::kSc16;
+  throw std::runtime_error("Simulated radio streams fc32 or sc16, not " + format);
+}
+
+std::vector<size_t> StreamChannels(const uhd::stream_args_t &args, size_t num_channels) {
+  std::vector<size_t> channels = args.channels.empty() ? std::vector<size_t>{0} : args.channels;
+  for (size_t chan : channels) {
+    if (chan >= num_channels) throw std::runtime_error("Simulated radio has no channel " + std::to_string(chan));
+  }
+  return channels;
+}
+
+std::vector<std::complex<float>> ReadSource(const std::string &path) {
+  std::ifstream file(path, std::ifstream::binary);
+  if (!file) throw std::runtime_error("Could not open " + path);
+  file.seekg(0, std::ifstream::end);
+  std::vector<std::complex<float>> samps(static_cast<size_t>(file.tellg()) / sizeof(std::complex<float>));
+  file.seekg(0, std::ifstream::beg);
+  file.read(reinterpret_cast<char *>(samps.data()), static_cast<std::streamsize>(samps.size() * sizeof(samps[0])));
+  return samps;
+}
+
+std::chrono::steady_clock::duration Seconds(double seconds) {
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(std::max(seconds, 0.0)));
+}
+
+std::complex<float> Rotation(double degrees) {
+  return std::polar(1.0f, static_cast<float>(degrees * kPi / 180));
+}
+
+}  // namespace
+
+SimRadioOptions SimRadioOptions::Parse(const std::string &args) {
+  SimRadioOptions options;
+  std::vector<std::string> fields;
+  boost::split(fields, args, boost::is_any_of(","));
+  for (auto &field : fields) {
+    boost::trim(field);
+    const size_t equal = field.find('=');
+    if (equal == std::string::npos) continue;
+    const std::string key = field.substr(0, equal), value = field.substr(equal + 1);
+    if (key == "sim_paths") {
+      options.paths.clear();
+      std::vector<std::string> taps;
+      boost::split(taps, value, boost::is_any_of("/"));
+      for (const auto &tap : taps) {
+        std::vector<std::string> parts;
+        boost::split(parts, tap, boost::is_any_of(":"));
+        if (parts.size() < 2 or parts.size() > 3) throw std::runtime_error("Invalid sim_paths tap: " + tap);
+        const double phase = parts.size() == 3 ? std::stod(parts[2]) : 0;
+        options.paths.push_back({std::stoul(parts[0]), static_cast<float>(std::pow(10, std::stod(parts[1]) / 20))
+            * Rotation(phase)});
+      }
+    } else if (key == "sim_port_phase") {
+      options.port_phase = std::stod(value);
+    } else if (key == "sim_chan_phase") {
+      options.chan_phase = std::stod(value);
+    } else if (key == "sim_noise") {
+      options.noise_dbfs = std::stod(value);
+    } else if (key == "sim_channels") {
+      options.num_channels = std::max<size_t>(std::stoul(value), 1);
+    } else if (key == "sim_source") {
+      options.source = ReadSource(value);
+    } else if (key == "sim_source_period") {
+      options.source_period = std::stod(value);
+    } else if (key == "sim_overflow") {
+      options.overflow_period = std::stod(value);
+    } else if (key == "sim_rx_buffer") {
+      options.rx_buffer = std::stod(value);
+    } else if (key == "sim_paced") {
+      options.paced = value != "0";
+    } else if (key == "sim_master_clock") {
+      options.master_clock = std::stod(value);
+    } else if (key.compare(0, 4, "sim_") == 0) {
+      throw std::runtime_error("Unknown simulated radio argument: " + key);
+    }
+  }
+  if (options.paths.empty()) throw std::runtime_error("The simulated channel needs a path");
+  return options;
+}
+
+// Streams what SimRadio::OnAir() has at the antenna, paced by the device clock.
+class SimRxStreamer : public uhd::rx_streamer {
+ public:
+  SimRxStreamer(const std::shared_ptr<SimRadio> &radio, const uhd::stream_args_t &args)
+      : radio_(radio), format_(ParseCpuFormat(args.cpu_format)),
+        channels_(StreamChannels(args, radio->options_.num_channels)),
+        seen_overflow_requests_(radio->overflow_requests_.load()) {
+    for (const auto &path : radio_->options_.paths) max_delay_ = std::max(max_delay_, path.delay);
+  }
+
+  size_t get_num_channels() const override { return channels_.size(); }
+  size_t get_max_num_samps() const override { return kMaxNumSamps; }
+
+  void issue_stream_cmd(const uhd::stream_cmd_t &stream_cmd) override {
+    const int64_t now_tick = radio_->TickNow();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stream_cmd.stream_mode == uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS) {
+      streaming_ = false;
+    } else {
+      const double rate = radio_->rate();
+      next_tick_ = stream_cmd.stream_now ? now_tick : stream_cmd.time_spec.to_ticks(rate);
+      continuous_ = stream_cmd.stream_mode == uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS;
+      remaining_ = continuous_ ? SIZE_MAX : static_cast<size_t>(stream_cmd.num_samps);
+      late_ = next_tick_ < now_tick;
+      streaming_ = !late_ and remaining_ > 0;
+      start_of_burst_ = true;
+      const auto overflow_ticks = static_cast<int64_t>(std::llround(radio_->options_.overflow_period * rate));
+      next_overflow_tick_ = overflow_ticks > 0 ? next_tick_ + overflow_ticks : INT64_MAX;
+    }
+    changed_.notify_all();
+  }
+
+  size_t recv(const buffs_type &buffs, const size_t nsamps_per_buff, uhd::rx_metadata_t &md,
+              const double timeout, const bool one_packet) override {
+    md.has_time_spec = false;
+    md.start_of_burst = false;
+    md.end_of_burst = false;
+    md.more_fragments = false;
+    md.fragment_offset = 0;
+    md.out_of_sequence = false;
+    md.error_code = uhd::rx_metadata_t::ERROR_CODE_NONE;
+    const auto deadline = std::chrono::steady_clock::now() + Seconds(timeout);
+    const double rate = radio_->rate();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t num_done = 0;
+    while (num_done < nsamps_per_buff) {
+      if (late_) {
+        late_ = false;
+        md.error_code = uhd::rx_metadata_t::ERROR_CODE_LATE_COMMAND;
+        break;
+      }
+      if (!streaming_) {
+        // like a device, an idle streamer lets the call wait out its timeout
+        if (num_done > 0) break;
+        if (!changed_.wait_until(lock, deadline, [this]() { return streaming_ or late_; })) {
+          md.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+          break;
+        }
+        continue;
+      }
+
+      const size_t n = std::min({kMaxNumSamps, nsamps_per_buff - num_done, remaining_});
+      const int64_t end_tick = next_tick_ + static_cast<int64_t>(n);
+      const int64_t now_tick = radio_->TickNow();
+      // an overflow is reported on its own, at the start of a call
+      if (num_done == 0 and Overflow(now_tick, rate)) {
+        md.error_code = uhd::rx_metadata_t::ERROR_CODE_OVERFLOW;
+        break;
+      }
+      if (radio_->options_.paced and now_tick < end_tick) {
+        // the samples are there once the device clock has passed them
+        const auto ready = std::chrono::steady_clock::now()
+            + Seconds(static_cast<double>(end_tick - now_tick) / rate);
+        if (ready > deadline) {
+          if (num_done > 0) break;
+          changed_.wait_until(lock, deadline);
+          md.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+          break;
+        }
+        changed_.wait_until(lock, ready);
+        continue;
+      }
+
+      for (size_t k = 0; k < channels_.size(); k++) Generate(channels_[k], n, buffs[k], num_done);
+      if (num_done == 0) {
+        md.has_time_spec = true;
+        md.time_spec = uhd::time_spec_t::from_ticks(next_tick_, rate);
+        md.start_of_burst = start_of_burst_;
+      }
+      start_of_burst_ = false;
+      next_tick_ = end_tick;
+      num_done += n;
+      if (!continuous_) {
+        remaining_ -= n;
+        if (remaining_ == 0) {
+          streaming_ = false;
+          md.end_of_burst = true;
+          break;
+        }
+      }
+      if (one_packet) break;
+    }
+    return num_done;
+  }
+
+ private:
+  // checks for an overflow before the packet at next_tick_, true if one is reported now
+  bool Overflow(int64_t now_tick, double rate) {
+    const size_t requests = radio_->overflow_requests_.load();
+    const bool requested = requests != seen_overflow_requests_;
+    const bool periodic = next_tick_ >= next_overflow_tick_;
+    const bool behind = radio_->options_.paced
+        and now_tick - next_tick_ > static_cast<int64_t>(radio_->options_.rx_buffer * rate);
+    if (!requested and !periodic and !behind) return false;
+    seen_overflow_requests_ = requests;
+    if (periodic) {
+      next_overflow_tick_ += static_cast<int64_t>(std::llround(radio_->options_.overflow_period * rate));
+    }
+    radio_->num_overflows_++;
+    // the samples in the full buffer are lost, a finite burst ends
+    next_tick_ = std::max(next_tick_ + static_cast<int64_t>(kMaxNumSamps), now_tick);
+    if (!continuous_) streaming_ = false;
+    return true;
+  }
+
+  void Generate(size_t chan, size_t n, void *buff, size_t offset) {
+    const SimRadioOptions &options = radio_->options_;
+    air_.resize(n + max_delay_);
+    radio_->OnAir(next_tick_ - static_cast<int64_t>(max_delay_), air_.size(), air_.data());
+    out_.resize(n);
+
+    // noise from a random place in the table, wrapping around
+    noise_pos_ = noise_pos_ * 6364136223846793005ULL + 1442695040888963407ULL;
+    size_t noise_index = static_cast<size_t>(noise_pos_ >> 33) % kNoiseTableSize;
+    const auto &noise = radio_->noise_;
+
+    for (size_t i = 0; i < n;) {
+      // one stretch per GPIO state
+      int64_t next_change;
+      const int port = radio_->PortAt(next_tick_ + static_cast<int64_t>(i), next_change);
+      const size_t end = static_cast<size_t>(std::min<int64_t>(next_change - next_tick_, static_cast<int64_t>(n)));
+      if (port < 0) {
+        for (; i < end; i++, noise_index = (noise_index + 1) % kNoiseTableSize) out_[i] = noise[noise_index];
+        continue;
+      }
+      const std::complex<float> rotation = Rotation(port * options.port_phase + chan * options.chan_phase);
+      taps_.clear();
+      for (const auto &path : options.paths) taps_.push_back(path.gain * rotation);
+      for (; i < end; i++, noise_index = (noise_index + 1) % kNoiseTableSize) {
+        std::complex<float> acc = noise[noise_index];
+        for (size_t k = 0; k < taps_.size(); k++) acc += taps_[k] * air_[i + max_delay_ - options.paths[k].delay];
+        out_[i] = acc;
+      }
+    }
+
+    if (format_ == CpuFormat::kFc32) {
+      std::copy(out_.begin(), out_.end(), static_cast<std::complex<float> *>(buff) + offset);
+    } else {
+      auto *dst = static_cast<std::complex<int16_t> *>(buff) + offset;
+      for (size_t i = 0; i < n; i++) {
+        const float re = std::max(-1.0f, std::min(1.0f, out_[i].real()));
+        const float im = std::max(-1.0f, std::min(1.0f, out_[i].imag()));
+        dst[i] = {static_cast<int16_t>(std::lround(re * 32767)), static_cast<int16_t>(std::lround(im * 32767))};
+      }
+    }
+  }
+
+  std::shared_ptr<SimRadio> radio_;
+  const CpuFormat format_;
+  const std::vector<size_t> channels_;
+  size_t max_delay_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool streaming_ = false;
+  bool continuous_ = false;
+  bool late_ = false;
+  bool start_of_burst_ = false;
+  int64_t next_tick_ = 0;
+  size_t remaining_ = 0;
+  int64_t next_overflow_tick_ = INT64_MAX;
+  size_t seen_overflow_requests_;
+
+  uint64_t noise_pos_ = 1;
+  std::vector<std::complex<float>> air_, out_, taps_;
+};
+
+// Puts channel 0 on air through SimRadio::Transmit() and reports on the bursts like a device.
+class SimTxStreamer : public uhd::tx_streamer {
+ public:
+  SimTxStreamer(const std::shared_ptr<SimRadio> &radio, const uhd::stream_args_t &args)
+      : radio_(radio), format_(ParseCpuFormat(args.cpu_format)),
+        channels_(StreamChannels(args, radio->options_.num_channels)) {}
+
+  size_t get_num_channels() const override { return channels_.size(); }
+  size_t get_max_num_samps() const override { return kMaxNumSamps; }
+
+  size_t send(const buffs_type &buffs, const size_t nsamps_per_buff, const uhd::tx_metadata_t &metadata,
+              const double timeout) override {
+    const double rate = radio_->rate();
+    int64_t now_tick = radio_->TickNow();
+    if (metadata.has_time_spec) {
+      cursor_ = metadata.time_spec.to_ticks(rate);
+      in_burst_ = true;
+      dropping_ = cursor_ < now_tick;
+      if (dropping_) Post(uhd::async_metadata_t::EVENT_CODE_TIME_ERROR, now_tick, rate);
+    } else if (!in_burst_) {
+      cursor_ = now_tick;
+      in_burst_ = true;
+      dropping_ = false;
+    } else if (!dropping_ and cursor_ < now_tick and nsamps_per_buff > 0) {
+      // the device ran out of samples in the middle of the burst
+      Post(uhd::async_metadata_t::EVENT_CODE_UNDERFLOW, now_tick, rate);
+      cursor_ = now_tick;
+    }
+
+    if (!dropping_ and nsamps_per_buff > 0) {
+      // the device buffer takes kTxBuffer seconds ahead of its clock, send() waits for room beyond that
+      const auto deadline = std::chrono::steady_clock::now() + Seconds(timeout);
+      const auto buffer_ticks = static_cast<int64_t>(kTxBuffer * rate);
+      while (radio_->options_.paced and cursor_ - now_tick > buffer_ticks) {
+        const auto room = std::chrono::steady_clock::now()
+            + Seconds(static_cast<double>(cursor_ - now_tick - buffer_ticks) / rate);
+        if (room > deadline) {
+          std::this_thread::sleep_until(deadline);
+          return 0;
+        }
+        std::this_thread::sleep_until(room);
+        now_tick = radio_->TickNow();
+      }
+      std::vector<std::complex<float>> samps(nsamps_per_buff);
+      if (format_ == CpuFormat::kFc32) {
+        const auto *src = static_cast<const std::complex<float> *>(buffs[0]);
+        std::copy(src, src + nsamps_per_buff, samps.begin());
+      } else {
+        const auto *src = static_cast<const std::complex<int16_t> *>(buffs[0]);
+        for (size_t i = 0; i < nsamps_per_buff; i++) {
+          samps[i] = {static_cast<float>(src[i].real()) / 32767, static_cast<float>(src[i].imag()) / 32767};
+        }
+      }
+      radio_->Transmit(cursor_, std::move(samps));
+      cursor_ += static_cast<int64_t>(nsamps_per_buff);
+    }
+
+    if (metadata.end_of_burst) {
+      // a burst dropped as late is not acknowledged
+      if (!dropping_) Post(uhd::async_metadata_t::EVENT_CODE_BURST_ACK, cursor_, rate);
+      in_burst_ = false;
+      dropping_ = false;
+    }
+    return nsamps_per_buff;
+  }
+
+  bool recv_async_msg(uhd::async_metadata_t &async_metadata, double timeout) override {
+    const auto deadline = std::chrono::steady_clock::now() + Seconds(timeout);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      if (!messages_.empty()) {
+        // an event is reported once the device clock has reached it
+        const double wait = static_cast<double>(messages_.front().tick - radio_->TickNow()) / messages_.front().rate;
+        if (wait <= 0 or !radio_->options_.paced) {
+          const Message &message = messages_.front();
+          async_metadata.channel = 0;
+          async_metadata.has_time_spec = true;
+          async_metadata.time_spec = uhd::time_spec_t::from_ticks(message.tick, message.rate);
+          async_metadata.event_code = message.event_code;
+          messages_.pop_front();
+          return true;
+        }
+        const auto due = std::chrono::steady_clock::now() + Seconds(wait);
+        if (due > deadline) return false;
+        posted_.wait_until(lock, due);
+      } else if (posted_.wait_until(lock, deadline) == std::cv_status::timeout and messages_.empty()) {
+        return false;
+      }
+    }
+  }
+
+ private:
+  struct Message {
+    uhd::async_metadata_t::event_code_t event_code;
+    int64_t tick;
+    double rate;
+  };
+
+  void Post(uhd::async_metadata_t::event_code_t event_code, int64_t tick, double rate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    messages_.push_back({event_code, tick, rate});
+    posted_.notify_all();
+  }
+
+  std::shared_ptr<SimRadio> radio_;
+  const CpuFormat format_;
+  const std::vector<size_t> channels_;
+
+  // only the sending thread touches these
+  int64_t cursor_ = 0;
+  bool in_burst_ = false;
+  bool dropping_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable posted_;
+  std::deque<Message> messages_;
+};
+
+SimRadio::SimRadio(const SimRadioOptions &options)
+    : options_(options), epoch_(std::chrono::steady_clock::now()), noise_(kNoiseTableSize) {
+  std::mt19937 generator(1);
+  std::normal_distribution<float> normal(0, static_cast<float>(std::sqrt(std::pow(10, options_.noise_dbfs / 10) / 2)));
+  for (auto &sample : noise_) sample = {normal(generator), normal(generator)};
+}
+
+void SimRadio::InjectOverflow() {
+  overflow_requests_++;
+}
+
+std::string SimRadio::get_pp_string() {
+  return "Simulated radio: " + std::to_string(options_.paths.size()) + " paths, noise "
+      + std::to_string(options_.noise_dbfs) + " dBFS, " + std::to_string(options_.num_channels) + " channels";
+}
+
+double SimRadio::rate() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rate_;
+}
+
+double SimRadio::DeviceTimeLocked() {
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch_).count();
+  if (pps_pending_ and elapsed >= pps_edge_) {
+    time_offset_ = pps_time_ - pps_edge_;
+    pps_pending_ = false;
+  }
+  return elapsed + time_offset_;
+}
+
+double SimRadio::DeviceTime() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return DeviceTimeLocked();
+}
+
+int64_t SimRadio::TickNow() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int64_t>(std::llround(DeviceTimeLocked() * rate_));
+}
+
+std::vector<std::string> SimRadio::get_clock_sources(size_t) {
+  return {"internal", "external", "gpsdo"};
+}
+
+void SimRadio::set_clock_source(const std::string &, size_t) {}
+
+void SimRadio::set_time_source(const std::string &, size_t) {}
+
+uhd::time_spec_t SimRadio::get_time_now(size_t) {
+  return uhd::time_spec_t(DeviceTime());
+}
+
+uhd::time_spec_t SimRadio::get_time_last_pps(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const double device_time = DeviceTimeLocked();
+  return uhd::time_spec_t(device_time - (device_time - time_offset_ - std::floor(device_time - time_offset_)));
+}
+
+void SimRadio::set_time_next_pps(const uhd::time_spec_t &time_spec, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const double device_time = DeviceTimeLocked();
+  pps_edge_ = std::floor(device_time - time_offset_) + 1;
+  pps_time_ = time_spec.get_real_secs();
+  pps_pending_ = true;
+}
+
+void SimRadio::set_command_time(const uhd::time_spec_t &time_spec, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  has_command_time_ = true;
+  command_time_ = time_spec.get_real_secs();
+}
+
+void SimRadio::clear_command_time(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  has_command_time_ = false;
+}
+
+uhd::sensor_value_t SimRadio::get_mboard_sensor(const std::string &name, size_t) {
+  return uhd::sensor_value_t(name, true, "locked", "unlocked");
+}
+
+std::vector<std::string> SimRadio::get_mboard_sensor_names(size_t) {
+  return {"ref_locked", "gps_locked"};
+}
+
+uhd::sensor_value_t SimRadio::get_rx_sensor(const std::string &name, size_t) {
+  return uhd::sensor_value_t(name, true, "locked", "unlocked");
+}
+
+std::vector<std::string> SimRadio::get_rx_sensor_names(size_t) {
+  return {"lo_locked"};
+}
+
+uhd::sensor_value_t SimRadio::get_tx_sensor(const std::string &name, size_t) {
+  return uhd::sensor_value_t(name, true, "locked", "unlocked");
+}
+
+std::vector<std::string> SimRadio::get_tx_sensor_names(size_t) {
+  return {"lo_locked"};
+}
+
+void SimRadio::set_rx_rate(double rate, size_t) {
+  if (rate <= 0) throw std::runtime_error("Invalid sample rate");
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (options_.master_clock > 0) {
+    const double decimation = std::max(std::round(options_.master_clock / rate), 1.0);
+    rate_ = options_.master_clock / decimation;
+  } else {
+    rate_ = rate;
+  }
+}
+
+double SimRadio::get_rx_rate(size_t) {
+  return rate();
+}
+
+void SimRadio::set_tx_rate(double rate, size_t chan) {
+  set_rx_rate(rate, chan);
+}
+
+double SimRadio::get_tx_rate(size_t) {
+  return rate();
+}
+
+uhd::tune_result_t SimRadio::set_rx_freq(const uhd::tune_request_t &tune_request, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rx_.freq = tune_request.target_freq;
+  uhd::tune_result_t result;
+  result.clipped_rf_freq = result.target_rf_freq = result.actual_rf_freq = rx_.freq;
+  return result;
+}
+
+double SimRadio::get_rx_freq(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rx_.freq;
+}
+
+uhd::tune_result_t SimRadio::set_tx_freq(const uhd::tune_request_t &tune_request, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tx_.freq = tune_request.target_freq;
+  uhd::tune_result_t result;
+  result.clipped_rf_freq = result.target_rf_freq = result.actual_rf_freq = tx_.freq;
+  return result;
+}
+
+double SimRadio::get_tx_freq(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tx_.freq;
+}
+
+void SimRadio::set_rx_gain(double gain, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rx_.gain = gain;
+}
+
+double SimRadio::get_rx_gain(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rx_.gain;
+}
+
+void SimRadio::set_tx_gain(double gain, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tx_.gain = gain;
+}
+
+double SimRadio::get_tx_gain(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tx_.gain;
+}
+
+void SimRadio::set_rx_bandwidth(double bandwidth, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rx_.bandwidth = bandwidth;
+}
+
+double SimRadio::get_rx_bandwidth(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rx_.bandwidth > 0 ? rx_.bandwidth : rate_;
+}
+
+void SimRadio::set_tx_bandwidth(double bandwidth, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tx_.bandwidth = bandwidth;
+}
+
+double SimRadio::get_tx_bandwidth(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tx_.bandwidth > 0 ? tx_.bandwidth : rate_;
+}
+
+void SimRadio::set_rx_antenna(const std::string &antenna, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rx_.antenna = antenna;
+}
+
+std::string SimRadio::get_rx_antenna(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rx_.antenna;
+}
+
+void SimRadio::set_tx_antenna(const std::string &antenna, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tx_.antenna = antenna;
+}
+
+std::string SimRadio::get_tx_antenna(size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tx_.antenna;
+}
+
+void SimRadio::set_gpio_attr(const std::string &, const std::string &attr, uint32_t value, uint32_t mask, size_t) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (attr == "DDR") {
+    gpio_ddr_ = (gpio_ddr_ & ~mask) | (value & mask);
+    return;
+  }
+  // only the output register moves the switches, CTRL and the ATR registers are left to the device
+  if (attr != "OUT") return;
+
+  const int64_t now_tick = static_cast<int64_t>(std::llround(DeviceTimeLocked() * rate_));
+  const int64_t tick = has_command_time_ ? static_cast<int64_t>(std::llround(command_time_ * rate_)) : now_tick;
+  auto next = gpio_writes_.upper_bound(tick);
+  const uint32_t before = next == gpio_writes_.begin() ? gpio_out_ : std::prev(next)->second;
+  gpio_writes_[tick] = (before & ~mask) | (value & mask);
+
+  // writes older than the rx side can still ask for fold into the base output
+  const auto oldest_tick = now_tick - static_cast<int64_t>(kAirKept * rate_);
+  while (gpio_writes_.size() > 1 and std::next(gpio_writes_.begin())->first <= oldest_tick) {
+    gpio_out_ = gpio_writes_.begin()->second;
+    gpio_writes_.erase(gpio_writes_.begin());
+  }
+}
+
+int SimRadio::PortAt(int64_t tick, int64_t &next_change) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto next = gpio_writes_.upper_bound(tick);
+  next_change = next == gpio_writes_.end() ? INT64_MAX : next->first;
+  const uint32_t out = next == gpio_writes_.begin() ? gpio_out_ : std::prev(next)->second;
+  const uint32_t selected = ~out & gpio_ddr_;
+  if (selected == 0) return -1;
+  int port = 0;
+  while (((selected >> port) & 1u) == 0) port++;
+  return port;
+}
+
+void SimRadio::OnAir(int64_t first_tick, size_t num_samps, std::complex<float> *out) {
+  std::fill(out, out + num_samps, std::complex<float>());
+  const int64_t end_tick = first_tick + static_cast<int64_t>(num_samps);
+
+  // the far end sends the source waveform at every period from time 0
+  const std::vector<std::complex<float>> &source = options_.source;
+  const double rate = this->rate();
+  const auto period_ticks = static_cast<int64_t>(std::llround(options_.source_period * rate));
+  if (!source.empty() and period_ticks > 0) {
+    for (int64_t tick = std::max<int64_t>(first_tick, 0); tick < end_tick; tick++) {
+      const auto index = static_cast<size_t>(tick % period_ticks);
+      if (index < source.size()) out[tick - first_tick] += source[index];
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto chunk = air_.upper_bound(first_tick);
+  if (chunk != air_.begin()) --chunk;
+  for (; chunk != air_.end() and chunk->first < end_tick; ++chunk) {
+    const int64_t chunk_end = chunk->first + static_cast<int64_t>(chunk->second.size());
+    for (int64_t tick = std::max(first_tick, chunk->first); tick < std::min(end_tick, chunk_end); tick++) {
+      out[tick - first_tick] += chunk->second[static_cast<size_t>(tick - chunk->first)];
+    }
+  }
+}
+
+void SimRadio::Transmit(int64_t tick, std::vector<std::complex<float>> samps) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  air_[tick] = std::move(samps);
+  const auto oldest_tick = static_cast<int64_t>(std::llround(DeviceTimeLocked() * rate_))
+      - static_cast<int64_t>(kAirKept * rate_);
+  while (!air_.empty()
+      and air_.begin()->first + static_cast<int64_t>(air_.begin()->second.size()) < oldest_tick) {
+    air_.erase(air_.begin());
+  }
+}
+
+uhd::rx_streamer::sptr SimRadio::get_rx_stream(const uhd::stream_args_t &args) {
+  return std::make_shared<SimRxStreamer>(shared_from_this(), args);
+}
+
+uhd::tx_streamer::sptr SimRadio::get_tx_stream(const uhd::stream_args_t &args) {
+  return std::make_shared<SimTxStreamer>(shared_from_this(), args);
+}
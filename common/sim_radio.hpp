@@ -0,0 +1,162 @@
+#ifndef COMMON_SIM_RADIO_HPP_
+#define COMMON_SIM_RADIO_HPP_
+
+#include "radio.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// one path of the simulated channel
+struct SimPath {
+  size_t delay;  // samples
+  std::complex<float> gain;
+};
+
+struct SimRadioOptions {
+  std::vector<SimPath> paths{{0, {1, 0}}};
+  double port_phase = 30;  // degrees added per GPIO selected port, a uniform array seen from one direction
+  double chan_phase = 90;  // degrees added per rx channel
+  double noise_dbfs = -60;  // noise power per sample
+  // waveform of the far end, sent every source_period seconds from device time 0 (what tx_core does)
+  std::vector<std::complex<float>> source;
+  double source_period = 0.2;
+  double overflow_period = 0;  // seconds between injected overflows, 0: none
+  double rx_buffer = 0.1;  // seconds a reader may fall behind before the samples overflow
+  // false: rx samples are there as soon as they are asked for and tx never waits, so a benchmark sees the
+  // cost of the pipeline instead of the sample rate (timestamps still follow the rate)
+  bool paced = true;
+  size_t num_channels = 1;
+  // a rate is coerced to master_clock / n (the nearest n) as a USRP does, 0: every rate is taken as it is
+  double master_clock = 0;
+
+  // "type=sim,sim_paths=0:0/12:-6:45,sim_noise=-50,sim_source=tx.dat,..." (see SimRadio)
+  static SimRadioOptions Parse(const std::string &args);
+};
+
+// Radio without hardware, for running and profiling the pipeline at full rate on any machine.
+//
+// The device clock runs on the host steady clock, with PPS edges on its whole seconds. The rx streamers
+// deliver timestamped samples when the device clock has passed them: what the tx streamers of this radio
+// and the source waveform put on air, through the multipath channel of the port the GPIO output
+// selects (bit j of the DDR outputs low: port j, none low: switch open), plus white noise. A reader that
+// falls more than rx_buffer behind, InjectOverflow() and overflow_period all end in an overflow report and
+// a gap in the samples. TX (channel 0) honours time specs, blocks while it is far ahead of the device clock
+// and reports burst ACKs, late bursts and underflows like a device. RX and TX share one sample rate;
+// frequencies, gains and bandwidths are only kept to be read back.
+// With sim_master_clock the rate is coerced like the decimation of a device does, so get_rx_rate() differs from
+// the rate asked for.
+//
+// Arguments (--args), separated by commas:
+//   sim_paths=<delay samples>:<gain dB>[:<phase deg>]/...   multipath taps (default 0:0)
+//   sim_port_phase=<deg>  sim_chan_phase=<deg>  sim_noise=<dBFS>  sim_channels=<n>
+//   sim_source=<fc32 file>  sim_source_period=<s>  sim_overflow=<s>  sim_rx_buffer=<s>  sim_paced=<0|1>
+//   sim_master_clock=<Hz>
+class SimRadio : public Radio, public std::enable_shared_from_this<SimRadio> {
+ public:
+  explicit SimRadio(const SimRadioOptions &options);
+
+  // the next recv() of every rx streamer reports an overflow and skips samples, callable from any thread
+  void InjectOverflow();
+  size_t num_overflows() const { return num_overflows_.load(std::memory_order_relaxed); }
+
+  std::string get_pp_string() override;
+  size_t get_rx_num_channels() override { return options_.num_channels; }
+  size_t get_tx_num_channels() override { return options_.num_channels; }
+
+  std::vector<std::string> get_clock_sources(size_t mboard) override;
+  void set_clock_source(const std::string &source, size_t mboard) override;
+  void set_time_source(const std::string &source, size_t mboard) override;
+  uhd::time_spec_t get_time_now(size_t mboard) override;
+  uhd::time_spec_t get_time_last_pps(size_t mboard) override;
+  void set_time_next_pps(const uhd::time_spec_t &time_spec, size_t mboard) override;
+  void set_command_time(const uhd::time_spec_t &time_spec, size_t mboard) override;
+  void clear_command_time(size_t mboard) override;
+
+  uhd::sensor_value_t get_mboard_sensor(const std::string &name, size_t mboard) override;
+  std::vector<std::string> get_mboard_sensor_names(size_t mboard) override;
+  uhd::sensor_value_t get_rx_sensor(const std::string &name, size_t chan) override;
+  std::vector<std::string> get_rx_sensor_names(size_t chan) override;
+  uhd::sensor_value_t get_tx_sensor(const std::string &name, size_t chan) override;
+  std::vector<std::string> get_tx_sensor_names(size_t chan) override;
+
+  void set_rx_subdev_spec(const std::string &, size_t) override {}
+  void set_rx_rate(double rate, size_t chan) override;
+  double get_rx_rate(size_t chan) override;
+  void set_tx_rate(double rate, size_t chan) override;
+  double get_tx_rate(size_t chan) override;
+  uhd::tune_result_t set_rx_freq(const uhd::tune_request_t &tune_request, size_t chan) override;
+  double get_rx_freq(size_t chan) override;
+  uhd::tune_result_t set_tx_freq(const uhd::tune_request_t &tune_request, size_t chan) override;
+  double get_tx_freq(size_t chan) override;
+  void set_rx_gain(double gain, size_t chan) override;
+  double get_rx_gain(size_t chan) override;
+  void set_tx_gain(double gain, size_t chan) override;
+  double get_tx_gain(size_t chan) override;
+  void set_rx_bandwidth(double bandwidth, size_t chan) override;
+  double get_rx_bandwidth(size_t chan) override;
+  void set_tx_bandwidth(double bandwidth, size_t chan) override;
+  double get_tx_bandwidth(size_t chan) override;
+  void set_rx_antenna(const std::string &antenna, size_t chan) override;
+  std::string get_rx_antenna(size_t chan) override;
+  void set_tx_antenna(const std::string &antenna, size_t chan) override;
+  std::string get_tx_antenna(size_t chan) override;
+  void set_rx_dc_offset(bool, size_t) override {}
+
+  void set_gpio_attr(const std::string &bank, const std::string &attr, uint32_t value, uint32_t mask,
+                     size_t mboard) override;
+
+  uhd::rx_streamer::sptr get_rx_stream(const uhd::stream_args_t &args) override;
+  uhd::tx_streamer::sptr get_tx_stream(const uhd::stream_args_t &args) override;
+
+ private:
+  friend class SimRxStreamer;
+  friend class SimTxStreamer;
+
+  // the front end settings a device would report back
+  struct FrontEnd {
+    double freq = 0;
+    double gain = 0;
+    double bandwidth = 0;
+    std::string antenna = "TX/RX";
+  };
+
+  double rate() const;
+  double DeviceTime();
+  double DeviceTimeLocked();
+  int64_t TickNow();
+
+  // GPIO selected port from tick on, -1 for none, and the tick of the next change (INT64_MAX if none)
+  int PortAt(int64_t tick, int64_t &next_change);
+  // what is on air at the antenna for [first_tick, first_tick + num_samps)
+  void OnAir(int64_t first_tick, size_t num_samps, std::complex<float> *out);
+  void Transmit(int64_t tick, std::vector<std::complex<float>> samps);
+
+  const SimRadioOptions options_;
+  const std::chrono::steady_clock::time_point epoch_;
+  std::vector<std::complex<float>> noise_;  // white noise table, read from random offsets
+
+  mutable std::mutex mutex_;
+  double rate_ = 1e6;
+  FrontEnd rx_, tx_;
+  // device time = host seconds since epoch_ + time_offset_, set_time_next_pps() takes effect at pps_edge_
+  double time_offset_ = 0;
+  bool pps_pending_ = false;
+  double pps_edge_ = 0;
+  double pps_time_ = 0;
+  bool has_command_time_ = false;
+  double command_time_ = 0;
+  uint32_t gpio_ddr_ = 0;
+  uint32_t gpio_out_ = 0;  // output before the oldest write still kept
+  std::map<int64_t, uint32_t> gpio_writes_;  // tick -> output from then on
+  std::map<int64_t, std::vector<std::complex<float>>> air_;  // first tick -> samples transmitted
+
+  std::atomic<size_t> overflow_requests_{0};
+  std::atomic<size_t> num_overflows_{0};
+};
+
+#endif // COMMON_SIM_RADIO_HPP_
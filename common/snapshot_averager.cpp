@@ -0,0 +1,85 @@
+#include "snapshot_averager.hpp"
+
+#include "capture_buffer.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Welford's update with the count-th snapshot x * scale: mean is the interleaved running mean, m2 the sum of the
+// squared deviations from it
+template <typename T>
+void WelfordUpdate(const T *x, float scale, size_t count, std::vector<float> &mean, std::vector<float> &m2) {
+  const float inv_count = 1.0f / static_cast<float>(count);
+  float *mu = mean.data();
+  const size_t size = m2.size();
+  for (size_t k = 0; k < size; k++) {
+    const float re = static_cast<float>(x[2 * k]) * scale;
+    const float im = static_cast<float>(x[2 * k + 1]) * scale;
+    const float delta_re = re - mu[2 * k];
+    const float delta_im = im - mu[2 * k + 1];
+    mu[2 * k] += delta_re * inv_count;
+    mu[2 * k + 1] += delta_im * inv_count;
+    m2[k] += delta_re * (re - mu[2 * k]) + delta_im * (im - mu[2 * k + 1]);
+  }
+}
+
+}  // namespace
+
+SnapshotAverager::SnapshotAverager(size_t size, bool with_variance)
+    : with_variance_(with_variance), sum_(size * 2), mean_(size) {
+  if (with_variance_) {
+    m2_.resize(size);
+    variance_.resize(size);
+  }
+}
+
+void SnapshotAverager::Reset() {
+  count_ = 0;
+  std::fill(sum_.begin(), sum_.end(), 0.0f);
+  std::fill(m2_.begin(), m2_.end(), 0.0f);
+}
+
+void SnapshotAverager::Add(const std::complex<float> *snapshot) {
+  const auto *x = reinterpret_cast<const float *>(snapshot);
+  count_++;
+  if (with_variance_) {
+    WelfordUpdate(x, 1.0f, count_, sum_, m2_);
+    return;
+  }
+  float *sum = sum_.data();
+  const size_t num_floats = sum_.size();
+  for (size_t i = 0; i < num_floats; i++) {
+    sum[i] += x[i];
+  }
+}
+
+void SnapshotAverager::Add(const std::complex<int16_t> *snapshot) {
+  const auto *x = reinterpret_cast<const int16_t *>(snapshot);
+  count_++;
+  if (with_variance_) {
+    WelfordUpdate(x, kSc16Scale, count_, sum_, m2_);
+    return;
+  }
+  float *sum = sum_.data();
+  const size_t num_floats = sum_.size();
+  for (size_t i = 0; i < num_floats; i++) {
+    sum[i] += static_cast<float>(x[i]) * kSc16Scale;
+  }
+}
+
+void SnapshotAverager::Finish() {
+  if (count_ == 0) return;
+  // with the variance, sum_ already is the mean
+  const float scale = with_variance_ ? 1.0f : 1.0f / static_cast<float>(count_);
+  for (size_t k = 0; k < mean_.size(); k++) {
+    mean_[k] = std::complex<float>(sum_[2 * k] * scale, sum_[2 * k + 1] * scale);
+  }
+  if (with_variance_) {
+    const float scale_m2 = count_ > 1 ? 1.0f / static_cast<float>(count_ - 1) : 0.0f;
+    for (size_t k = 0; k < variance_.size(); k++) {
+      // m2 only grows by non-negative steps, the clamp is for rounding
+      variance_[k] = std::max(m2_[k], 0.0f) * scale_m2;
+    }
+  }
+}
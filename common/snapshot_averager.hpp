@@ -0,0 +1,39 @@
+#ifndef COMMON_SNAPSHOT_AVERAGER_HPP_
+#define COMMON_SNAPSHOT_AVERAGER_HPP_
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Coherent average of repeated snapshots of the same size, optionally with the per-element variance.
+// Sums are kept as flat float arrays so Add() compiles to plain vector adds. With the variance, the mean and the
+// squared deviations are updated by Welford's method instead: sum|x|^2 - n|mean|^2 cancels in float for strong bins.
+class SnapshotAverager {
+ public:
+  SnapshotAverager(size_t size, bool with_variance);
+
+  void Reset();
+  void Add(const std::complex<float> *snapshot);
+  // sc16 samples, scaled by kSc16Scale
+  void Add(const std::complex<int16_t> *snapshot);
+  // computes mean() and variance() from the snapshots added since Reset()
+  void Finish();
+
+  size_t size() const { return mean_.size(); }
+  size_t count() const { return count_; }
+  bool with_variance() const { return with_variance_; }
+  const std::vector<std::complex<float>> &mean() const { return mean_; }
+  // unbiased estimate of E|x - mean|^2, empty without variance
+  const std::vector<float> &variance() const { return variance_; }
+
+ private:
+  bool with_variance_;
+  size_t count_ = 0;
+  std::vector<float> sum_;  // interleaved real / imag, the running mean with variance
+  std::vector<float> m2_;   // sum of |x - mean|^2
+  std::vector<std::complex<float>> mean_;
+  std::vector<float> variance_;
+};
+
+#endif // COMMON_SNAPSHOT_AVERAGER_HPP_
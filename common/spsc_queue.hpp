@@ -0,0 +1,53 @@
+#ifndef COMMON_SPSC_QUEUE_HPP_
+#define COMMON_SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Everything the producer wrote before Push() is visible to the consumer after the matching Pop().
+template<typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity) : slots_(RoundUpPow2(capacity + 1)), mask_(slots_.size() - 1) {}
+
+  // returns false when the queue is full
+  bool Push(const T &item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = (tail + 1) & mask_;
+    if (next == head_.load(std::memory_order_acquire)) return false;
+    slots_[tail] = item;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // returns false when the queue is empty
+  bool Pop(T &item) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    item = slots_[head];
+    head_.store((head + 1) & mask_, std::memory_order_release);
+    return true;
+  }
+
+  // only safe while neither side is running
+  void Clear() {
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  static size_t RoundUpPow2(size_t n) {
+    size_t size = 1;
+    while (size < n) size <<= 1;
+    return size;
+  }
+
+  std::vector<T> slots_;
+  const size_t mask_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+#endif // COMMON_SPSC_QUEUE_HPP_
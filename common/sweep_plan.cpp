@@ -0,0 +1,182 @@
+#include "sweep_plan.hpp"
+
+#include <spdlog/spdlog.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+template<typename T>
+T ParseValue(const std::string &key, const std::string &value) {
+  try {
+    return boost::lexical_cast<T>(value);
+  } catch (boost::bad_lexical_cast &) {
+    throw std::runtime_error("Bad value for " + key + ": " + value);
+  }
+}
+
+}  // namespace
+
+std::vector<double> ParseFreqs(const std::string &text) {
+  std::vector<std::string> fields;
+  boost::split(fields, text, boost::is_any_of(", "), boost::token_compress_on);
+  std::vector<double> freqs;
+  for (const auto &field : fields) {
+    if (!field.empty()) freqs.push_back(ParseValue<double>("hop", field));
+  }
+  return freqs;
+}
+
+SweepConfig Reconfigure(const SweepConfig &config, const std::string &text, double &at) {
+  SweepConfig result = config;
+  at = 0;
+  std::vector<std::string> settings;
+  boost::split(settings, text, boost::is_any_of("\n$"));
+  for (auto &setting : settings) {
+    boost::trim(setting);
+    if (setting.empty()) continue;
+    const size_t equals = setting.find('=');
+    if (equals == std::string::npos) throw std::runtime_error("Expected key=value: " + setting);
+    std::string key = setting.substr(0, equals);
+    std::string value = setting.substr(equals + 1);
+    boost::trim(key);
+    boost::trim(value);
+
+    DeviceSettings &device = result.device;
+    if (key == "at") {
+      at = ParseValue<double>(key, value);
+    } else if (key == "freq") {
+      device.freq = ParseValue<double>(key, value);
+    } else if (key == "lo-off" or key == "lo_off") {
+      device.lo_off = ParseValue<double>(key, value);
+    } else if (key == "rx-gain") {
+      device.rx.gain = ParseValue<double>(key, value);
+    } else if (key == "tx-gain") {
+      device.tx.gain = ParseValue<double>(key, value);
+    } else if (key == "bw") {
+      device.rx.bandwidth = device.tx.bandwidth = ParseValue<double>(key, value);
+    } else if (key == "rate") {
+      device.rate = ParseValue<double>(key, value);
+    } else if (key == "samps") {
+      result.num_samps = ParseValue<size_t>(key, value);
+    } else if (key == "tx-ports" or key == "rx-ports") {
+      (key == "tx-ports" ? result.tx_ports : result.rx_ports) = ParseValue<size_t>(key, value);
+      result.pattern.clear();
+      result.pattern_file.clear();
+    } else if (key == "pattern") {
+      result.pattern = value == "grid" ? "" : value;
+      result.pattern_file.clear();
+    } else if (key == "pattern-file") {
+      result.pattern_file = value;
+      result.pattern.clear();
+    } else if (key == "delay") {
+      result.num_delay = ParseValue<size_t>(key, value);
+    } else if (key == "guard") {
+      result.guard = ParseValue<size_t>(key, value);
+    } else if (key == "tx-file") {
+      result.tx_file = value;
+    } else if (key == "ctf-ratio") {
+      result.ctf_ratio = ParseValue<double>(key, value);
+    } else if (key == "hop") {
+      result.hop_freqs = value == "off" ? std::vector<double>() : ParseFreqs(value);
+    } else if (key == "stitch") {
+      result.stitch = ParseValue<bool>(key, value);
+    } else if (key == "sync") {
+      result.sync = ParseValue<bool>(key, value);
+    } else {
+      throw std::runtime_error("Unknown setting: " + key);
+    }
+  }
+  if (result.device.rate <= 0 or result.num_samps == 0) throw std::runtime_error("rate and samps must be positive");
+  return result;
+}
+
+std::vector<std::complex<float>> LoadWaveform(const std::string &path) {
+  std::ifstream infile(path.c_str(), std::ifstream::binary);
+  if (!infile.good()) throw std::runtime_error("Could not open file: " + path);
+  infile.seekg(0, std::ifstream::end);
+  const size_t num_samps = infile.tellg() / sizeof(std::complex<float>);
+  infile.seekg(0, std::ifstream::beg);
+  if (num_samps == 0) throw std::runtime_error("No samples in " + path);
+  std::vector<std::complex<float>> waveform(num_samps);
+  infile.read((char *) &waveform.front(), static_cast<std::streamsize>(num_samps * sizeof(std::complex<float>)));
+  return waveform;
+}
+
+std::shared_ptr<SweepPlan> BuildSweepPlan(const SweepConfig &config, size_t num_channels, size_t max_frame_samps,
+                                          uint32_t gpio_mask) {
+  std::shared_ptr<SweepPlan> plan = std::make_shared<SweepPlan>();
+  plan->config = config;
+
+  spdlog::info("Reading in file: {}", config.tx_file);
+  plan->tx_buff = LoadWaveform(config.tx_file);
+  spdlog::info("tx_file_num_samps: {}", plan->tx_buff.size());
+
+  // the port slots of a sweep, 2 * --samps each over the tx-ports x rx-ports grid unless a pattern is given
+  const size_t num_samps = config.num_samps;
+  plan->pattern = SwitchPattern::FromOptions(config.pattern_file, config.pattern, config.tx_ports, config.rx_ports,
+                                             num_samps * 2);
+  const SwitchPattern &pattern = plan->pattern;
+  spdlog::info("Switch pattern: {} slots, {} samples per sweep", pattern.size(), pattern.sweep_samps());
+
+  // one sweep is the delay and every port slot, plus one port of tail for the tx/rx latency
+  // so that the last slot is still on air at the end of the capture
+  plan->sweep_samps = config.num_delay + pattern.sweep_samps() + num_samps;
+  const auto period_samps = static_cast<size_t>(std::llround(config.device.rate * 0.2));
+  if (plan->sweep_samps > period_samps) throw std::runtime_error("One sweep does not fit the 200 ms sweep period");
+  plan->tx_scheduler.reset(new TxScheduler(plan->tx_buff, plan->sweep_samps, max_frame_samps,
+                                           config.tx_continuous ? period_samps : 0));
+
+  size_t min_dwell = pattern.sweep_samps();
+  for (const auto &slot : pattern.slots()) min_dwell = std::min(min_dwell, slot.dwell);
+  if (config.guard >= min_dwell or (config.ctf and config.guard + num_samps > min_dwell)) {
+    throw std::runtime_error("--guard must be smaller than every port slot, and leave --samps samples per slot "
+                             "with --ctf");
+  }
+  plan->layout.reset(new CaptureLayout(config.num_delay, pattern.dwells(), config.guard));
+
+  // the antenna switch timelines are compiled once and issued many sweeps ahead
+  plan->tx_timeline = TxSwitchTimeline(pattern, gpio_mask);
+  plan->rx_timeline = RxSwitchTimeline(pattern, gpio_mask);
+
+  // the tx waveform is the reference of the CTF, every channel has its own engine to run in parallel
+  for (size_t chan = 0; config.ctf and chan < num_channels; chan++) {
+    plan->ctf_engines.emplace_back(new CtfEngine(plan->tx_buff, num_samps, config.ctf_ratio));
+  }
+  if (config.ctf) spdlog::info("CTF output: {} bins per port", plan->ctf_engines[0]->num_bins());
+
+  // the bands are retuned at the end of the sweep before, the LOs settle in the rest of the sweep period
+  if (config.hop_freqs.size() > 1) {
+    spdlog::info("Hopping over {} bands, {:.1f} ms to settle after every retune", config.hop_freqs.size(),
+                 (0.2 - plan->sweep_seconds()) * 1e3);
+  }
+  if (config.stitch) {
+    if (!config.ctf) throw std::runtime_error("--stitch needs --ctf");
+    try {
+      plan->stitcher.reset(new CtfStitcher(plan->config.hop_freqs.empty() ? std::vector<double>{config.device.freq}
+                                                                            : config.hop_freqs,
+                                           plan->ctf_engines[0]->num_bins(),
+                                           config.device.rate / static_cast<double>(num_samps)));
+    } catch (std::invalid_argument &e) {
+      throw std::runtime_error(e.what());
+    }
+    spdlog::info("Stitched CTF: {} bins from {} Hz", plan->stitcher->num_bins(), plan->stitcher->first_freq());
+  }
+
+  // the sync window is one whole sweep from its boundary on, where the burst starts from silence: TX sends from
+  // the boundary, through the delay, so the window covers the arrival however long the delay is
+  if (config.sync) {
+    try {
+      plan->frame_sync.reset(new FrameSync(plan->tx_buff, std::max(plan->sweep_samps, 2 * plan->tx_buff.size())));
+    } catch (std::invalid_argument &e) {
+      throw std::runtime_error(std::string("--sync: ") + e.what());
+    }
+    spdlog::info("Frame sync: {} sample window, {} sample period", plan->frame_sync->window(),
+                 plan->frame_sync->period());
+  }
+  return plan;
+}
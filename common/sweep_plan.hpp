@@ -0,0 +1,99 @@
+#ifndef COMMON_SWEEP_PLAN_HPP_
+#define COMMON_SWEEP_PLAN_HPP_
+
+#include "capture_buffer.hpp"
+#include "ctf_engine.hpp"
+#include "ctf_stitcher.hpp"
+#include "device_setup.hpp"
+#include "frame_sync.hpp"
+#include "gpio_schedule.hpp"
+#include "switch_pattern.hpp"
+#include "tx_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What a measurement is made of, as given on the command line and changed by the configure command.
+struct SweepConfig {
+  DeviceSettings device;       // rate and tuning
+  std::string tx_file = "signal.dat";
+  size_t num_samps = 256;      // samples per port, a default port slot is twice as long
+  size_t tx_ports = 8;         // grid used when there is no pattern
+  size_t rx_ports = 8;
+  std::string pattern;         // switch pattern text, SwitchPattern::Parse()
+  std::string pattern_file;    // read the pattern from this file instead
+  size_t num_delay = 0;
+  size_t guard = 0;
+  bool ctf = false;            // one CtfEngine per channel
+  double ctf_ratio = 0.5;
+  bool tx_continuous = false;  // TX schedule padded to the 200 ms sweep period
+  std::vector<double> hop_freqs;  // center frequency of every band, a sweep each in turn (empty: device.freq)
+  bool stitch = false;         // one CTF over all bands, needs ctf
+  bool sync = false;           // find the TX waveform in the received stream, one FrameSync
+};
+
+// frequencies separated by ',' or spaces, "4e9,4.1e9"
+std::vector<double> ParseFreqs(const std::string &text);
+
+// config with the settings of text applied, one "key=value" per line or between '$':
+//   freq, lo-off, rx-gain, tx-gain, bw, rate, samps, tx-ports, rx-ports, pattern, pattern-file, delay, guard,
+//   tx-file, ctf-ratio, hop, stitch, sync
+// named and read like the command line options. A pattern or the port counts replace each other, "grid" as the
+// pattern goes back to the tx-ports x rx-ports grid, "hop=off" to a single band. "at=<device time>" is returned
+// in at (0 when not given).
+// Throws on unknown keys and bad values.
+SweepConfig Reconfigure(const SweepConfig &config, const std::string &text, double &at);
+
+// fc32 samples of the file, throws when it cannot be read or is empty
+std::vector<std::complex<float>> LoadWaveform(const std::string &path);
+
+// Everything of a sweep that follows from its SweepConfig: the TX waveform and its schedule, the switch pattern
+// and the GPIO timelines of both ends, the capture layout and the CTF engines. Built in one go, at startup
+// and for every configure command, and never changed afterwards, so it can be handed to the tx and control
+// threads as a whole between two sweeps. The TX schedule is the one member that is not const, only the tx
+// thread sends with it.
+struct SweepPlan {
+  SweepConfig config;
+  std::vector<std::complex<float>> tx_buff;
+  SwitchPattern pattern;
+  size_t sweep_samps = 0;  // sent per sweep: the delay, every port slot and one port of tail
+  std::unique_ptr<TxScheduler> tx_scheduler;
+  SweepTimeline tx_timeline;
+  SweepTimeline rx_timeline;
+  std::unique_ptr<CaptureLayout> layout;
+  std::vector<std::unique_ptr<CtfEngine>> ctf_engines;  // one per rx channel with config.ctf
+  std::unique_ptr<CtfStitcher> stitcher;                // with config.stitch
+  std::unique_ptr<FrameSync> frame_sync;                // with config.sync, the whole tx waveform is its period
+
+  // seconds from the sweep start until the last sample is on air
+  double sweep_seconds() const { return static_cast<double>(sweep_samps) / config.device.rate; }
+
+  size_t num_bands() const { return std::max<size_t>(config.hop_freqs.size(), 1); }
+  // band of the sweep starting at device time `time`. The bands follow the 200 ms sweep grid, so every node
+  // with the same hop list is on the same band without talking to the others.
+  size_t BandAt(double time) const {
+    return static_cast<size_t>(std::llround(time / 0.2)) % num_bands();
+  }
+  double BandFreq(size_t band) const {
+    return config.hop_freqs.empty() ? config.device.freq : config.hop_freqs[band];
+  }
+  // tuning of the sweep starting at `time`
+  DeviceSettings TuningAt(double time) const {
+    DeviceSettings settings = config.device;
+    settings.freq = BandFreq(BandAt(time));
+    return settings;
+  }
+};
+
+// Throws std::runtime_error when the sweep does not fit the 200 ms sweep period, the guard interval does not
+// fit a port slot, the bands cannot be stitched, the waveform cannot be loaded or is not a power of two
+// samples long with sync.
+std::shared_ptr<SweepPlan> BuildSweepPlan(const SweepConfig &config, size_t num_channels, size_t max_frame_samps,
+                                          uint32_t gpio_mask);
+
+#endif // COMMON_SWEEP_PLAN_HPP_
@@ -0,0 +1,153 @@
+#include "switch_pattern.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// reads an unsigned number at pos, throws with the offending slot text otherwise
+size_t ParseNumber(const std::string &slot, size_t &pos) {
+  size_t end = pos;
+  while (end < slot.size() and slot[end] >= '0' and slot[end] <= '9') end++;
+  if (end == pos) throw std::runtime_error("Invalid switch pattern slot: " + slot);
+  const size_t value = std::stoul(slot.substr(pos, end - pos));
+  pos = end;
+  return value;
+}
+
+// <a> or <a>-<b>, in visiting order
+std::vector<uint32_t> ParsePorts(const std::string &slot, size_t &pos) {
+  const size_t first = ParseNumber(slot, pos);
+  size_t last = first;
+  if (pos < slot.size() and slot[pos] == '-') {
+    pos++;
+    last = ParseNumber(slot, pos);
+  }
+  if (first >= 32 or last >= 32) throw std::runtime_error("Switch pattern port out of range: " + slot);
+  std::vector<uint32_t> ports;
+  for (auto port = static_cast<uint32_t>(first); port != last; port = last > first ? port + 1 : port - 1) {
+    ports.push_back(port);
+  }
+  ports.push_back(static_cast<uint32_t>(last));
+  return ports;
+}
+
+}  // namespace
+
+SwitchPattern::SwitchPattern(std::vector<PatternSlot> slots) : slots_(std::move(slots)) {
+  for (const auto &slot : slots_) {
+    if (slot.dwell == 0) throw std::runtime_error("Switch pattern slots need a dwell time");
+    if (slot.tx_port >= 32 or slot.rx_port >= 32) throw std::runtime_error("Switch pattern port out of range");
+  }
+}
+
+SwitchPattern SwitchPattern::Grid(size_t tx_ports, size_t rx_ports, size_t dwell) {
+  std::vector<PatternSlot> slots;
+  for (size_t i = 0; i < tx_ports; i++) {
+    for (size_t j = 0; j < rx_ports; j++) {
+      slots.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(j), dwell});
+    }
+  }
+  return SwitchPattern(std::move(slots));
+}
+
+SwitchPattern SwitchPattern::Parse(const std::string &text, size_t default_dwell) {
+  // strip the comments, every separator becomes a blank
+  std::string cleaned;
+  bool comment = false;
+  for (char c : text) {
+    if (c == '\n') comment = false;
+    else if (c == '#') comment = true;
+    if (comment) continue;
+    cleaned.push_back(c == ',' or c == ';' or c == '\t' or c == '\r' or c == '\n' ? ' ' : c);
+  }
+
+  std::vector<PatternSlot> slots;
+  std::istringstream tokens(cleaned);
+  std::string slot;
+  while (tokens >> slot) {
+    size_t pos = 0;
+    const auto tx_ports = ParsePorts(slot, pos);
+    if (pos >= slot.size() or slot[pos] != ':') throw std::runtime_error("Invalid switch pattern slot: " + slot);
+    pos++;
+    const auto rx_ports = ParsePorts(slot, pos);
+    size_t dwell = default_dwell, repeat = 1;
+    if (pos < slot.size() and slot[pos] == '@') dwell = ParseNumber(slot, ++pos);
+    if (pos < slot.size() and slot[pos] == '*') repeat = ParseNumber(slot, ++pos);
+    if (pos != slot.size()) throw std::runtime_error("Invalid switch pattern slot: " + slot);
+
+    for (size_t r = 0; r < repeat; r++) {
+      for (uint32_t tx_port : tx_ports) {
+        for (uint32_t rx_port : rx_ports) slots.push_back({tx_port, rx_port, dwell});
+      }
+    }
+  }
+  if (slots.empty()) throw std::runtime_error("Empty switch pattern");
+  return SwitchPattern(std::move(slots));
+}
+
+SwitchPattern SwitchPattern::Load(const std::string &path, size_t default_dwell) {
+  std::ifstream file(path);
+  if (!file) throw std::runtime_error("Could not open " + path);
+  std::stringstream text;
+  text << file.rdbuf();
+  return Parse(text.str(), default_dwell);
+}
+
+SwitchPattern SwitchPattern::FromOptions(const std::string &path, const std::string &text, size_t tx_ports,
+                                         size_t rx_ports, size_t dwell) {
+  if (!path.empty()) return Load(path, dwell);
+  if (!text.empty()) return Parse(text, dwell);
+  return Grid(tx_ports, rx_ports, dwell);
+}
+
+uint64_t SwitchPattern::sweep_samps() const {
+  uint64_t num_samps = 0;
+  for (const auto &slot : slots_) num_samps += slot.dwell;
+  return num_samps;
+}
+
+std::vector<size_t> SwitchPattern::dwells() const {
+  std::vector<size_t> dwells;
+  for (const auto &slot : slots_) dwells.push_back(slot.dwell);
+  return dwells;
+}
+
+size_t SwitchPattern::num_tx_ports() const {
+  size_t num_ports = 0;
+  for (const auto &slot : slots_) num_ports = std::max<size_t>(num_ports, slot.tx_port + 1);
+  return num_ports;
+}
+
+size_t SwitchPattern::num_rx_ports() const {
+  size_t num_ports = 0;
+  for (const auto &slot : slots_) num_ports = std::max<size_t>(num_ports, slot.rx_port + 1);
+  return num_ports;
+}
+
+size_t SwitchPattern::Find(uint32_t tx_port, uint32_t rx_port) const {
+  for (size_t k = 0; k < slots_.size(); k++) {
+    if (slots_[k].tx_port == tx_port and slots_[k].rx_port == rx_port) return k;
+  }
+  return slots_.size();
+}
+
+std::string SwitchPattern::ToString(size_t default_dwell) const {
+  std::ostringstream text;
+  for (size_t k = 0; k < slots_.size();) {
+    // runs of the same slot are written once with a repeat count
+    size_t repeat = 1;
+    while (k + repeat < slots_.size() and slots_[k + repeat].tx_port == slots_[k].tx_port
+        and slots_[k + repeat].rx_port == slots_[k].rx_port and slots_[k + repeat].dwell == slots_[k].dwell) {
+      repeat++;
+    }
+    if (k > 0) text << ' ';
+    text << slots_[k].tx_port << ':' << slots_[k].rx_port;
+    if (slots_[k].dwell != default_dwell) text << '@' << slots_[k].dwell;
+    if (repeat > 1) text << '*' << repeat;
+    k += repeat;
+  }
+  return text.str();
+}
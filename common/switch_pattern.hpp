@@ -0,0 +1,61 @@
+#ifndef COMMON_SWITCH_PATTERN_HPP_
+#define COMMON_SWITCH_PATTERN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one port slot of a sweep: the tx and rx antenna ports and how many samples they stay selected
+struct PatternSlot {
+  uint32_t tx_port;
+  uint32_t rx_port;
+  size_t dwell;
+};
+
+// Order in which one sweep visits the antenna port pairs. Both the rx capture layout and the
+// GPIO timelines of the tx and rx nodes are generated from it.
+//
+// Text form: slots separated by white space, ',' or ';', '#' comments out the rest of the line.
+//   <tx>:<rx>[@<dwell>][*<repeat>]
+// A port can be a range a-b (b < a runs backwards), a range on both sides expands tx port first,
+// rx port inner, like the fixed grid. dwell is in samples, default_dwell if it is left out.
+//   "0-7:0-7"            the full 8 x 8 grid
+//   "0:0 0:3 2:1@1024"   three pairs, the last one four times as long (default_dwell 256)
+//   "1:0-3*2"            rx ports 0..3 of tx port 1, twice
+class SwitchPattern {
+ public:
+  SwitchPattern() = default;
+  explicit SwitchPattern(std::vector<PatternSlot> slots);
+
+  // every tx port x every rx port, rx port first; what the cores did before patterns
+  static SwitchPattern Grid(size_t tx_ports, size_t rx_ports, size_t dwell);
+  static SwitchPattern Parse(const std::string &text, size_t default_dwell);
+  static SwitchPattern Load(const std::string &path, size_t default_dwell);
+  // what the cores sweep: the pattern in path if there is one, else the one in text, else the
+  // tx_ports x rx_ports grid, dwell samples per slot where the pattern does not say
+  static SwitchPattern FromOptions(const std::string &path, const std::string &text, size_t tx_ports,
+                                   size_t rx_ports, size_t dwell);
+
+  const std::vector<PatternSlot> &slots() const { return slots_; }
+  size_t size() const { return slots_.size(); }
+  bool empty() const { return slots_.empty(); }
+  const PatternSlot &operator[](size_t slot) const { return slots_[slot]; }
+
+  // samples of one sweep, the sum of the dwell times
+  uint64_t sweep_samps() const;
+  std::vector<size_t> dwells() const;
+  // highest port used + 1
+  size_t num_tx_ports() const;
+  size_t num_rx_ports() const;
+  // index of the first slot of the pair, size() if the pattern does not visit it
+  size_t Find(uint32_t tx_port, uint32_t rx_port) const;
+
+  // text form that Parse() reads back, dwell is only written where it differs from default_dwell
+  std::string ToString(size_t default_dwell) const;
+
+ private:
+  std::vector<PatternSlot> slots_;
+};
+
+#endif // COMMON_SWITCH_PATTERN_HPP_
@@ -0,0 +1,189 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Events of one thread. Only the owning thread writes, head counts the events ever written.
+// A reader copies the events and then checks head again to find the ones overwritten meanwhile.
+struct TraceRing {
+  TraceRing(size_t capacity, uint32_t tid) : events(capacity), tid(tid) {}
+
+  std::vector<TraceEvent> events;
+  std::atomic<uint64_t> head{0};
+  uint32_t tid;
+  std::atomic<const char *> name{nullptr};
+};
+
+std::atomic<bool> enabled{false};
+size_t ring_capacity = 0;
+
+// rings of all threads, rings of exited threads are handed to the next new thread
+std::mutex rings_mutex;
+std::vector<std::unique_ptr<TraceRing>> rings;
+std::vector<TraceRing *> free_rings;
+
+// last TraceClockSync()
+std::mutex sync_mutex;
+bool has_sync = false;
+uint64_t sync_host_ns = 0;
+double sync_device_time = 0;
+
+uint64_t HostNs(std::chrono::steady_clock::time_point time) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+}
+
+struct LocalRing {
+  ~LocalRing() {
+    if (!ring) return;
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    free_rings.push_back(ring);
+  }
+
+  TraceRing *Get() {
+    if (ring) return ring;
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    if (!free_rings.empty()) {
+      ring = free_rings.back();
+      free_rings.pop_back();
+      ring->name = nullptr;
+    } else {
+      rings.emplace_back(new TraceRing(ring_capacity, static_cast<uint32_t>(rings.size() + 1)));
+      ring = rings.back().get();
+    }
+    return ring;
+  }
+
+  TraceRing *ring = nullptr;
+};
+
+thread_local LocalRing local_ring;
+
+void Record(const TraceEvent &event) {
+  TraceRing *ring = local_ring.Get();
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  ring->events[head % ring->events.size()] = event;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+}  // namespace
+
+void EnableTracing(size_t events_per_thread) {
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    if (rings.empty()) ring_capacity = std::max<size_t>(events_per_thread, 1);
+  }
+  enabled.store(true, std::memory_order_release);
+}
+
+bool TracingEnabled() {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void TraceThreadName(const char *name) {
+  if (!TracingEnabled()) return;
+  local_ring.Get()->name = name;
+}
+
+void TraceClockSync(double device_time) {
+  if (!TracingEnabled()) return;
+  std::lock_guard<std::mutex> lock(sync_mutex);
+  has_sync = true;
+  sync_host_ns = HostNs(std::chrono::steady_clock::now());
+  sync_device_time = device_time;
+}
+
+void TraceInstant(const char *name, double device_time, int64_t arg) {
+  if (!TracingEnabled()) return;
+  Record({name, HostNs(std::chrono::steady_clock::now()), 0, device_time, arg});
+}
+
+void TraceComplete(const char *name, std::chrono::steady_clock::time_point start, double device_time,
+                   int64_t arg) {
+  if (!TracingEnabled()) return;
+  const uint64_t start_ns = HostNs(start);
+  // a duration of 0 would make it an instant event
+  const uint64_t duration_ns = std::max<uint64_t>(HostNs(std::chrono::steady_clock::now()) - start_ns, 1);
+  Record({name, start_ns, duration_ns, device_time, arg});
+}
+
+bool WriteChromeTrace(const std::string &path) {
+  // copy the rings first, the file is written without holding anything
+  struct ThreadEvents {
+    uint32_t tid;
+    const char *name;
+    std::vector<TraceEvent> events;
+  };
+  std::vector<ThreadEvents> threads;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (const auto &ring : rings) {
+      const size_t capacity = ring->events.size();
+      const uint64_t head = ring->head.load(std::memory_order_acquire);
+      const uint64_t first = head > capacity ? head - capacity : 0;
+      ThreadEvents thread{ring->tid, ring->name.load(), {}};
+      for (uint64_t k = first; k < head; k++) thread.events.push_back(ring->events[k % capacity]);
+      // the oldest events may have been overwritten while they were copied, one more may be in the works
+      const uint64_t new_head = ring->head.load(std::memory_order_acquire) + 1;
+      const uint64_t num_overwritten = new_head > first + capacity ? new_head - first - capacity : 0;
+      const auto num_dropped = std::min<uint64_t>(num_overwritten, thread.events.size());
+      thread.events.erase(thread.events.begin(), thread.events.begin() + static_cast<long>(num_dropped));
+      threads.push_back(std::move(thread));
+    }
+  }
+  bool sync;
+  uint64_t sync_ns;
+  double sync_time;
+  {
+    std::lock_guard<std::mutex> lock(sync_mutex);
+    sync = has_sync;
+    sync_ns = sync_host_ns;
+    sync_time = sync_device_time;
+  }
+
+  uint64_t origin_ns = UINT64_MAX;
+  for (const auto &thread : threads) {
+    for (const auto &event : thread.events) origin_ns = std::min(origin_ns, event.host_ns);
+  }
+
+  FILE *file = std::fopen(path.c_str(), "w");
+  if (!file) return false;
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first_event = true;
+  for (const auto &thread : threads) {
+    if (thread.name) {
+      std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                   "\"args\":{\"name\":\"%s\"}}", first_event ? "" : ",\n", thread.tid, thread.name);
+      first_event = false;
+    }
+    for (const auto &event : thread.events) {
+      const double ts = static_cast<double>(event.host_ns - origin_ns) * 1e-3;
+      std::fprintf(file, "%s{\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,", first_event ? "" : ",\n",
+                   event.name, thread.tid, ts);
+      if (event.duration_ns > 0) {
+        std::fprintf(file, "\"ph\":\"X\",\"dur\":%.3f,", static_cast<double>(event.duration_ns) * 1e-3);
+      } else {
+        std::fprintf(file, "\"ph\":\"i\",\"s\":\"t\",");
+      }
+      std::fprintf(file, "\"args\":{\"arg\":%lld", static_cast<long long>(event.arg));
+      if (event.device_time >= 0) {
+        std::fprintf(file, ",\"device_time\":%.9f", event.device_time);
+        if (sync) {
+          // device time when the call started, estimated from the sync point on the host clock
+          const double now = sync_time + (static_cast<double>(event.host_ns) - static_cast<double>(sync_ns)) * 1e-9;
+          std::fprintf(file, ",\"slack_ms\":%.3f", (event.device_time - now) * 1e3);
+        }
+      }
+      std::fprintf(file, "}}");
+      first_event = false;
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+  return std::fclose(file) == 0;
+}
@@ -0,0 +1,65 @@
+#ifndef COMMON_TRACE_HPP_
+#define COMMON_TRACE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary event trace of the real-time threads.
+//
+// Every thread writes fixed size events into its own ring, so recording is a few stores and no lock, no
+// formatting and no allocation after the first event of a thread. Events carry the host time and, where
+// there is one, the device time the operation was scheduled for. WriteChromeTrace() dumps all rings as
+// Chrome trace JSON (chrome://tracing, ui.perfetto.dev); with a clock sync point the scheduled device times
+// are also shown as slack, how far ahead of the device clock the operation was handed over.
+//
+// Names must be string literals (or otherwise outlive the trace), only the pointer is stored.
+// Recording is off until EnableTracing(), then each call costs one relaxed load.
+
+struct TraceEvent {
+  const char *name;
+  uint64_t host_ns;      // steady clock
+  uint64_t duration_ns;  // 0 for an instant event
+  double device_time;    // scheduled device time, < 0 if none
+  int64_t arg;
+};
+
+// starts recording, the last events_per_thread events of every thread are kept
+void EnableTracing(size_t events_per_thread = 1 << 16);
+bool TracingEnabled();
+
+// name of the calling thread in the trace
+void TraceThreadName(const char *name);
+
+// device_time was read from the device at the time of this call, used to map host time to device time
+void TraceClockSync(double device_time);
+
+void TraceInstant(const char *name, double device_time = -1, int64_t arg = 0);
+void TraceComplete(const char *name, std::chrono::steady_clock::time_point start, double device_time = -1,
+                   int64_t arg = 0);
+
+// records the scope as one complete event
+class TraceScope {
+ public:
+  explicit TraceScope(const char *name, double device_time = -1, int64_t arg = 0)
+      : name_(name), device_time_(device_time), arg_(arg), start_(std::chrono::steady_clock::now()) {}
+  ~TraceScope() { TraceComplete(name_, start_, device_time_, arg_); }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  void set_arg(int64_t arg) { arg_ = arg; }
+
+ private:
+  const char *name_;
+  double device_time_;
+  int64_t arg_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Writes the events recorded so far, returns false if the file could not be written.
+// Safe to call while the threads keep recording, events being overwritten during the dump are skipped.
+bool WriteChromeTrace(const std::string &path);
+
+#endif // COMMON_TRACE_HPP_
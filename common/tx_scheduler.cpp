@@ -0,0 +1,111 @@
+#include "tx_scheduler.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+Histogram &send_seconds = Metrics().AddHistogram("tx_send_seconds", "duration of sending one sweep / period");
+Histogram &burst_ack_seconds = Metrics().AddHistogram(
+    "tx_burst_ack_seconds", "from the end of burst handed to send() to its ACK, includes the time until it is on air");
+Counter &tx_underflows = Metrics().AddCounter("tx_underflows_total", "tx underflows reported by the radio");
+Counter &tx_late = Metrics().AddCounter("tx_late_total", "tx packets that reached the radio after their time");
+
+}  // namespace
+
+TxScheduler::TxScheduler(const std::vector<std::complex<float>> &waveform, size_t sweep_samps,
+                         size_t max_frame_samps, size_t period_samps) {
+  if (waveform.empty() or max_frame_samps == 0) throw std::runtime_error("TxScheduler needs a waveform");
+  if (period_samps > 0 and period_samps < sweep_samps) {
+    throw std::runtime_error("The sweep does not fit the sweep period");
+  }
+  // a frame may start anywhere in the waveform, so the tiled copy holds max_frame_samps past its end
+  const size_t waveform_samps = waveform.size();
+  tiled_.resize(waveform_samps + max_frame_samps);
+  for (size_t i = 0; i < tiled_.size(); i++) tiled_[i] = waveform[i % waveform_samps];
+
+  for (size_t pos = 0; pos < sweep_samps;) {
+    const size_t n = std::min(max_frame_samps, sweep_samps - pos);
+    frames_.push_back({&tiled_[pos % waveform_samps], n});
+    pos += n;
+  }
+  if (period_samps > sweep_samps) {
+    zeros_.resize(std::min(max_frame_samps, period_samps - sweep_samps));
+    for (size_t pos = sweep_samps; pos < period_samps;) {
+      const size_t n = std::min(zeros_.size(), period_samps - pos);
+      frames_.push_back({zeros_.data(), n});
+      pos += n;
+    }
+  }
+  num_samps_ = std::max(sweep_samps, period_samps);
+  spdlog::info("TX schedule: {} samples in {} frames ({} waveform samples, period {})",
+               num_samps_, frames_.size(), sweep_samps, period_samps);
+}
+
+size_t TxScheduler::Send(const uhd::tx_streamer::sptr &tx_stream, double time, bool end_of_burst, double timeout) {
+  uhd::tx_metadata_t md;
+  md.start_of_burst = time >= 0;
+  md.has_time_spec = time >= 0;
+  if (md.has_time_spec) md.time_spec = uhd::time_spec_t(time);
+
+  const auto start = std::chrono::steady_clock::now();
+  TraceScope trace(end_of_burst ? "tx burst" : "tx period", time);
+  size_t num_sent_samps = 0;
+  for (size_t i = 0; i < frames_.size(); i++) {
+    md.end_of_burst = end_of_burst and i + 1 == frames_.size();
+    const size_t num_sent = tx_stream->send(frames_[i].data, frames_[i].num_samps, md, timeout);
+    num_sent_samps += num_sent;
+    if (num_sent < frames_[i].num_samps) {
+      spdlog::error("Sent {} / {} samples", num_sent, frames_[i].num_samps);
+      break;
+    }
+    if (md.end_of_burst) unacked_bursts_.push_back(std::chrono::steady_clock::now());
+    md.has_time_spec = false;
+    md.start_of_burst = false;
+  }
+  send_seconds.Observe(std::chrono::steady_clock::now() - start);
+  trace.set_arg(static_cast<int64_t>(num_sent_samps));
+  return num_sent_samps;
+}
+
+void TxScheduler::EndBurst(const uhd::tx_streamer::sptr &tx_stream) {
+  uhd::tx_metadata_t md;
+  md.end_of_burst = true;
+  tx_stream->send("", 0, md);
+  unacked_bursts_.push_back(std::chrono::steady_clock::now());
+}
+
+bool TxScheduler::PollAsync(const uhd::tx_streamer::sptr &tx_stream, bool wait_for_ack, double timeout) {
+  uhd::async_metadata_t async_md;
+  bool got_async_burst_ack = false;
+  // loop through all messages for the ACK packet (may have underflow messages in queue)
+  while (not got_async_burst_ack and tx_stream->recv_async_msg(async_md, wait_for_ack ? timeout : 0)) {
+    switch (async_md.event_code) {
+      case uhd::async_metadata_t::EVENT_CODE_BURST_ACK:
+        got_async_burst_ack = true;
+        TraceInstant("tx burst ack", async_md.has_time_spec ? async_md.time_spec.get_real_secs() : -1);
+        if (!unacked_bursts_.empty()) {
+          burst_ack_seconds.Observe(std::chrono::steady_clock::now() - unacked_bursts_.front());
+          unacked_bursts_.pop_front();
+        }
+        break;
+      case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+      case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+        num_underflows_++;
+        tx_underflows.Add();
+        TraceInstant("tx underflow", async_md.has_time_spec ? async_md.time_spec.get_real_secs() : -1);
+        break;
+      case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+        num_late_++;
+        tx_late.Add();
+        TraceInstant("tx late", async_md.has_time_spec ? async_md.time_spec.get_real_secs() : -1);
+        break;
+      default:
+        break;
+    }
+  }
+  return got_async_burst_ack;
+}
@@ -0,0 +1,53 @@
+#ifndef COMMON_TX_SCHEDULER_HPP_
+#define COMMON_TX_SCHEDULER_HPP_
+
+#include <uhd/stream.hpp>
+#include <chrono>
+#include <complex>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// one tx_streamer::send() call
+struct TxFrame {
+  const std::complex<float> *data;
+  size_t num_samps;
+};
+
+// Precomputed send() calls of one sweep.
+// The waveform is repeated back to back (wrapping around the end of the file) until it covers sweep_samps,
+// in frames of at most max_frame_samps. With period_samps > 0 the sweep is padded with zeros up to
+// period_samps, so consecutive sweeps form one continuous timed stream without end of burst.
+class TxScheduler {
+ public:
+  TxScheduler(const std::vector<std::complex<float>> &waveform, size_t sweep_samps, size_t max_frame_samps,
+              size_t period_samps = 0);
+
+  // Sends one sweep (one period when continuous). time < 0 continues the running stream, otherwise the first
+  // frame starts a burst at time. end_of_burst marks the last frame. Returns the number of samples sent.
+  size_t Send(const uhd::tx_streamer::sptr &tx_stream, double time, bool end_of_burst, double timeout);
+
+  // ends a continuous stream with an empty end of burst packet
+  void EndBurst(const uhd::tx_streamer::sptr &tx_stream);
+
+  // Counts the underflows / late packets reported so far without waiting.
+  // With wait_for_ack, blocks until the burst ACK (or timeout) and returns false when it did not come.
+  bool PollAsync(const uhd::tx_streamer::sptr &tx_stream, bool wait_for_ack = false, double timeout = 0);
+
+  const std::vector<TxFrame> &frames() const { return frames_; }
+  size_t num_samps() const { return num_samps_; }
+  size_t num_underflows() const { return num_underflows_; }
+  size_t num_late() const { return num_late_; }
+
+ private:
+  std::vector<std::complex<float>> tiled_;  // waveform repeated so that a frame never wraps
+  std::vector<std::complex<float>> zeros_;
+  std::vector<TxFrame> frames_;
+  size_t num_samps_ = 0;
+  // when the end of burst of the bursts not acknowledged yet was handed to send()
+  std::deque<std::chrono::steady_clock::time_point> unacked_bursts_;
+  size_t num_underflows_ = 0;
+  size_t num_late_ = 0;
+};
+
+#endif // COMMON_TX_SCHEDULER_HPP_
@@ -0,0 +1,105 @@
+#include "udp_streamer.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <thread>
+
+const double kPacingWindow = 1e-3; // seconds
+
+namespace {
+
+Counter &udp_bytes = Metrics().AddCounter("udp_bytes_total", "payload bytes sent over UDP");
+Counter &udp_datagrams = Metrics().AddCounter("udp_datagrams_total", "UDP datagrams sent");
+Counter &udp_retries = Metrics().AddCounter("udp_retries_total", "sends retried because the socket buffer was full");
+Histogram &udp_send_seconds = Metrics().AddHistogram("udp_send_seconds", "duration of one UdpStreamer::Send()");
+
+}  // namespace
+
+UdpStreamer::UdpStreamer(const std::string &addr, const std::string &port,
+                         size_t datagram_size, double rate_limit, size_t batch_size)
+    : socket_(io_context_), datagram_size_(datagram_size), rate_limit_(rate_limit),
+      batch_size_(std::max<size_t>(batch_size, 1)) {
+  if (datagram_size_ == 0) throw std::runtime_error("The UDP datagram size must not be 0");
+  boost::asio::ip::udp::resolver resolver(io_context_);
+  auto endpoints = resolver.resolve(boost::asio::ip::udp::v4(), addr, port);
+  socket_.open(boost::asio::ip::udp::v4());
+  // room for a few batches so the kernel never has to drop a datagram we already handed over
+  socket_.set_option(boost::asio::socket_base::send_buffer_size(static_cast<int>(datagram_size_ * batch_size_ * 4)));
+  socket_.connect(*endpoints.begin());
+#if defined(__linux__)
+  iovs_.resize(batch_size_);
+  msgs_.resize(batch_size_);
+#endif
+}
+
+UdpSendStats UdpStreamer::Send(const void *data, size_t num_bytes) {
+  UdpSendStats stats;
+  TraceScope trace("udp send", -1, static_cast<int64_t>(num_bytes));
+  const auto *bytes = static_cast<const char *>(data);
+  const auto start = std::chrono::steady_clock::now();
+  // with a rate limit, never hand more than kPacingWindow worth of data to the kernel at once
+  size_t max_batch_bytes = datagram_size_ * batch_size_;
+  if (rate_limit_ > 0) {
+    auto window_datagrams = static_cast<size_t>(rate_limit_ * kPacingWindow) / datagram_size_;
+    max_batch_bytes = datagram_size_ * std::min(std::max<size_t>(window_datagrams, 1), batch_size_);
+  }
+  size_t offset = 0;
+  while (offset < num_bytes) {
+    if (rate_limit_ > 0) {
+      // pace on the average rate: the next batch may not leave before offset / rate_limit
+      std::this_thread::sleep_until(
+          start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(static_cast<double>(offset) / rate_limit_)));
+    }
+    size_t num_batch_bytes = std::min(num_bytes - offset, max_batch_bytes);
+    size_t num_sent = SendBatch(bytes + offset, num_batch_bytes);
+    stats.num_datagrams += (num_sent + datagram_size_ - 1) / datagram_size_;
+    offset += num_sent;
+  }
+  stats.num_bytes = offset;
+  stats.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  udp_bytes.Add(stats.num_bytes);
+  udp_datagrams.Add(stats.num_datagrams);
+  udp_send_seconds.Observe(stats.elapsed);
+  return stats;
+}
+
+size_t UdpStreamer::SendBatch(const char *data, size_t num_bytes) {
+#if defined(__linux__)
+  size_t num_msgs = (num_bytes + datagram_size_ - 1) / datagram_size_;
+  for (size_t i = 0; i < num_msgs; i++) {
+    iovs_[i].iov_base = const_cast<char *>(data + i * datagram_size_);
+    iovs_[i].iov_len = std::min(datagram_size_, num_bytes - i * datagram_size_);
+    msgs_[i] = mmsghdr{};
+    msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+    msgs_[i].msg_hdr.msg_iovlen = 1;
+  }
+  size_t num_sent_msgs = 0;
+  while (num_sent_msgs < num_msgs) {
+    int ret = sendmmsg(socket_.native_handle(), &msgs_[num_sent_msgs],
+                       static_cast<unsigned int>(num_msgs - num_sent_msgs), 0);
+    if (ret < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == ENOBUFS) {
+        udp_retries.Add();
+        std::this_thread::yield();
+        continue;
+      }
+      throw boost::system::system_error(errno, boost::system::system_category(), "sendmmsg");
+    }
+    num_sent_msgs += static_cast<size_t>(ret);
+  }
+  return num_bytes;
+#else
+  // one send per datagram, Send() has already cut the batch to the pacing window as on Linux
+  size_t offset = 0;
+  while (offset < num_bytes) {
+    size_t len = std::min(datagram_size_, num_bytes - offset);
+    socket_.send(boost::asio::buffer(data + offset, len));
+    offset += len;
+  }
+  return num_bytes;
+#endif
+}
@@ -0,0 +1,60 @@
+#ifndef COMMON_UDP_STREAMER_HPP_
+#define COMMON_UDP_STREAMER_HPP_
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+// result of one UdpStreamer::Send() call
+struct UdpSendStats {
+  size_t num_bytes = 0;
+  size_t num_datagrams = 0;
+  double elapsed = 0;  // seconds
+
+  double MegabytesPerSecond() const { return elapsed > 0 ? static_cast<double>(num_bytes) / elapsed / 1e6 : 0; }
+
+  UdpSendStats &operator+=(const UdpSendStats &other) {
+    num_bytes += other.num_bytes;
+    num_datagrams += other.num_datagrams;
+    elapsed += other.elapsed;
+    return *this;
+  }
+};
+
+// Sends a contiguous buffer as fixed size UDP datagrams.
+// The buffer is walked by offset (nothing is copied or erased), datagrams are handed to the kernel
+// in batches with sendmmsg() where available, and the average rate is limited by a pacer.
+class UdpStreamer {
+ public:
+  // datagram_size: payload bytes per datagram, throws when 0
+  // rate_limit:    average send rate in bytes/s, 0 sends as fast as the socket accepts
+  // batch_size:    number of datagrams handed to the kernel per system call
+  UdpStreamer(const std::string &addr, const std::string &port,
+              size_t datagram_size = 16000, double rate_limit = 0, size_t batch_size = 32);
+
+  UdpSendStats Send(const void *data, size_t num_bytes);
+
+  size_t datagram_size() const { return datagram_size_; }
+  double rate_limit() const { return rate_limit_; }
+
+ private:
+  size_t SendBatch(const char *data, size_t num_bytes);
+
+  boost::asio::io_context io_context_;
+  boost::asio::ip::udp::socket socket_;
+  size_t datagram_size_;
+  double rate_limit_;
+  size_t batch_size_;
+#if defined(__linux__)
+  std::vector<iovec> iovs_;
+  std::vector<mmsghdr> msgs_;
+#endif
+};
+
+#endif // COMMON_UDP_STREAMER_HPP_
@@ -0,0 +1,88 @@
+#ifndef COMMON_UHD_RADIO_HPP_
+#define COMMON_UHD_RADIO_HPP_
+
+#include "radio.hpp"
+
+#include <uhd/usrp/multi_usrp.hpp>
+
+// Radio on a UHD device, every call goes straight to multi_usrp
+class UhdRadio : public Radio {
+ public:
+  explicit UhdRadio(const std::string &args) : usrp_(uhd::usrp::multi_usrp::make(args)) {}
+
+  const uhd::usrp::multi_usrp::sptr &usrp() const { return usrp_; }
+
+  std::string get_pp_string() override { return usrp_->get_pp_string(); }
+  size_t get_rx_num_channels() override { return usrp_->get_rx_num_channels(); }
+  size_t get_tx_num_channels() override { return usrp_->get_tx_num_channels(); }
+
+  std::vector<std::string> get_clock_sources(size_t mboard) override { return usrp_->get_clock_sources(mboard); }
+  void set_clock_source(const std::string &source, size_t mboard) override {
+    usrp_->set_clock_source(source, mboard);
+  }
+  void set_time_source(const std::string &source, size_t mboard) override { usrp_->set_time_source(source, mboard); }
+  uhd::time_spec_t get_time_now(size_t mboard) override { return usrp_->get_time_now(mboard); }
+  uhd::time_spec_t get_time_last_pps(size_t mboard) override { return usrp_->get_time_last_pps(mboard); }
+  void set_time_next_pps(const uhd::time_spec_t &time_spec, size_t mboard) override {
+    usrp_->set_time_next_pps(time_spec, mboard);
+  }
+  void set_command_time(const uhd::time_spec_t &time_spec, size_t mboard) override {
+    usrp_->set_command_time(time_spec, mboard);
+  }
+  void clear_command_time(size_t mboard) override { usrp_->clear_command_time(mboard); }
+
+  uhd::sensor_value_t get_mboard_sensor(const std::string &name, size_t mboard) override {
+    return usrp_->get_mboard_sensor(name, mboard);
+  }
+  std::vector<std::string> get_mboard_sensor_names(size_t mboard) override {
+    return usrp_->get_mboard_sensor_names(mboard);
+  }
+  uhd::sensor_value_t get_rx_sensor(const std::string &name, size_t chan) override {
+    return usrp_->get_rx_sensor(name, chan);
+  }
+  std::vector<std::string> get_rx_sensor_names(size_t chan) override { return usrp_->get_rx_sensor_names(chan); }
+  uhd::sensor_value_t get_tx_sensor(const std::string &name, size_t chan) override {
+    return usrp_->get_tx_sensor(name, chan);
+  }
+  std::vector<std::string> get_tx_sensor_names(size_t chan) override { return usrp_->get_tx_sensor_names(chan); }
+
+  void set_rx_subdev_spec(const std::string &spec, size_t mboard) override { usrp_->set_rx_subdev_spec(spec, mboard); }
+  void set_rx_rate(double rate, size_t chan) override { usrp_->set_rx_rate(rate, chan); }
+  double get_rx_rate(size_t chan) override { return usrp_->get_rx_rate(chan); }
+  void set_tx_rate(double rate, size_t chan) override { usrp_->set_tx_rate(rate, chan); }
+  double get_tx_rate(size_t chan) override { return usrp_->get_tx_rate(chan); }
+  uhd::tune_result_t set_rx_freq(const uhd::tune_request_t &tune_request, size_t chan) override {
+    return usrp_->set_rx_freq(tune_request, chan);
+  }
+  double get_rx_freq(size_t chan) override { return usrp_->get_rx_freq(chan); }
+  uhd::tune_result_t set_tx_freq(const uhd::tune_request_t &tune_request, size_t chan) override {
+    return usrp_->set_tx_freq(tune_request, chan);
+  }
+  double get_tx_freq(size_t chan) override { return usrp_->get_tx_freq(chan); }
+  void set_rx_gain(double gain, size_t chan) override { usrp_->set_rx_gain(gain, chan); }
+  double get_rx_gain(size_t chan) override { return usrp_->get_rx_gain(chan); }
+  void set_tx_gain(double gain, size_t chan) override { usrp_->set_tx_gain(gain, chan); }
+  double get_tx_gain(size_t chan) override { return usrp_->get_tx_gain(chan); }
+  void set_rx_bandwidth(double bandwidth, size_t chan) override { usrp_->set_rx_bandwidth(bandwidth, chan); }
+  double get_rx_bandwidth(size_t chan) override { return usrp_->get_rx_bandwidth(chan); }
+  void set_tx_bandwidth(double bandwidth, size_t chan) override { usrp_->set_tx_bandwidth(bandwidth, chan); }
+  double get_tx_bandwidth(size_t chan) override { return usrp_->get_tx_bandwidth(chan); }
+  void set_rx_antenna(const std::string &antenna, size_t chan) override { usrp_->set_rx_antenna(antenna, chan); }
+  std::string get_rx_antenna(size_t chan) override { return usrp_->get_rx_antenna(chan); }
+  void set_tx_antenna(const std::string &antenna, size_t chan) override { usrp_->set_tx_antenna(antenna, chan); }
+  std::string get_tx_antenna(size_t chan) override { return usrp_->get_tx_antenna(chan); }
+  void set_rx_dc_offset(bool enable, size_t chan) override { usrp_->set_rx_dc_offset(enable, chan); }
+
+  void set_gpio_attr(const std::string &bank, const std::string &attr, uint32_t value, uint32_t mask,
+                     size_t mboard) override {
+    usrp_->set_gpio_attr(bank, attr, value, mask, mboard);
+  }
+
+  uhd::rx_streamer::sptr get_rx_stream(const uhd::stream_args_t &args) override { return usrp_->get_rx_stream(args); }
+  uhd::tx_streamer::sptr get_tx_stream(const uhd::stream_args_t &args) override { return usrp_->get_tx_stream(args); }
+
+ private:
+  uhd::usrp::multi_usrp::sptr usrp_;
+};
+
+#endif // COMMON_UHD_RADIO_HPP_
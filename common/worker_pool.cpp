@@ -0,0 +1,64 @@
+#include "worker_pool.hpp"
+#include "trace.hpp"
+
+WorkerPool::WorkerPool(size_t size) {
+  for (size_t i = 1; i < size; i++) threads_.emplace_back([this]() { Worker(); });
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  start_.notify_all();
+  for (auto &thread : threads_) thread.join();
+}
+
+void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t)> &task) {
+  if (threads_.empty() or count <= 1) {
+    for (size_t i = 0; i < count; i++) task(i);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    count_ = count;
+    next_ = 0;
+    num_busy_ = 1;
+    generation_++;
+  }
+  start_.notify_all();
+  RunTasks();
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]() { return num_busy_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkerPool::Worker() {
+  TraceThreadName("worker");
+  uint64_t seen_generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    start_.wait(lock, [&]() { return !running_ or generation_ != seen_generation; });
+    if (!running_) return;
+    seen_generation = generation_;
+    // a worker that wakes up after the loop is over has nothing left to take
+    if (!task_ or next_ >= count_) continue;
+    num_busy_++;
+    lock.unlock();
+    RunTasks();
+    lock.lock();
+  }
+}
+
+void WorkerPool::RunTasks() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const std::function<void(size_t)> &task = *task_;
+  while (next_ < count_) {
+    const size_t i = next_++;
+    lock.unlock();
+    task(i);
+    lock.lock();
+  }
+  if (--num_busy_ == 0) done_.notify_one();
+}
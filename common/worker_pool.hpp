@@ -0,0 +1,45 @@
+#ifndef COMMON_WORKER_POOL_HPP_
+#define COMMON_WORKER_POOL_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads started once that run the iterations of a loop in parallel, used for the per-channel work of a
+// multi-channel capture (CTF, averaging, sending). The calling thread takes part, so a pool of size 1 has
+// no threads and runs everything inline.
+class WorkerPool {
+ public:
+  explicit WorkerPool(size_t size);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  // runs task(0) ... task(count - 1) and returns when all of them are done, called from one thread at a time.
+  // task must not throw.
+  void ParallelFor(size_t count, const std::function<void(size_t)> &task);
+
+  size_t size() const { return threads_.size() + 1; }
+
+ private:
+  void Worker();
+  // takes iterations of the current loop until there are none left
+  void RunTasks();
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  bool running_ = true;
+  uint64_t generation_ = 0;  // counts the loops, wakes the workers for a new one
+  const std::function<void(size_t)> *task_ = nullptr;
+  size_t count_ = 0;
+  size_t next_ = 0;  // next iteration to hand out
+  size_t num_busy_ = 0;  // threads still running iterations of the current loop
+};
+
+#endif // COMMON_WORKER_POOL_HPP_
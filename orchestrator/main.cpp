@@ -0,0 +1,405 @@
+#include <boost/asio.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "capture_buffer.hpp"
+#include "control_client.hpp"
+
+namespace po = boost::program_options;
+using boost::asio::ip::udp;
+
+// one entry of master.json
+struct NodeConfig {
+  std::string addr;
+  unsigned short tcp_port;
+  unsigned short udp_port;  // where this node's captures are received here
+};
+
+// one tx -> rx link of the role table, numbered like multilinkMaster (phase by phase, Rx1, Rx2, ...)
+struct Link {
+  size_t phase;
+  size_t tx;  // 1 based node numbers as in the role table
+  size_t rx;
+  char *data;  // capture_bytes of the preallocated round buffer
+  size_t num_bytes;
+  ReplyStatus status;
+  double elapsed;  // seconds from the capture command to the last byte
+};
+
+template <typename T>
+std::vector<T> ReadArray(const boost::property_tree::ptree &tree, const std::string &key) {
+  std::vector<T> values;
+  for (const auto &child : tree.get_child(key)) values.push_back(child.second.get_value<T>());
+  return values;
+}
+
+// master.json of the MATLAB clients: SLAVE_TCP_ADDR, SLAVE_TCP_PORT, SLAVE_UDP_PORT, one entry per node,
+// and optionally ROLE, rows Tx, Rx1, Rx2, ... and a column per phase, 1 based node numbers, 0: none
+void LoadConfig(const std::string &path, std::vector<NodeConfig> &nodes, std::vector<std::vector<size_t>> &role) {
+  boost::property_tree::ptree tree;
+  boost::property_tree::read_json(path, tree);
+  auto addrs = ReadArray<std::string>(tree, "SLAVE_TCP_ADDR");
+  auto tcp_ports = ReadArray<unsigned short>(tree, "SLAVE_TCP_PORT");
+  auto udp_ports = ReadArray<unsigned short>(tree, "SLAVE_UDP_PORT");
+  if (tcp_ports.size() != addrs.size() or udp_ports.size() != addrs.size()) {
+    throw std::runtime_error(path + ": SLAVE_TCP_ADDR, SLAVE_TCP_PORT and SLAVE_UDP_PORT differ in length");
+  }
+  nodes.clear();
+  for (size_t i = 0; i < addrs.size(); i++) nodes.push_back(NodeConfig{addrs[i], tcp_ports[i], udp_ports[i]});
+
+  if (tree.get_child_optional("ROLE")) {
+    role.clear();
+    for (const auto &row : tree.get_child("ROLE")) {
+      role.emplace_back();
+      for (const auto &cell : row.second) role.back().push_back(cell.second.get_value<size_t>());
+    }
+  }
+  if (role.empty()) throw std::runtime_error(path + ": empty ROLE");
+  for (const auto &row : role) {
+    if (row.size() != role.front().size()) throw std::runtime_error(path + ": ROLE rows differ in length");
+    for (size_t node : row) {
+      if (node > nodes.size()) throw std::runtime_error(path + ": ROLE refers to node " + std::to_string(node));
+    }
+  }
+}
+
+// Receives the UDP stream of one node into the buffer of the link being captured. What arrives while no
+// capture is expected (the rest of a timed out one) is counted and dropped.
+class UdpCollector {
+ public:
+  UdpCollector(boost::asio::io_context &io_context, unsigned short port, int socket_buffer)
+      : socket_(io_context, udp::endpoint(udp::v4(), port)), datagram_(64 * 1024) {
+    socket_.set_option(udp::socket::receive_buffer_size(socket_buffer));
+    Receive();
+  }
+
+  // the future is ready once num_bytes arrived at target
+  std::future<void> Expect(char *target, size_t num_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    target_ = target;
+    num_bytes_ = num_bytes;
+    num_received_ = 0;
+    done_ = std::promise<void>();
+    if (num_bytes == 0) {
+      target_ = nullptr;
+      done_.set_value();
+    }
+    return done_.get_future();
+  }
+
+  // stops the capture, returns the bytes it got
+  size_t Finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    target_ = nullptr;
+    return num_received_;
+  }
+
+  size_t num_stray() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_stray_;
+  }
+
+ private:
+  void Receive() {
+    socket_.async_receive(boost::asio::buffer(datagram_), [this](const boost::system::error_code &error,
+                                                                 size_t num_bytes) {
+      if (error == boost::asio::error::operation_aborted) return;
+      if (error) {
+        spdlog::warn("UDP {}: {}", socket_.local_endpoint().port(), error.message());
+      } else {
+        Deliver(num_bytes);
+      }
+      Receive();
+    });
+  }
+
+  void Deliver(size_t num_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!target_) {
+      num_stray_++;
+      return;
+    }
+    const size_t num_copy = std::min(num_bytes, num_bytes_ - num_received_);
+    std::memcpy(target_ + num_received_, datagram_.data(), num_copy);
+    num_received_ += num_copy;
+    if (num_received_ == num_bytes_) {
+      target_ = nullptr;
+      done_.set_value();
+    }
+  }
+
+  udp::socket socket_;
+  std::vector<char> datagram_;
+  std::mutex mutex_;
+  char *target_ = nullptr;
+  size_t num_bytes_ = 0;
+  size_t num_received_ = 0;
+  size_t num_stray_ = 0;
+  std::promise<void> done_;
+};
+
+// Connection to one node. Its control connection and UDP socket run on a thread of their own, so every
+// node is commanded and read at the same time.
+struct Node {
+  Node(const NodeConfig &config, int socket_buffer)
+      : config(config),
+        work(boost::asio::make_work_guard(io_context)),
+        control(io_context),
+        udp(io_context, config.udp_port, socket_buffer),
+        thread([this]() { io_context.run(); }) {}
+
+  ~Node() {
+    work.reset();
+    io_context.stop();
+    thread.join();
+  }
+
+  const NodeConfig config;
+  boost::asio::io_context io_context;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+  ControlClient control;
+  UdpCollector udp;
+  std::thread thread;
+};
+
+template <typename T>
+bool WaitUntil(std::future<T> &future, std::chrono::steady_clock::time_point deadline) {
+  return future.wait_until(deadline) == std::future_status::ready;
+}
+
+double Seconds(std::chrono::steady_clock::time_point from) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - from).count();
+}
+
+// Waits for the reply to a command, false if it is not the expected status. A node that does not answer in
+// time is disconnected: its late reply would be taken for the answer to the next command.
+bool Await(Node &node, std::future<ControlReply> &reply, ReplyStatus expected,
+           std::chrono::steady_clock::time_point deadline) {
+  if (!WaitUntil(reply, deadline)) {
+    spdlog::error("Node {}:{} did not reply in time, disconnecting", node.config.addr, node.config.tcp_port);
+    node.control.Close();
+    return false;
+  }
+  ControlReply result = reply.get();
+  if (result.error) {
+    spdlog::error("Node {}:{}: {}", node.config.addr, node.config.tcp_port, result.error.message());
+    return false;
+  }
+  if (result.status != expected) {
+    spdlog::error("Node {}:{} replied {} instead of {}", node.config.addr, node.config.tcp_port,
+                  static_cast<int>(result.status), static_cast<int>(expected));
+    return false;
+  }
+  return true;
+}
+
+// Sends command to node and waits for the reply
+bool Command(Node &node, const ControlCommand &command, ReplyStatus expected,
+             std::chrono::steady_clock::time_point deadline) {
+  auto reply = node.control.Send(command);
+  return Await(node, reply, expected, deadline);
+}
+
+// One phase of the role table: tx on, every rx node captures at once, tx off once all of them are done.
+// The captures stream in on the node threads while the tx node is being stopped.
+void RunPhase(std::vector<std::unique_ptr<Node>> &nodes, std::vector<Link *> &links, const ControlCommand &capture,
+              size_t capture_bytes, double tx_settle, double timeout) {
+  using clock = std::chrono::steady_clock;
+  const auto timeout_duration = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(timeout));
+  Node &tx = *nodes[links.front()->tx - 1];
+
+  ControlCommand start;
+  start.id = CommandId::kStartTx;
+  if (!Command(tx, start, ReplyStatus::kTxStarted, clock::now() + timeout_duration)) return;
+  // the first burst goes out on the next 200 ms boundary of the tx node
+  std::this_thread::sleep_for(std::chrono::duration<double>(tx_settle));
+
+  const auto start_time = clock::now();
+  const auto deadline = start_time + timeout_duration;
+  std::vector<std::future<void>> data;
+  std::vector<std::future<ControlReply>> replies;
+  for (Link *link : links) {
+    Node &rx = *nodes[link->rx - 1];
+    ControlCommand command = capture;
+    command.link = static_cast<uint32_t>(link->tx);
+    data.push_back(rx.udp.Expect(link->data, capture.flags & kCaptureSendUdp ? capture_bytes : 0));
+    replies.push_back(rx.control.Send(command));
+  }
+  for (size_t i = 0; i < links.size(); i++) {
+    if (Await(*nodes[links[i]->rx - 1], replies[i], ReplyStatus::kCaptureDone, deadline)) {
+      links[i]->status = ReplyStatus::kCaptureDone;
+    } else {
+      links[i]->status = ReplyStatus::kCaptureFailed;
+    }
+  }
+
+  ControlCommand stop;
+  stop.id = CommandId::kStopTx;
+  auto stopped = tx.control.Send(stop);
+  for (size_t i = 0; i < links.size(); i++) {
+    if (links[i]->status == ReplyStatus::kCaptureDone) WaitUntil(data[i], deadline);
+    links[i]->num_bytes = nodes[links[i]->rx - 1]->udp.Finish();
+    links[i]->elapsed = Seconds(start_time);
+  }
+  Await(tx, stopped, ReplyStatus::kTxStopped, clock::now() + timeout_duration);
+}
+
+int main(int argc, char *argv[]) {
+  // variables to be set by po
+  std::string config_path, type, label, out_dir;
+  size_t rounds, samps, tx_ports, rx_ports, capture_bytes;
+  double tx_settle, timeout;
+  int socket_buffer;
+  bool no_udp, verbose;
+
+  po::options_description desc("Allowed options");
+  // clang-format off
+  desc.add_options()
+      ("help", "help message")
+      ("config", po::value<std::string>(&config_path)->default_value("master.json"),
+       "node list: SLAVE_TCP_ADDR, SLAVE_TCP_PORT, SLAVE_UDP_PORT and optionally ROLE")
+      ("rounds", po::value<size_t>(&rounds)->default_value(1), "number of times the role table is run")
+      ("label", po::value<std::string>(&label)->default_value(""), "label sent with every capture command")
+      ("samps", po::value<size_t>(&samps)->default_value(256), "--samps of the nodes")
+      ("tx-ports", po::value<size_t>(&tx_ports)->default_value(8), "--tx-ports of the nodes")
+      ("rx-ports", po::value<size_t>(&rx_ports)->default_value(8), "--rx-ports of the nodes")
+      ("type", po::value<std::string>(&type)->default_value("float"), "--type of the nodes, float or short")
+      ("capture-bytes", po::value<size_t>(&capture_bytes)->default_value(0),
+       "UDP bytes a node sends per capture (0: a raw capture of --samps, --tx-ports, --rx-ports, --type)")
+      ("no-udp", po::bool_switch(&no_udp), "captures are not sent over UDP")
+      ("tx-settle", po::value<double>(&tx_settle)->default_value(0.2), "seconds between tx start and the captures")
+      ("timeout", po::value<double>(&timeout)->default_value(5), "seconds to wait for a node")
+      ("socket-buffer", po::value<int>(&socket_buffer)->default_value(8 * 1024 * 1024),
+       "UDP receive buffer per node in bytes")
+      ("out-dir", po::value<std::string>(&out_dir), "write each link as <out-dir>/round<r>_link<k>_tx<t>_rx<n>.dat")
+      ("verbose", po::bool_switch(&verbose), "debug log");
+  // clang-format on
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+  if (verbose) spdlog::set_level(spdlog::level::debug);
+
+  if (capture_bytes == 0) {
+    // 2 * samps per port pair, what a raw capture without guard sends
+    const size_t capture_samps = tx_ports * rx_ports * 2 * samps;
+    if (type == "float") {
+      capture_bytes = capture_samps * 2 * sizeof(float);
+    } else if (type == "short") {
+      capture_bytes = sizeof(Sc16Header) + capture_samps * 2 * sizeof(int16_t);
+    } else {
+      std::cerr << "Unknown type: " << type << std::endl;
+      return ~0;
+    }
+  }
+
+  // multilinkMaster の役割表: 行が Tx, Rx1, Rx2, Rx3, 列がフェーズ
+  std::vector<std::vector<size_t>> role{{1, 2, 3}, {2, 3, 4}, {3, 4, 0}, {4, 0, 0}};
+  std::vector<NodeConfig> configs;
+  try {
+    LoadConfig(config_path, configs, role);
+  } catch (std::exception &e) {
+    spdlog::error("{}", e.what());
+    return ~0;
+  }
+
+  std::vector<Link> links;
+  for (size_t phase = 0; phase < role.front().size(); phase++) {
+    if (role[0][phase] == 0) continue;
+    for (size_t row = 1; row < role.size(); row++) {
+      if (role[row][phase] == 0) continue;
+      links.push_back(Link{phase, role[0][phase], role[row][phase], nullptr, 0, ReplyStatus::kBadRequest, 0});
+    }
+  }
+  // 全リンク分を先に確保しておく
+  std::vector<char> round_buff(links.size() * capture_bytes);
+  for (size_t k = 0; k < links.size(); k++) links[k].data = round_buff.data() + k * capture_bytes;
+  spdlog::info("{} nodes, {} phases, {} links, {} bytes per capture", configs.size(), role.front().size(),
+               links.size(), capture_bytes);
+
+  std::vector<std::unique_ptr<Node>> nodes;
+  try {
+    for (const auto &config : configs) nodes.emplace_back(new Node(config, socket_buffer));
+    // connect to every node at once
+    std::vector<std::future<void>> connected;
+    for (auto &node : nodes) {
+      Node *n = node.get();
+      connected.push_back(std::async(std::launch::async, [n, timeout]() {
+        n->control.Connect(n->config.addr, n->config.tcp_port, timeout);
+      }));
+    }
+    for (auto &c : connected) c.get();
+  } catch (std::exception &e) {
+    spdlog::error("{}", e.what());
+    return ~0;
+  }
+
+  ControlCommand capture;
+  capture.id = CommandId::kCapture;
+  capture.count = 1;
+  capture.flags = no_udp ? 0u : static_cast<uint32_t>(kCaptureSendUdp);
+  capture.label = label;
+
+  bool all_ok = true;
+  for (size_t round = 0; round < rounds; round++) {
+    for (auto &link : links) {
+      link.num_bytes = 0;
+      link.status = ReplyStatus::kBadRequest;
+      link.elapsed = 0;
+    }
+    const auto round_start = std::chrono::steady_clock::now();
+    for (size_t phase = 0; phase < role.front().size(); phase++) {
+      std::vector<Link *> phase_links;
+      for (auto &link : links) {
+        if (link.phase == phase) phase_links.push_back(&link);
+      }
+      if (phase_links.empty()) continue;
+      const auto phase_start = std::chrono::steady_clock::now();
+      RunPhase(nodes, phase_links, capture, capture_bytes, tx_settle, timeout);
+      spdlog::debug("Phase {}: {:.3f} s", phase + 1, Seconds(phase_start));
+    }
+    const double round_time = Seconds(round_start);
+
+    std::printf("round %zu: %.3f s\n", round + 1, round_time);
+    std::printf("%6s %4s %4s %8s %12s %10s\n", "link", "tx", "rx", "status", "bytes", "time [ms]");
+    for (size_t k = 0; k < links.size(); k++) {
+      const Link &link = links[k];
+      const bool ok = link.status == ReplyStatus::kCaptureDone and
+                      (no_udp or link.num_bytes == capture_bytes);
+      all_ok = all_ok and ok;
+      std::printf("%6zu %4zu %4zu %8s %12zu %10.1f\n", k + 1, link.tx, link.rx, ok ? "ok" : "failed",
+                  link.num_bytes, link.elapsed * 1e3);
+      if (!out_dir.empty() and link.num_bytes > 0) {
+        const std::string path = out_dir + "/round" + std::to_string(round + 1) + "_link" + std::to_string(k + 1) +
+                                 "_tx" + std::to_string(link.tx) + "_rx" + std::to_string(link.rx) + ".dat";
+        std::ofstream out(path, std::ofstream::binary);
+        out.write(link.data, static_cast<std::streamsize>(link.num_bytes));
+        if (!out) spdlog::error("Cannot write {}", path);
+      }
+    }
+  }
+  for (auto &node : nodes) {
+    const size_t num_stray = node->udp.num_stray();
+    if (num_stray > 0) spdlog::warn("{}: {} datagrams outside of a capture", node->config.addr, num_stray);
+    node->control.Close();
+  }
+  return all_ok ? EXIT_SUCCESS : ~0;
+}
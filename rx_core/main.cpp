@@ -1,20 +1,35 @@
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "OCUnusedMacroInspection"
 
+#include <uhd/exception.hpp>
 #include <uhd/types/tune_request.hpp>
 #include <uhd/utils/safe_main.hpp>
 #include <uhd/utils/thread.hpp>
-#include <uhd/usrp/multi_usrp.hpp>
 #define _WIN32_WINNT 0x0601 // NOLINT(bugprone-reserved-identifier)
-#include <uhd/transport/udp_simple.hpp>
+#include "capture_buffer.hpp"
+#include "capture_recorder.hpp"
+#include "device_setup.hpp"
+#include "gpio_schedule.hpp"
+#include "metrics.hpp"
+#include "metrics_server.hpp"
+#include "radio.hpp"
+#include "rx_capture.hpp"
+#include "rx_ring.hpp"
+#include "snapshot_averager.hpp"
+#include "switch_pattern.hpp"
+#include "trace.hpp"
+#include "udp_streamer.hpp"
+#include "worker_pool.hpp"
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <thread>
 #include <complex>
 #include <fstream>
+#include <memory>
 #include <csignal>
 #include <spdlog/spdlog.h>
 #if defined(_WIN32)
@@ -30,6 +45,9 @@
 
 namespace po = boost::program_options;
 
+Counter &captures_done = Metrics().AddCounter("captures_total", "captures received completely");
+Counter &captures_failed = Metrics().AddCounter("captures_failed_total", "captures with missing samples");
+
 static bool stop_signal_called = false;
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "OCDFAInspection"
@@ -38,49 +56,26 @@ void SigIntHandler(int) {
 }
 #pragma clang diagnostic pop
 
-void GpioWorker(const uhd::usrp::multi_usrp::sptr &usrp,
-                double rate,
-                size_t num_samps,
-                size_t tx_ports,
-                size_t rx_ports,
-                double base_time) {
-  // basic ATR configuation
-  usrp->set_gpio_attr("FP0", "CTRL", ATR_CONTROL, ATR_MASKS);
-  usrp->set_gpio_attr("FP0", "DDR", GPIO_DDR, ATR_MASKS);
-
-  //start GPIO control
-  unsigned int gpio_state;
-  auto command_time = base_time;
-  for (int i = 0; i < tx_ports; i++) {
-    for (int j = 0; j < rx_ports; j++) {
-      gpio_state = MAN_GPIO_MASK & ~(1 << j);
-      usrp->set_command_time(command_time);
-      usrp->set_gpio_attr("FP0", "OUT", gpio_state, ATR_MASKS);
-      usrp->clear_command_time();
-      command_time += (static_cast<double>(num_samps) * 2 / rate);
-    }
-  }
-  gpio_state = 0xFF;
-  command_time += (static_cast<double>(num_samps) * 2 / rate);
-  usrp->set_command_time(command_time);
-  usrp->set_gpio_attr("FP0", "OUT", gpio_state, ATR_MASKS);
-  usrp->clear_command_time();
-}
-
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "OCUnusedGlobalDeclarationInspection"
 int UHD_SAFE_MAIN(int argc, char *argv[]) {
 #pragma clang diagnostic pop
   // variables to be set by po
-  std::string args, subdev, ref, otw, channels, antenna, file_path, addr, udp_port, tcp_port;
-  size_t num_samps, rx_ports, tx_ports, num_delay;
-  double rate, freq, gain, bw, lo_off;
+  std::string args, subdev, ref, otw, type, channels, antenna, file_path, addr, udp_port, tcp_port, record;
+  size_t num_samps, rx_ports, tx_ports, num_delay, guard, udp_size, num_average, record_buffers, segment_size,
+      gpio_queue_depth;
+  double rate, freq, gain, bw, lo_off, udp_rate, segment_time, lock_timeout;
   bool use_tcp = false;
+  std::string pattern_text, pattern_file, trace_path;
+  unsigned short metrics_port;
+  bool variance, continuous, buffered_io, concurrent_setup;
 
   // initialize the logger
   spdlog::set_level(spdlog::level::debug);
   spdlog::set_pattern("[%H:%M:%S.%e] [%^%l%$] [thread %t] %v");
   spdlog::info("Starting");
+  // time to the first measurement after launch, logged phase by phase once the node is ready
+  StartupTimer timer;
 
   // setup the program options
   po::options_description desc("Allowed options");
@@ -88,7 +83,7 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
   desc.add_options()
       ("help", "help message")
       ("args", po::value<std::string>(&args)->default_value(""),
-       "single uhd device address args")
+       "single uhd device address args, \"type=sim,...\" for the simulated radio (see sim_radio.hpp)")
       ("rate", po::value<double>(&rate), "rate of incoming samples")
       ("lo_off", po::value<double>(&lo_off)->default_value(-1),
        "offset from the center frequency")
@@ -100,20 +95,54 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
        "reference source (internal, external, mimo, gpsdo)")
       ("otw", po::value<std::string>(&otw)->default_value("sc16"),
        "specify the over-the-wire sample mode")
+      ("type", po::value<std::string>(&type)->default_value("float"),
+       "sample type kept in memory, sent over UDP and written to --file: float or short (int16 + scale header)")
       ("channels", po::value<std::string>(&channels)->default_value("0"),
-       "which channels to use")
+       "which channels to use, all of them are captured every sweep")
       ("antenna", po::value<std::string>(&antenna)->default_value("RX2"),
        "which antenna to use (TX/RX, RX2, CAL)")
       ("samps",
        po::value<size_t>(&num_samps)->default_value(256),
        "total number of samples to receive")
-      ("rx-ports", po::value<size_t>(&rx_ports)->default_value(8), "number of Rx ports")
-      ("tx-ports", po::value<size_t>(&tx_ports)->default_value(8), "number of Tx ports")
-      ("file", po::value<std::string>(&file_path)->default_value(""), "file path to write to")
+      ("rx-ports", po::value<size_t>(&rx_ports)->default_value(8), "number of Rx ports (without a pattern)")
+      ("tx-ports", po::value<size_t>(&tx_ports)->default_value(8), "number of Tx ports (without a pattern)")
+      ("pattern", po::value<std::string>(&pattern_text),
+       "antenna switch pattern, e.g. \"0:0 0:3 2:1@1024*2\" (tx:rx[@dwell samples][*repeat], ranges a-b)")
+      ("pattern-file", po::value<std::string>(&pattern_file), "read the antenna switch pattern from this file")
+      ("file", po::value<std::string>(&file_path)->default_value(""),
+       "file path to write to (every channel, one after the other)")
       ("delay", po::value<size_t>(&num_delay)->default_value(0), "delay samples")
+      ("guard", po::value<size_t>(&guard)->default_value(0),
+       "samples dropped from the start of every port slot (switching transient), less than the shortest slot")
       ("addr", po::value<std::string>(&addr)->default_value("127.0.0.1"), "IP address")
-      ("port", po::value<std::string>(&udp_port)->default_value("12345"), "port number")
+      ("port", po::value<std::string>(&udp_port)->default_value("12345"),
+       "port number, channel k of --channels is sent to port + k")
       ("tcp-port", po::value<std::string>(&tcp_port)->default_value(""), "TCP port number")
+      ("udp-size", po::value<size_t>(&udp_size)->default_value(16000), "UDP payload bytes per datagram")
+      ("udp-rate", po::value<double>(&udp_rate)->default_value(0), "UDP send rate limit in MB/s (0: unlimited)")
+      ("average", po::value<size_t>(&num_average)->default_value(1),
+       "number of snapshots (one per 200 ms) averaged coherently before sending")
+      ("variance", po::bool_switch(&variance), "with --average, also send the variance of every sample")
+      ("record", po::value<std::string>(&record),
+       "append every snapshot to <record>_<n>.dat archive segments on a background thread (see archive_tool)")
+      ("record-buffers", po::value<size_t>(&record_buffers)->default_value(16),
+       "captures that can wait for the disk before --record drops one")
+      ("segment-size", po::value<size_t>(&segment_size)->default_value(1024), "--record segment size in MB")
+      ("segment-time", po::value<double>(&segment_time)->default_value(0),
+       "start a new --record segment after this many seconds (0: by size only)")
+      ("buffered-io", po::bool_switch(&buffered_io), "write --record segments through the page cache (no O_DIRECT)")
+      ("gpio-queue", po::value<size_t>(&gpio_queue_depth)->default_value(64),
+       "antenna switch commands queued ahead of their time per switching run, at most this many in the device")
+      ("metrics-port", po::value<unsigned short>(&metrics_port)->default_value(0),
+       "serve counters and latency histograms in the Prometheus text format on 127.0.0.1:<port> (0: off)")
+      ("trace", po::value<std::string>(&trace_path),
+       "record timing events of the rx / gpio threads and write them as Chrome trace JSON to this file on exit")
+      ("continuous", po::bool_switch(&continuous),
+       "keep the rx stream running into a ring buffer and cut each capture out of it by device time")
+      ("lock-timeout", po::value<double>(&lock_timeout)->default_value(5),
+       "seconds to wait for the reference and LO lock sensors")
+      ("concurrent-setup", po::bool_switch(&concurrent_setup), "set up the rx and tx chains on two threads, "
+       "only for devices whose setters are safe to call concurrently (the same flag as txrx_core)")
       ("repeat", "if set, repeat the receive to infinity");
   // clang-format on
   po::variables_map vm;
@@ -126,6 +155,12 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     return ~0;
   }
 
+  // counters and histograms of the hot paths
+  std::unique_ptr<MetricsServer> metrics_server;
+  if (metrics_port != 0) metrics_server.reset(new MetricsServer(metrics_port));
+  if (!trace_path.empty()) EnableTracing();
+  TraceThreadName("rx");
+
   // if defined TCP port, use TCP
   if (!tcp_port.empty()) {
     use_tcp = true;
@@ -170,112 +205,137 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
 #endif
 
 
-  // create a usrp device
-  spdlog::info("Creating the usrp device with: {}", args);
-  uhd::usrp::multi_usrp::sptr usrp = uhd::usrp::multi_usrp::make(args);
-  auto time_now = usrp->get_time_now().get_real_secs();
-  spdlog::info("Current time: {}", time_now);
-
-
-  // detect which channels to use
-  std::vector<std::string> channel_strings;
-  std::vector<size_t> channel_nums;
-  boost::split(channel_strings, channels, boost::is_any_of("\"',"));
-  for (const auto &kChannelString : channel_strings) {
-    size_t chan = boost::lexical_cast<int>(kChannelString);
-    if (chan >= usrp->get_rx_num_channels()) {
-      throw std::runtime_error("Invalid channel(s) specified.");
-    } else {
-      channel_nums.push_back(boost::lexical_cast<int>(kChannelString));
-    }
-  }
-
-  // lock mboard clocks
-  spdlog::info("Locking mboard clocks");
-  auto clock_list = usrp->get_clock_sources(0);
-  usrp->set_clock_source(ref);
-  usrp->set_time_source(ref);
-
-  // set the sample rate
   if (not vm.count("rate")) {
     std::cerr << "Please specify a sample rate with --rate" << std::endl;
     return ~0;
   }
-  spdlog::info("Setting Rx Rate: {} Msps", rate / 1e6);
-  usrp->set_rx_rate(rate);
-  spdlog::info("Actual RX Rate: {} MHz", usrp->get_tx_rate() / 1e6);
-
   if (not vm.count("freq")) {
     std::cerr << "Please specify a center frequency with --freq" << std::endl;
     return ~0;
   }
-  for (size_t chan : channel_nums) {
-    spdlog::info("Configuring RX Channel {}", chan);
-
-    // set the center frequency
-    spdlog::info("Setting RX Freq: {} MHz", freq / 1e6);
-    uhd::tune_request_t tune_request(freq, lo_off);
-    usrp->set_rx_freq(tune_request, chan);
-    spdlog::info("Actual RX Freq: {} MHz", usrp->get_rx_freq(chan) / 1e6);
-
-    // set the rf gain
-    if (vm.count("gain")) {
-      spdlog::info("Setting RX Gain: {} dB", gain);
-      usrp->set_rx_gain(gain, chan);
-      spdlog::info("Actual RX Gain: {} dB", usrp->get_rx_gain(chan));
-    }
-
-    // set the analog frontend filter bandwidth
-    if (vm.count("bw")) {
-      spdlog::info("Setting RX Bandwidth: {} MHz", bw / 1e6);
-      usrp->set_rx_bandwidth(bw, chan);
-      spdlog::info("Actual RX Bandwidth: {} MHz", usrp->get_rx_bandwidth(chan) / 1e6);
-    }
-
-    // set the analog frontend filter bandwidth
-    if (vm.count("antenna")) {
-      spdlog::info("Setting RX Antenna: {}", antenna);
-      usrp->set_rx_antenna(antenna, chan);
-      spdlog::info("Actual RX Antenna: {}", usrp->get_rx_antenna(chan));
-    }
-  }
 
-  usrp->set_rx_dc_offset(true);
+  // create a usrp device
+  spdlog::info("Creating the usrp device with: {}", args);
+  Radio::sptr usrp = MakeRadio(args);
+  auto time_now = usrp->get_time_now().get_real_secs();
+  spdlog::info("Current time: {}", time_now);
+  timer.Mark("device");
+
+  DeviceSettings settings;
+  settings.channels = ParseChannels(channels, usrp->get_rx_num_channels());
+  settings.clock_source = ref;
+  settings.rate = rate;
+  settings.freq = freq;
+  settings.lo_off = lo_off;
+  settings.lock_timeout = lock_timeout;
+  settings.concurrent = concurrent_setup;
+  settings.rx.enabled = true;
+  if (vm.count("gain")) settings.rx.gain = gain;
+  if (vm.count("bw")) settings.rx.bandwidth = bw;
+  if (vm.count("antenna")) settings.rx.antenna = antenna;
+  BringUp(*usrp, settings, timer);
+  const std::vector<size_t> &channel_nums = settings.channels;
+  // the rest of the setup runs while the device waits for the PPS edge
+  spdlog::info("Setting device timestamp to 0 at next PPS");
+  PpsTimeReset pps(*usrp);
 
   // create a receive streamer
-  uhd::stream_args_t stream_args("fc32", otw);
+  auto sample_format = ParseSampleFormat(type);
+  uhd::stream_args_t stream_args(CpuFormat(sample_format), otw);
   stream_args.channels = channel_nums;
   uhd::rx_streamer::sptr rx_stream = usrp->get_rx_stream(stream_args);
 
 
-  // Check Ref and LO Lock detect
-  // wait for LO lock
-  spdlog::info("Waiting for LO lock...");
-  std::this_thread::sleep_for(std::chrono::seconds(1));
-  std::vector<std::string> sensor_names;
-  sensor_names = usrp->get_rx_sensor_names(0);
-  if (std::find(sensor_names.begin(), sensor_names.end(), "lo_locked") != sensor_names.end()) {
-    uhd::sensor_value_t lo_locked = usrp->get_rx_sensor("lo_locked", 0);
-    spdlog::info("Checking RX: {} ...", lo_locked.to_pp_string());
-    UHD_ASSERT_THROW(lo_locked.to_bool())
-  }
-  sensor_names = usrp->get_mboard_sensor_names(0);
-  if ((ref == "external")
-      and (std::find(sensor_names.begin(), sensor_names.end(), "ref_locked") != sensor_names.end())) {
-    uhd::sensor_value_t ref_locked = usrp->get_mboard_sensor("ref_locked", 0);
-    spdlog::info("Checking RX: {} ...", ref_locked.to_pp_string());
-    UHD_ASSERT_THROW(ref_locked.to_bool())
-  }
+  timer.Mark("streamers");
 
   // register ctrl+c sigint handler
   std::signal(SIGINT, &SigIntHandler);
   spdlog::info("Press Ctrl + C to stop streaming...");
 
-  spdlog::info("Setting device timestamp to 0 at next PPS");
-  usrp->set_time_next_pps(uhd::time_spec_t(0.0));
-  spdlog::info("Waiting for first PPS...");
-  std::this_thread::sleep_for(std::chrono::seconds(1));
-  spdlog::info("PPS detected, starting streaming...");
+
+  // the port slots of a sweep, 2 * --samps each over the tx-ports x rx-ports grid unless a pattern is given
+  const SwitchPattern pattern = SwitchPattern::FromOptions(pattern_file, pattern_text, tx_ports, rx_ports,
+                                                           num_samps * 2);
+  spdlog::info("Switch pattern: {} slots, {} samples per sweep", pattern.size(), pattern.sweep_samps());
+
+  // capture buffer is sized once and reused by every capture, recv() writes into it directly
+  // and the delay and the guard interval of every slot never reach it
+  for (const auto &slot : pattern.slots()) {
+    if (guard >= slot.dwell) {
+      std::cerr << "--guard must be smaller than every port slot" << std::endl;
+      return ~0;
+    }
+  }
+  // every channel has its own plane in the buffers, its own averager and its own UDP stream,
+  // and the channels are averaged and sent in parallel
+  const size_t num_channels = channel_nums.size();
+  const CaptureLayout layout(num_delay, pattern.dwells(), guard);
+  const size_t total_num_samps = layout.stream_samps();
+  // the delay is skipped and the switching is timed on the device clock, in samples of the rate it actually runs at
+  const double rx_rate = usrp->get_rx_rate();
+  CaptureBuffer buffs(sample_format, layout.capture_samps(), num_channels);
+  CaptureBuffer scratch(sample_format, rx_stream->get_max_num_samps(), num_channels);
+  spdlog::info("Allocated capture buffer: {} channels x {} {} samples", num_channels, layout.capture_samps(),
+               CpuFormat(sample_format));
+  num_average = std::max<size_t>(num_average, 1);
+  std::vector<SnapshotAverager> averagers(num_channels,
+                                          SnapshotAverager(num_average > 1 ? layout.capture_samps() : 0, variance));
+  WorkerPool channel_pool(num_channels);
+
+  // setup udp socket
+  std::vector<std::unique_ptr<UdpStreamer>> udp_streamers;
+  for (size_t chan = 0; chan < num_channels; chan++) {
+    udp_streamers.emplace_back(new UdpStreamer(addr, std::to_string(std::stoi(udp_port) + static_cast<int>(chan)),
+                                               udp_size, udp_rate * 1e6));
+  }
+
+  std::unique_ptr<CaptureRecorder> recorder;
+  if (!record.empty()) {
+    RecorderOptions recorder_options;
+    recorder_options.prefix = record;
+    recorder_options.max_record_bytes = buffs.bytes(layout.capture_samps()) * num_channels;
+    recorder_options.num_buffers = record_buffers;
+    recorder_options.segment_bytes = segment_size << 20;
+    recorder_options.segment_seconds = segment_time;
+    recorder_options.direct_io = !buffered_io;
+    // everything needed to interpret the samples later goes into the segment header
+    ArchiveConfig &config = recorder_options.config;
+    config.rate = usrp->get_rx_rate();
+    config.freq = usrp->get_rx_freq();
+    config.rx_gain = usrp->get_rx_gain();
+    config.tx_gain = 0;
+    config.sample_format = static_cast<uint32_t>(sample_format);
+    try {
+      SetArchiveLayout(config, pattern, num_samps, guard, num_delay, num_channels, args);
+    } catch (std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return ~0;
+    }
+    recorder.reset(new CaptureRecorder(recorder_options));
+  }
+
+  timer.Mark("setup");
+  if (pps.Wait()) {
+    spdlog::info("PPS detected, starting streaming...");
+  } else {
+    spdlog::warn("No PPS edge seen, the device time may not be aligned to the other nodes");
+  }
+  timer.Mark("pps");
+
+  // antenna switch timeline, the pins are configured once here and only OUT is written per sweep
+  usrp->set_gpio_attr("FP0", "CTRL", ATR_CONTROL, ATR_MASKS);
+  usrp->set_gpio_attr("FP0", "DDR", GPIO_DDR, ATR_MASKS);
+  const SweepTimeline gpio_timeline = RxSwitchTimeline(pattern, MAN_GPIO_MASK);
+  GpioScheduler gpio_scheduler(usrp, rx_rate, ATR_MASKS, gpio_queue_depth);
+
+  // with --continuous, rx streams from the next 200 ms boundary until exit
+  std::unique_ptr<RxRing> rx_ring;
+  if (continuous) {
+    rx_ring.reset(new RxRing(rx_stream, sample_format,
+                             std::max<size_t>(total_num_samps * 4, static_cast<size_t>(rx_rate * 0.02)), rx_rate));
+    rx_ring->Start(std::ceil(usrp->get_time_now().get_real_secs() * 5) / 5 + 0.2);
+  }
+  timer.Report();
 
   bool status = true;
   // start streaming
@@ -321,98 +381,97 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     }
 
     spdlog::info("Starting streaming...");
-    // setup streaming
-    auto total_num_samps = num_samps * tx_ports * rx_ports * 2 + num_delay;
     time_now = usrp->get_time_now().get_real_secs();
+    TraceClockSync(time_now);
     auto recv_time = std::ceil(time_now * 5) / 5;
-    if (recv_time < time_now + 0.05) {
+    // with --continuous the samples are already streaming, so only the GPIO commands need the margin
+    if (recv_time < time_now + (rx_ring ? 0.01 : 0.05)) {
       recv_time += 0.2;
     }
-    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
-    stream_cmd.num_samps = total_num_samps;
-    stream_cmd.stream_now = false;
-    stream_cmd.time_spec = uhd::time_spec_t(recv_time);
-    rx_stream->issue_stream_cmd(stream_cmd);
-    spdlog::info("Begin streaming {} samples at {}", total_num_samps, recv_time);
-
-    // start gpio thread
-    std::thread gpio_thread([&]() {
-      GpioWorker(usrp, rate, num_samps, tx_ports, rx_ports, recv_time + static_cast<double>(num_delay) / rate);
-    });
-
-    // meta-data will be filled in by recv()
-    uhd::rx_metadata_t md;
-
-    // allocate buffer to receive with samples
-    std::vector<std::complex<float>> buff(rx_stream->get_max_num_samps());
-    std::vector<std::complex<float>> buffs;
 
-//    // setup udp socket
-    uhd::transport::udp_simple::sptr udp_sock =
-        uhd::transport::udp_simple::make_connected(addr, udp_port);
-
-    // the first call to recv() will block this many seconds before receiving
-    double timeout = 0.5;
+    // start gpio thread, one switch sweep per snapshot
+    std::atomic<bool> gpio_running{true};
+    std::thread gpio_thread([&, recv_time]() {
+      TraceThreadName("gpio");
+      gpio_scheduler.Run(gpio_timeline, recv_time + static_cast<double>(num_delay) / rx_rate, num_average, 0.2,
+                         gpio_running);
+    });
 
+    // with --average, one snapshot per 200 ms is accumulated and only the mean is sent
+    for (auto &averager : averagers) averager.Reset();
     size_t num_acc_samps = 0;
-    while (num_acc_samps < total_num_samps) {
-
-      // receive a single packet
-      size_t num_rx_samps;
-      try {
-        num_rx_samps = rx_stream->recv(&buff.front(), buff.size(), md, timeout);
-      } catch (uhd::io_error &e) {
-        spdlog::error("Caught an IO exception: {}", e.what());
-        break;
+    for (size_t snapshot = 0; snapshot < num_average; snapshot++, recv_time += 0.2) {
+      TraceScope trace_snapshot("snapshot", recv_time, static_cast<int64_t>(snapshot));
+      if (rx_ring) {
+        const double timeout = recv_time - time_now + static_cast<double>(total_num_samps) / rx_rate + 1.0;
+        num_acc_samps = rx_ring->Extract(rx_ring->TimeToTick(recv_time), layout, buffs, timeout);
+      } else {
+        num_acc_samps = ReceiveSweep(rx_stream, layout, buffs, scratch, recv_time, rx_rate);
       }
-      // use a small timeout for subsequent packetnumber of seconds in the future to receives
-      timeout = 0.1;
-
-      // handle the error code
-      if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
-        spdlog::error("Receiver error: {}", md.strerror());
-        break;
+      if (num_acc_samps < total_num_samps) break;
+      if (recorder) {
+        recorder->Record(buffs.at(0), buffs.bytes(layout.capture_samps()) * num_channels, recv_time,
+                         static_cast<uint32_t>(sample_format));
+      }
+      if (num_average > 1) {
+        channel_pool.ParallelFor(num_channels, [&](size_t chan) {
+          if (sample_format == SampleFormat::kSc16) {
+            averagers[chan].Add(buffs.sc16(0, chan));
+          } else {
+            averagers[chan].Add(buffs.fc32(0, chan));
+          }
+        });
       }
-
-      num_acc_samps += num_rx_samps;
-      buffs.insert(buffs.end(), buff.begin(), buff.end());
     }
+    gpio_running = false;
+    gpio_thread.join();
 
     if (num_acc_samps < total_num_samps) {
       spdlog::warn("Did not receive all samples: {} out of {}", num_acc_samps, total_num_samps);
-      buff.clear();
-      buffs.clear();
+      captures_failed.Add();
+      num_acc_samps = 0;
       status = false;
     } else {
-      buffs.erase(buffs.begin(), buffs.begin() + static_cast<int>(num_delay));
-      num_acc_samps -= num_delay;
+      num_acc_samps = layout.capture_samps();
+      captures_done.Add();
       auto rcvd_time = usrp->get_time_now().get_real_secs();
-      spdlog::info("Recieved {} samples at {}", num_acc_samps, rcvd_time);
-      size_t type_size = sizeof(buffs.front());
-      while (num_acc_samps > 0) {
-        size_t num_tx_samps;
-        if (num_acc_samps < 2000) {
-          udp_sock->send(boost::asio::buffer(buffs, num_acc_samps * type_size));
-          num_tx_samps = num_acc_samps;
+      spdlog::info("Recieved {} x {} samples at {}", num_average, num_acc_samps, rcvd_time);
+      std::vector<UdpSendStats> channel_stats(num_channels);
+      channel_pool.ParallelFor(num_channels, [&](size_t chan) {
+        UdpStreamer &udp_streamer = *udp_streamers[chan];
+        UdpSendStats &send_stats = channel_stats[chan];
+        if (num_average > 1) {
+          // mean first, then the variance of every sample
+          SnapshotAverager &averager = averagers[chan];
+          averager.Finish();
+          send_stats = udp_streamer.Send(averager.mean().data(), averager.size() * sizeof(averager.mean().front()));
+          if (averager.with_variance()) {
+            send_stats += udp_streamer.Send(averager.variance().data(),
+                                            averager.size() * sizeof(averager.variance().front()));
+          }
         } else {
-          udp_sock->send(boost::asio::buffer(buffs, 2000 * type_size));
-          num_tx_samps = 2000;
+          if (sample_format == SampleFormat::kSc16) {
+            auto header = MakeSc16Header(num_acc_samps);
+            udp_streamer.Send(&header, sizeof(header));
+          }
+          send_stats = udp_streamer.Send(buffs.at(0, chan), buffs.bytes(num_acc_samps));
         }
-        buffs.erase(buffs.begin(), buffs.begin() + static_cast<int>(num_tx_samps));
-        num_acc_samps -= num_tx_samps;
-        std::this_thread::sleep_for(std::chrono::microseconds(1));
-      }
-      buffs.clear();
+      });
+      UdpSendStats send_stats;
+      for (const auto &stats : channel_stats) send_stats += stats;
+      spdlog::info("Sent {} bytes in {} datagrams: {:.1f} MB/s",
+                   send_stats.num_bytes, send_stats.num_datagrams, send_stats.MegabytesPerSecond());
       status = true;
     }
 
     if (vm.count("file")) {
       std::ofstream outfile(file_path, std::ofstream::binary);
-      outfile.write((const char *) &buffs.front(), std::streamsize(num_acc_samps * sizeof(std::complex<float>)));
+      for (size_t chan = 0; chan < num_channels; chan++) {
+        outfile.write((const char *) buffs.at(0, chan), std::streamsize(buffs.bytes(num_acc_samps)));
+      }
       outfile.close();
     }
 
-    gpio_thread.join();
     if (stop_signal_called or !vm.count("repeat")) {
       break;
     }
@@ -427,6 +486,7 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     // TODO: LINUX用実装
 #endif
   }
+  if (!trace_path.empty() and WriteChromeTrace(trace_path)) spdlog::info("Trace written to {}", trace_path);
   spdlog::info("Done!");
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,20 @@
+#ifndef TESTS_CHECK_HPP_
+#define TESTS_CHECK_HPP_
+
+#include <cstdio>
+
+// CHECK(condition) reports a failed condition and keeps going, main() returns Failures() != 0
+inline int &Failures() {
+  static int failures = 0;
+  return failures;
+}
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      Failures()++; \
+    } \
+  } while (0)
+
+#endif // TESTS_CHECK_HPP_
@@ -0,0 +1,99 @@
+#include "check.hpp"
+
+#include "control_channel.hpp"
+
+#include <spdlog/spdlog.h>
+#include <boost/asio.hpp>
+#include <cstring>
+
+namespace {
+
+using boost::asio::ip::tcp;
+
+// a loopback connection, server is the side a ControlChannel reads
+struct Connection {
+  Connection() : acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+                 client(io_context), server(io_context) {
+    client.connect(acceptor.local_endpoint());
+    acceptor.accept(server);
+  }
+
+  void Send(const void *data, size_t length) { boost::asio::write(client, boost::asio::buffer(data, length)); }
+
+  boost::asio::io_context io_context;
+  tcp::acceptor acceptor;
+  tcp::socket client;
+  tcp::socket server;
+};
+
+ControlHeader CaptureHeader(uint32_t length) {
+  return {{kControlMagic[0], kControlMagic[1]}, kControlVersion, static_cast<uint8_t>(CommandId::kCapture), length};
+}
+
+void TestCaptureFrame() {
+  Connection connection;
+  const ControlHeader header = CaptureHeader(sizeof(CapturePayload));
+  const CapturePayload payload{2, 7, kCaptureSendUdp};
+  connection.Send(&header, sizeof(header));
+  connection.Send(&payload, sizeof(payload));
+  ControlChannel control(connection.server);
+  ControlCommand command;
+  CHECK(control.Read(command));
+  CHECK(command.id == CommandId::kCapture);
+  CHECK(command.count == 2 and command.link == 7);
+}
+
+// a wrong version is answered with kBadRequest and ends the connection instead of throwing
+void TestCorruptHeader() {
+  Connection connection;
+  ControlHeader header = CaptureHeader(sizeof(CapturePayload));
+  header.version = kControlVersion + 1;
+  connection.Send(&header, sizeof(header));
+  ControlChannel control(connection.server);
+  ControlCommand command;
+  CHECK(!control.Read(command));
+  CHECK(!connection.server.is_open());
+
+  ControlHeader reply;
+  boost::system::error_code error;
+  boost::asio::read(connection.client, boost::asio::buffer(&reply, sizeof(reply)), error);
+  CHECK(!error);
+  CHECK(reply.code == static_cast<uint8_t>(ReplyStatus::kBadRequest));
+  char more;
+  boost::asio::read(connection.client, boost::asio::buffer(&more, 1), error);
+  CHECK(error == boost::asio::error::eof);
+}
+
+// a client leaving in the middle of a payload, then in the middle of a header
+void TestTruncatedFrame() {
+  {
+    Connection connection;
+    const ControlHeader header = CaptureHeader(sizeof(CapturePayload));
+    const uint32_t count = 1;
+    connection.Send(&header, sizeof(header));
+    connection.Send(&count, sizeof(count));
+    connection.client.close();
+    ControlChannel control(connection.server);
+    ControlCommand command;
+    CHECK(!control.Read(command));
+  }
+  {
+    Connection connection;
+    const ControlHeader header = CaptureHeader(sizeof(CapturePayload));
+    connection.Send(&header, 3);
+    connection.client.close();
+    ControlChannel control(connection.server);
+    ControlCommand command;
+    CHECK(!control.Read(command));
+  }
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::off);
+  TestCaptureFrame();
+  TestCorruptHeader();
+  TestTruncatedFrame();
+  return Failures() == 0 ? 0 : 1;
+}
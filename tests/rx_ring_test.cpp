@@ -0,0 +1,72 @@
+#include "check.hpp"
+
+#include "capture_buffer.hpp"
+#include "radio.hpp"
+#include "rx_ring.hpp"
+#include "sim_radio.hpp"
+
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+
+namespace {
+
+// what the cores capture: a delay and four port slots
+const CaptureLayout kLayout(100, 4, 2000, 0);
+
+// a ring on the rate the device runs at, started at the next sweep boundary
+struct RingOnRadio {
+  explicit RingOnRadio(const std::string &args, double rate) : radio(MakeRadio(args)) {
+    radio->set_rx_rate(rate);
+    const double rx_rate = radio->get_rx_rate();
+    ring.reset(new RxRing(radio->get_rx_stream(uhd::stream_args_t("fc32", "sc16")), SampleFormat::kFc32,
+                          kLayout.stream_samps() * 4, rx_rate));
+    start_time = std::ceil(radio->get_time_now().get_real_secs() * 5) / 5 + 0.2;
+    ring->Start(start_time);
+  }
+  ~RingOnRadio() { ring->Stop(); }
+
+  // stream samples of the sweep at time
+  size_t Extract(double time) {
+    CaptureBuffer buff(SampleFormat::kFc32, kLayout.capture_samps());
+    return ring->Extract(ring->TimeToTick(time), kLayout, buff, 1.0);
+  }
+
+  Radio::sptr radio;
+  std::unique_ptr<RxRing> ring;
+  double start_time;
+};
+
+// 3 Msps is 100 MHz / 33.33, the device runs at 100 MHz / 33: the ring has to go by the packet timestamps
+void TestCoercedRate() {
+  RingOnRadio ring("type=sim,sim_master_clock=100e6", 3e6);
+  CHECK(ring.radio->get_rx_rate() != 3e6);
+  CHECK(ring.Extract(ring.start_time + 0.2) == kLayout.stream_samps());
+  CHECK(ring.ring->num_overflows() == 0);
+}
+
+// an overflow in the middle of a sweep: the ring reports that sweep lost and the next one whole again
+void TestInjectedOverflow() {
+  // at 100 ksps the sweep takes 81 ms, the overflow comes 40 ms into it
+  const double rate = 100e3;
+  RingOnRadio ring("type=sim", rate);
+  const double sweep_time = ring.start_time + 0.2;
+  const double overflow_time = sweep_time + static_cast<double>(kLayout.stream_samps()) / rate / 2;
+  const double wait = overflow_time - ring.radio->get_time_now().get_real_secs();
+  if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+  std::dynamic_pointer_cast<SimRadio>(ring.radio)->InjectOverflow();
+  CHECK(ring.Extract(sweep_time) < kLayout.stream_samps());
+  CHECK(ring.ring->num_overflows() == 1);
+  CHECK(ring.Extract(sweep_time + 0.2) == kLayout.stream_samps());
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::warn);
+  TestCoercedRate();
+  TestInjectedOverflow();
+  return Failures() == 0 ? 0 : 1;
+}
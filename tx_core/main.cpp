@@ -1,6 +1,5 @@
 #include <uhd/exception.hpp>
 #include <uhd/types/tune_request.hpp>
-#include <uhd/usrp/multi_usrp.hpp>
 #include <uhd/utils/safe_main.hpp>
 #include <uhd/utils/static.hpp>
 #include <uhd/utils/thread.hpp>
@@ -9,12 +8,21 @@
 #include <boost/program_options.hpp>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <atomic>
 #include <cmath>
 #include <csignal>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include "device_setup.hpp"
+#include "gpio_schedule.hpp"
+#include "metrics_server.hpp"
+#include "radio.hpp"
+#include "switch_pattern.hpp"
+#include "trace.hpp"
+#include "tx_scheduler.hpp"
 
 #define AMP_GPIO_MASK 0x00
 #define MAN_GPIO_MASK 0xFF
@@ -32,47 +40,26 @@ void SigIntHandler(int) {
   stop_signal_called = true;
 }
 
-void GpioWorker(const uhd::usrp::multi_usrp::sptr &usrp, double rate, size_t num_samps) {
-  // basic ATR configuration
-  usrp->set_gpio_attr("FP0", "CTRL", ATR_CONTROL, ATR_MASKS);
-  usrp->set_gpio_attr("FP0", "DDR", GPIO_DDR, ATR_MASKS);
-  spd::info("num_samps: {}", num_samps);
-
-  // start GPIO control loop
-  unsigned int gpio_state;
-  while (true) {
-    auto command_time = std::ceil(usrp->get_time_now().get_real_secs() * 5) / 5;
-//    for (int i = 0; i < std::ceil(kTransmitSpan / (static_cast<double>(num_samps) * 2 * 64 / rate)); i++) {
-      for (int j = 0; j < 8; j++) {
-        gpio_state = MAN_GPIO_MASK & ~(1 << j);
-        usrp->set_command_time(uhd::time_spec_t(command_time));
-        usrp->set_gpio_attr("FP0", "OUT", gpio_state, ATR_MASKS);
-        usrp->clear_command_time();
-        command_time += (static_cast<double>(num_samps) * 16 / rate);
-      }
-//    }
-    auto time_now = usrp->get_time_now().get_real_secs();
-    // 0.2秒間隔で送信するため残りの時間待機
-    auto delay_time = (std::ceil(time_now * 5) / 5 - time_now) * 1000;
-//    spd::info("delay_time: {} ms", delay_time);
-    std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(delay_time)));
-    if (stop_signal_called) break;
-  }
-}
-
 int UHD_SAFE_MAIN(int argc, char *argv[]) {
   // transmit variables to be set by po
   std::string args, file, ant, subdev, ref, pps, otw, channels;
-  double rate, freq, gain, bw, lo_off;
+  double rate, freq, gain, bw, lo_off, lock_timeout;
+  std::string pattern_text, pattern_file, trace_path;
+  unsigned short metrics_port;
+  size_t num_port_samps, num_delay, tx_ports, rx_ports, gpio_queue_depth;
+  bool continuous, concurrent_setup;
 
   // initialize the logger
   spd::set_pattern("[%H:%M:%S.%e] [%^%l%$] [thread %t] %v");
+  // time to the first sweep after launch, logged phase by phase once the node is ready
+  StartupTimer timer;
 
   // setup the program options
   po::options_description desc("Allowed options");
   desc.add_options()
       ("help", "help message")
-      ("args", po::value<std::string>(&args)->default_value(""), "single uhd device address args")
+      ("args", po::value<std::string>(&args)->default_value(""),
+       "single uhd device address args, \"type=sim,...\" for the simulated radio (see sim_radio.hpp)")
       ("file", po::value<std::string>(&file)->default_value("signal.dat"), "name of the file to transmit")
       ("rate", po::value<double>(&rate), "rate of transmit outgoing samples")
       ("freq", po::value<double>(&freq), "RF center frequency in Hz")
@@ -86,7 +73,26 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
        "reference source (internal, external, mimo)")
       ("pps", po::value<std::string>(&pps)->default_value("internal"), "PPS source (internal, external)")
       ("otw", po::value<std::string>(&otw)->default_value("sc16"), "specify the over-the-wire sample mode")
-      ("channels", po::value<std::string>(&channels)->default_value("0"), "which channels to use");
+      ("channels", po::value<std::string>(&channels)->default_value("0"), "which channels to use")
+      ("samps", po::value<size_t>(&num_port_samps)->default_value(256), "samples per port (half of a port slot)")
+      ("tx-ports", po::value<size_t>(&tx_ports)->default_value(8), "number of Tx ports (without a pattern)")
+      ("rx-ports", po::value<size_t>(&rx_ports)->default_value(8), "number of Rx ports (without a pattern)")
+      ("pattern", po::value<std::string>(&pattern_text),
+       "antenna switch pattern, same as the rx side (tx:rx[@dwell samples][*repeat], ranges a-b)")
+      ("pattern-file", po::value<std::string>(&pattern_file), "read the antenna switch pattern from this file")
+      ("delay", po::value<size_t>(&num_delay)->default_value(0), "delay samples in front of the first port slot")
+      ("gpio-queue", po::value<size_t>(&gpio_queue_depth)->default_value(64),
+       "antenna switch commands queued ahead of their time per switching run, at most this many in the device")
+      ("metrics-port", po::value<unsigned short>(&metrics_port)->default_value(0),
+       "serve counters and latency histograms in the Prometheus text format on 127.0.0.1:<port> (0: off)")
+      ("trace", po::value<std::string>(&trace_path),
+       "record timing events of the tx / gpio threads and write them as Chrome trace JSON to this file on exit")
+      ("continuous", po::bool_switch(&continuous),
+       "transmit one continuous timed stream (zeros between sweeps) instead of one burst per sweep")
+      ("lock-timeout", po::value<double>(&lock_timeout)->default_value(5),
+       "seconds to wait for the reference and LO lock sensors")
+      ("concurrent-setup", po::bool_switch(&concurrent_setup), "set up the rx and tx chains on two threads, "
+       "only for devices whose setters are safe to call concurrently (the same flag as txrx_core)");
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
   po::notify(vm);
@@ -97,9 +103,15 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     return 0;
   }
 
+  // counters and histograms of the hot paths
+  std::unique_ptr<MetricsServer> metrics_server;
+  if (metrics_port != 0) metrics_server.reset(new MetricsServer(metrics_port));
+  if (!trace_path.empty()) EnableTracing();
+  TraceThreadName("tx");
+
   // create a usrp device
   spd::info("Creating the usrp device with: {}", args);
-  uhd::usrp::multi_usrp::sptr usrp = uhd::usrp::multi_usrp::make(args);
+  Radio::sptr usrp = MakeRadio(args);
 
   // always select the subdevice first, the channel mapping affects the other settings
   if (vm.count("subdev")) {
@@ -108,80 +120,36 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
   }
   spd::info("Using Device: {}", usrp->get_pp_string());
 
-  // detect which channels to use
-  std::vector<std::string> channel_strings;
-  std::vector<size_t> channel_nums;
-  boost::split(channel_strings, channels, boost::is_any_of("\"',"));
-  for (const auto &kChannelString : channel_strings) {
-    size_t chan = boost::lexical_cast<int>(kChannelString);
-    if (chan >= usrp->get_tx_num_channels()) {
-      throw std::runtime_error("Invalid channel(s) specified.");
-    } else {
-      channel_nums.push_back(boost::lexical_cast<int>(kChannelString));
-    }
-  }
+  timer.Mark("device");
 
-  // lock mboard clocks
-  spd::info("Lock mboard clocks");
-  usrp->set_clock_source(ref);
-  usrp->set_time_source(pps);
-  // wait for mboard to lock
-  spd::info("Waiting for clock lock...");
-  while (not usrp->get_mboard_sensor("ref_locked").to_bool()) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-  }
-  // pps edge 検出
-  spd::info("Waiting for pps...");
-  const uhd::time_spec_t kLastPpsTime = usrp->get_time_last_pps();
-  while (usrp->get_time_last_pps() == kLastPpsTime) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-  }
-  spd::info("PPS detected...");
-
-  // set the sample rate
   if (not vm.count("rate")) {
     std::cerr << "Please specify the sample rate with --rate" << std::endl;
     return ~0;
   }
-  spd::info("Setting sample rate: {} Msps", rate / 1e6);
-  usrp->set_tx_rate(rate);
-  spdlog::info("Actual TX Rate: {} Msps...", usrp->get_tx_rate() / 1e6);
-
   if (not vm.count("freq")) {
     std::cerr << "Please specify the center frequency with --freq" << std::endl;
     return ~0;
   }
-  for (size_t chan : channel_nums) {
-    spdlog::info("Configuring channel {}", chan);
-
-    // set the center frequency
-    spdlog::info("Setting TX Freq: {} MHz", freq / 1e6);
-    uhd::tune_request_t tune_request(freq, lo_off);
-    usrp->set_tx_freq(tune_request, chan);
-    spdlog::info("Actual TX Freq: {} MHz...", usrp->get_tx_freq() / 1e6);
-
-
-    // set the rf gain
-    if (vm.count("gain")) {
-      spdlog::info("Setting TX Gain: {} dB", gain);
-      usrp->set_tx_gain(gain, chan);
-      spdlog::info("Actual TX Gain: {} dB...", usrp->get_tx_gain());
-    }
-
-    // set the analog frontend filter bandwidth
-    if (vm.count("bw")) {
-      spdlog::info("Setting TX Bandwidth: {} MHz", bw / 1e6);
-      usrp->set_tx_bandwidth(bw, chan);
-      spdlog::info("Actual TX Bandwidth: {} MHz...", usrp->get_tx_bandwidth() / 1e6);
-    }
-
-    // set the antenna
-    if (vm.count("ant")) {
-      spdlog::info("Setting TX Antenna: {}", ant);
-      usrp->set_tx_antenna(ant, chan);
-      spdlog::info("Actual TX Antenna: {}", usrp->get_tx_antenna());
-    }
-  }
+  DeviceSettings settings;
+  settings.channels = ParseChannels(channels, usrp->get_tx_num_channels());
+  settings.clock_source = ref;
+  settings.time_source = pps;
+  settings.rate = rate;
+  settings.freq = freq;
+  settings.lo_off = lo_off;
+  settings.lock_timeout = lock_timeout;
+  settings.concurrent = concurrent_setup;
+  settings.tx.enabled = true;
+  if (vm.count("gain")) settings.tx.gain = gain;
+  if (vm.count("bw")) settings.tx.bandwidth = bw;
+  if (vm.count("ant")) settings.tx.antenna = ant;
+  BringUp(*usrp, settings, timer);
+  const std::vector<size_t> &channel_nums = settings.channels;
+  // the sweep period, the delay and the switching are in samples of the rate the device actually runs at
+  const double tx_rate = usrp->get_tx_rate();
+  // the rest of the setup runs while the device waits for the PPS edge
+  spd::info("Setting device timestamp to 0 at next PPS");
+  PpsTimeReset pps_reset(*usrp);
 
   // create a transmit streamer
   spdlog::info("Creating TX streamer...");
@@ -203,87 +171,76 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
   infile.close();
   spdlog::info("num_samps: {}", num_samps);
 
-  // check Ref and LO Lock detect
-  // wait for LO lock
-  spdlog::info("Waiting for TX lock (1 second)");
-  std::this_thread::sleep_for(std::chrono::seconds(1)); //allow for some setup time
-  std::vector<std::string> sensor_names;
-  sensor_names = usrp->get_tx_sensor_names(0);
-  if (std::find(sensor_names.begin(), sensor_names.end(), "lo_locked") != sensor_names.end()) {
-    uhd::sensor_value_t lo_locked = usrp->get_tx_sensor("lo_locked", 0);
-    spdlog::info("Checking TX: {}", lo_locked.to_pp_string());
-    UHD_ASSERT_THROW(lo_locked.to_bool())
-  }
-  sensor_names = usrp->get_mboard_sensor_names(0);
-  if ((ref == "external")
-      and (std::find(sensor_names.begin(), sensor_names.end(), "ref_locked") != sensor_names.end())) {
-    uhd::sensor_value_t ref_locked = usrp->get_mboard_sensor("ref_locked", 0);
-    spdlog::info("Checking TX: {}", ref_locked.to_pp_string());
-    UHD_ASSERT_THROW(ref_locked.to_bool())
-  }
-
   std::signal(SIGINT, &SigIntHandler); // register ctrl-c handler
   spdlog::info("Press Ctrl + C to stop streaming...");
 
-  spdlog::info("Setting device timestamp to 0...");
-  usrp->set_time_next_pps(uhd::time_spec_t(0.0));
-  std::this_thread::sleep_for(std::chrono::seconds(1)); //allow for some setup time
-
-
   uhd::tx_streamer::sptr tx_stream = usrp->get_tx_stream(stream_args);
   auto max_num_samps = tx_stream->get_max_num_samps();
   spdlog::info("max_num_samps: {}", max_num_samps);
-  if (max_num_samps > num_samps) max_num_samps = num_samps;
 
-  // start gpio thread
-  std::thread gpio_thread([&]() {
-    GpioWorker(usrp, rate, 256);
-  });
+  // the port slots of a sweep, they have to match the pattern of the rx node
+  const SwitchPattern pattern = SwitchPattern::FromOptions(pattern_file, pattern_text, tx_ports, rx_ports,
+                                                           num_port_samps * 2);
+  spd::info("Switch pattern: {} slots, {} samples per sweep", pattern.size(), pattern.sweep_samps());
 
-  usrp->clear_command_time();
-  double send_time = std::ceil(usrp->get_time_now().get_real_secs());
-  while (true) {
+  // one sweep is the delay and every port slot, plus one port of tail for the tx/rx latency
+  const size_t sweep_samps = num_delay + pattern.sweep_samps() + num_port_samps;
+  const auto period_samps = static_cast<size_t>(std::llround(tx_rate * 0.2));
+  if (sweep_samps > period_samps) {
+    std::cerr << "One sweep does not fit the 200 ms sweep period" << std::endl;
+    return ~0;
+  }
+  TxScheduler tx_scheduler(buff, sweep_samps, max_num_samps, continuous ? period_samps : 0);
 
-    uhd::tx_metadata_t md;
-    md.time_spec = uhd::time_spec_t(send_time);
-    md.start_of_burst = true;
-    md.has_time_spec = true;
+  timer.Mark("setup");
+  if (pps_reset.Wait()) {
+    spd::info("PPS detected...");
+  } else {
+    spd::warn("No PPS edge seen, the device time may not be aligned to the other nodes");
+  }
+  timer.Mark("pps");
+  timer.Report();
 
-    double timeout = 1.5; //1.5
-//	spdlog::info("Current time / Send time: {} / {}", time_now.get_real_secs(), md.time_spec.get_real_secs());
-//	spdlog::info("Timeout: {}", timeout);
-    spd::info("Send Time: {}", send_time);
-//	usrp->clear_command_time();
-//	spdlog::info("Last PPS time: {}", usrp->get_time_last_pps().get_real_secs());
+  usrp->clear_command_time();
+  double send_time = std::ceil(usrp->get_time_now().get_real_secs());
+  TraceClockSync(usrp->get_time_now().get_real_secs());
 
-//    auto num_send = static_cast<size_t>(std::ceil(rate / static_cast<double>(max_num_samps) * kTransmitSpan));
-    auto num_send = 65;//19
-    for (size_t i = 0; i < num_send; i++) {
-      size_t num_sent = tx_stream->send(&buff.front(), max_num_samps, md, timeout);
-      if (num_sent < max_num_samps) {
-        spdlog::error("Sent {} / {} samples", num_sent, max_num_samps);
-      }
-      md.has_time_spec = false;
-      md.start_of_burst = false;
+  // start gpio thread, the switch timeline follows the sweeps from the first send time on
+  usrp->set_gpio_attr("FP0", "CTRL", ATR_CONTROL, ATR_MASKS);
+  usrp->set_gpio_attr("FP0", "DDR", GPIO_DDR, ATR_MASKS);
+  const SweepTimeline gpio_timeline = TxSwitchTimeline(pattern, MAN_GPIO_MASK);
+  GpioScheduler gpio_scheduler(usrp, tx_rate, ATR_MASKS, gpio_queue_depth);
+  std::atomic<bool> keep_switching{true};
+  std::thread gpio_thread([&]() {
+    TraceThreadName("gpio");
+    gpio_scheduler.Run(gpio_timeline, send_time + static_cast<double>(num_delay) / tx_rate, 0, 0.2, keep_switching);
+  });
+  const double timeout = 1.5;
+  if (continuous) {
+    // one timed start, then every sweep (padded to 200 ms) follows the previous one without end of burst
+    spd::info("Send Time: {} (continuous)", send_time);
+    for (double time = send_time; !stop_signal_called; time = -1) {
+      tx_scheduler.Send(tx_stream, time, false, timeout);
+      tx_scheduler.PollAsync(tx_stream);
     }
-
-    // send a mini EOB packet
-    md.end_of_burst = true;
-    tx_stream->send("", 0, md);
-    spdlog::info("Waiting for async burst ACK...");
-    uhd::async_metadata_t async_md;
-    bool got_async_burst_ack = false;
-    // loop through all messages for the ACK packet (may have underflow messages in queue)
-    while (not got_async_burst_ack and tx_stream->recv_async_msg(async_md, timeout)) {
-      got_async_burst_ack = async_md.event_code == uhd::async_metadata_t::EVENT_CODE_BURST_ACK;
+    tx_scheduler.EndBurst(tx_stream);
+  } else {
+    spd::info("Send Time: {} (one burst every 200 ms)", send_time);
+    while (true) {
+      // the sweep is exactly one burst, its last frame carries the end of burst
+      tx_scheduler.Send(tx_stream, send_time, true, timeout);
+      // send() blocks until the device has room, so the ACK of the previous burst is only collected here
+      tx_scheduler.PollAsync(tx_stream);
+      send_time += 0.200;
+      if (stop_signal_called) break;
     }
-    spdlog::info("Result: {}", (got_async_burst_ack ? "success" : "failure"));
-
-    send_time += 0.200;
-    if (stop_signal_called) break;
+    spdlog::info("Result: {}", (tx_scheduler.PollAsync(tx_stream, true, timeout) ? "success" : "failure"));
   }
+  spdlog::info("TX underflows: {}, late packets: {}", tx_scheduler.num_underflows(), tx_scheduler.num_late());
 
+  keep_switching = false;
   gpio_thread.join();
+  if (!trace_path.empty() and WriteChromeTrace(trace_path)) spdlog::info("Trace written to {}", trace_path);
   spdlog::info("Done!");
 
   return EXIT_SUCCESS;